@@ -4,6 +4,7 @@
 #include <string.h>
 #include QMK_KEYBOARD_H
 #include "filesystem.h"
+#include "fs_profile.h"
 
 bool fs_is_path_safe(const char *path) {
     int pos = 0;
@@ -107,7 +108,13 @@ bool process_record_filesystem(uint16_t keycode, keyrecord_t *record) {
     switch (keycode) {
         case FS_DUMP: {
             if (record->event.pressed) {
-                fs_dump("/");
+                // Held across the listing and the info dump, so they see the same mount and don't remount per directory
+                if (fs_mount()) {
+                    fs_dump("/");
+                    fs_dump_info();
+                    fs_unmount();
+                }
+                fs_profile_dump();
             }
             return true;
         }
@@ -31,6 +31,19 @@ typedef int32_t fs_size_t;
 #    define FS_MAX_NUM_OPEN_FDS 6
 #endif
 
+// Configurable: Path prefix the read-only asset pack is served under with FILESYSTEM_ASSETS defined, without a leading slash
+#ifndef FS_ASSETS_PREFIX
+#    define FS_ASSETS_PREFIX "assets"
+#endif
+
+/** @brief Bookkeeping bytes taken from the buffer pool by each buffer allocated from it, see FS_BUFFER_POOL_SIZE */
+#define FS_BUFFER_POOL_OVERHEAD 8
+
+// Configurable: Number of erase counters the device's blocks are split between for wear accounting
+#ifndef FS_WEAR_NUM_BUCKETS
+#    define FS_WEAR_NUM_BUCKETS 32 // Exact per-block counts if the device has no more blocks than this
+#endif
+
 /** @brief File seek origin */
 typedef enum fs_whence_t {
     FS_SEEK_SET = 0, /**< Seek relative to start position */
@@ -45,6 +58,12 @@ typedef enum fs_mode_t {
     FS_TRUNCATE = 1 << 2, /**< Truncate the file to zero length */
 } fs_mode_t;
 
+/** @brief File access pattern hints, see fs_open_ex() */
+typedef enum fs_access_t {
+    FS_ACCESS_DEFAULT    = 0, /**< No particular pattern, reads and writes go through the littlefs file cache */
+    FS_ACCESS_SEQUENTIAL = 1, /**< Read front to back, in pieces smaller than the stream buffer */
+} fs_access_t;
+
 /**
  * @brief Format the filesystem
  *
@@ -184,7 +203,12 @@ bool fs_delete(const char *path);
 /**
  * @brief Open file
  *
- * Opens a file with specified access mode.
+ * Opens a file with specified access mode, as per fs_open_ex() with FS_ACCESS_DEFAULT.
+ * With FILESYSTEM_ASSETS defined, paths under FS_ASSETS_PREFIX open assets
+ * from the read-only asset pack instead, which may only be opened with
+ * FS_READ and don't mount littlefs. fs_opendir() of the prefix itself lists
+ * them, and fs_exists() finds them; modifications are refused. Anything
+ * littlefs holds under the prefix is hidden.
  * Thread-safe.
  *
  * @param filename File path to open
@@ -193,6 +217,26 @@ bool fs_delete(const char *path);
  */
 fs_fd_t fs_open(const char *filename, fs_mode_t mode);
 
+/**
+ * @brief Open file with a buffering hint
+ *
+ * As per fs_open(). Every open file takes a littlefs file cache from the
+ * buffer pool shared by all open files, see FS_BUFFER_POOL_SIZE. Files opened
+ * with FS_READ alone and FS_ACCESS_SEQUENTIAL also take a stream buffer of up
+ * to buffer_size bytes, so that a series of small reads costs one device read
+ * per buffer rather than one per cache. If the pool is short the stream buffer
+ * is shrunk so that another file's cache still fits, or left out if it would
+ * then be no larger than the file cache.
+ * Thread-safe.
+ *
+ * @param filename File path to open
+ * @param mode Access mode (FS_READ, FS_WRITE, FS_TRUNCATE flags)
+ * @param access Access pattern hint
+ * @param buffer_size Stream buffer size in bytes, ignored unless access is FS_ACCESS_SEQUENTIAL
+ * @return File descriptor on success, INVALID_FILESYSTEM_FD on failure
+ */
+fs_fd_t fs_open_ex(const char *filename, fs_mode_t mode, fs_access_t access, fs_size_t buffer_size);
+
 /**
  * @brief Seek to position in file
  *
@@ -287,11 +331,215 @@ bool fs_is_path_safe(const char *path);
  */
 bool fs_is_path_depth_valid(const char *path, int max_depth);
 
+/**
+ * @brief Mount operation counters
+ *
+ * Counts mounts and unmounts actually performed on the underlying filesystem,
+ * rather than calls to fs_mount()/fs_unmount() which only adjust the reference count.
+ */
+typedef struct fs_mount_stats_t {
+    uint32_t mounts;   /**< Number of times the underlying filesystem was mounted */
+    uint32_t unmounts; /**< Number of times the underlying filesystem was unmounted */
+} fs_mount_stats_t;
+
+/**
+ * @brief Enable or disable persistent mount mode
+ *
+ * While enabled, the filesystem stays mounted after the first operation
+ * which mounts it, rather than being unmounted again once no files are
+ * open. Disabling releases the mount held by this mode. Enabled by default
+ * when FILESYSTEM_STAY_MOUNTED is defined.
+ * Thread-safe.
+ *
+ * @param enable true to keep the filesystem mounted, false to mount on demand
+ */
+void fs_set_persistent_mount(bool enable);
+
+/**
+ * @brief Check if persistent mount mode is enabled
+ *
+ * Thread-safe.
+ *
+ * @return true if enabled, false otherwise
+ */
+bool fs_get_persistent_mount(void);
+
+/**
+ * @brief Get the number of mount and unmount operations performed on the underlying filesystem
+ *
+ * Thread-safe.
+ *
+ * @param stats Structure to fill with the counters
+ */
+void fs_get_mount_stats(fs_mount_stats_t *stats);
+
+/**
+ * @brief Device wear counters
+ *
+ * Accumulated across the lifetime of the device, and persisted in the
+ * filesystem. Blocks are split evenly between FS_WEAR_NUM_BUCKETS counters,
+ * with bucket i covering blocks [i * block_count / FS_WEAR_NUM_BUCKETS, (i + 1) * block_count / FS_WEAR_NUM_BUCKETS).
+ */
+typedef struct fs_wear_stats_t {
+    uint32_t block_count;                        /**< Number of blocks in the device */
+    uint32_t erases;                             /**< Total number of block erases */
+    uint64_t prog_bytes;                         /**< Total number of bytes programmed */
+    uint32_t bucket_erases[FS_WEAR_NUM_BUCKETS]; /**< Number of block erases within each bucket */
+} fs_wear_stats_t;
+
+/**
+ * @brief Get the device wear counters
+ *
+ * Thread-safe.
+ *
+ * @param stats Structure to fill with the counters
+ */
+void fs_get_wear_stats(fs_wear_stats_t *stats);
+
+/**
+ * @brief Persist the device wear counters
+ *
+ * Counters are otherwise persisted once enough erases have accumulated, so
+ * call this before powering down to avoid losing the most recent counts.
+ * Thread-safe.
+ *
+ * @return true on success, false on failure
+ */
+bool fs_flush_wear_stats(void);
+
+/**
+ * @brief Erase all free space ahead of time
+ *
+ * Erases every block the filesystem is not using, with the largest erase
+ * commands the device supports, so later writes pay program time only.
+ * With FILESYSTEM_BULK_ERASE defined this also happens automatically when
+ * formatting, and after a recursive fs_rmdir().
+ * Thread-safe.
+ *
+ * @return true on success, false on failure
+ */
+bool fs_erase_free_space(void);
+
+/**
+ * @brief Erase a few free blocks ahead of time
+ *
+ * Keeps the next few free blocks littlefs will allocate erased, so that
+ * allocating them costs program time only. Each call walks forward from
+ * littlefs' allocator position, and returns without mounting if nothing has
+ * been written since the pool was last found full. With FILESYSTEM_PRE_ERASE
+ * defined, housekeeping calls this while there are no saves pending.
+ * Thread-safe.
+ *
+ * @param max_blocks Most blocks to erase
+ * @return Number of blocks erased
+ */
+uint32_t fs_pre_erase(uint32_t max_blocks);
+
+/**
+ * @brief Get an asset's contents in place
+ *
+ * Only available when the device layer memory-maps the asset partition,
+ * e.g. through XIP or a QSPI memory-mapped mode, in which case the asset can
+ * be used directly from flash without being copied. Otherwise open it with
+ * fs_open(), where each fs_read() is a single device read.
+ * Thread-safe.
+ *
+ * @param path Path of the asset, under FS_ASSETS_PREFIX
+ * @param size Set to the size of the asset in bytes, may be NULL
+ * @return Pointer to the asset, valid until the partition is rewritten, or NULL if not found or not memory-mapped
+ */
+const void *fs_asset_map(const char *path, fs_size_t *size);
+
+/**
+ * @brief Borrow a buffer from the filesystem's buffer pool
+ *
+ * The pool of FS_BUFFER_POOL_SIZE bytes holds littlefs' caches only while
+ * the filesystem is mounted or files are open, so other features may use it
+ * while the filesystem is idle, e.g. with persistent mount disabled. Memory
+ * borrowed here is unavailable to the filesystem until returned: mounting
+ * and opening files fail if the pool can no longer provide their buffers.
+ * Thread-safe.
+ *
+ * @param size Size of the buffer in bytes
+ * @return Pointer to the buffer, aligned to 8 bytes, or NULL if the pool has no free space large enough
+ */
+void *fs_buffer_alloc(size_t size);
+
+/**
+ * @brief Return a buffer borrowed with fs_buffer_alloc()
+ *
+ * Thread-safe.
+ *
+ * @param ptr Buffer to return, or NULL
+ */
+void fs_buffer_free(void *ptr);
+
+/**
+ * @brief Buffer pool usage
+ */
+typedef struct fs_buffer_pool_stats_t {
+    size_t size;         /**< Usable size of the pool in bytes */
+    size_t free;         /**< Total free space in bytes */
+    size_t largest_free; /**< Largest buffer which could currently be allocated, in bytes */
+} fs_buffer_pool_stats_t;
+
+/**
+ * @brief Get the buffer pool usage
+ *
+ * Thread-safe.
+ *
+ * @param stats Structure to fill with the usage
+ */
+void fs_get_buffer_pool_stats(fs_buffer_pool_stats_t *stats);
+
+/**
+ * @brief Begin a batch of filesystem operations
+ *
+ * Holds the filesystem lock until the matching fs_batch_commit(), so other
+ * threads cannot interleave with the batch. Once any operation within the
+ * batch mounts the filesystem, it stays mounted until the batch is
+ * committed, avoiding repeated mount/unmount cycles. Batches may be nested;
+ * the outermost commit releases the lock and mount.
+ * Thread-safe, must be committed from the same thread.
+ */
+void fs_batch_begin(void);
+
+/**
+ * @brief Commit a batch of filesystem operations
+ *
+ * Releases the lock and mount held since the matching fs_batch_begin().
+ * LittleFS commits file data and metadata when each file is closed, so
+ * there is no further deferred work to flush here.
+ * Thread-safe.
+ */
+void fs_batch_commit(void);
+
+/**
+ * @brief Take exclusive use of the bus the filesystem's flash is attached to
+ *
+ * QMK's spi_master doesn't arbitrate between threads, and with
+ * FILESYSTEM_ASYNC_SAVE the flash is accessed from the save thread while the
+ * main loop carries on. Other drivers on the same SPI bus (displays, etc.)
+ * must hold this from spi_start() to spi_stop() of each transfer, or the
+ * flash must be the only device on its bus. The filesystem holds it for each
+ * flash operation, erases included, so it may block for the length of an
+ * erase. Not recursive, and must not be held while calling fs_* functions.
+ * Thread-safe.
+ */
+void fs_device_bus_lock(void);
+
+/**
+ * @brief Release the bus taken by fs_device_bus_lock()
+ * Thread-safe.
+ */
+void fs_device_bus_unlock(void);
+
 /**
  * @brief Dump filesystem information to console
  *
  * Prints detailed filesystem information. Only available when
  * CONSOLE_ENABLE is defined.
+ * Mounts the filesystem if it isn't already.
  * Thread-safe.
  */
 void fs_dump_info(void);
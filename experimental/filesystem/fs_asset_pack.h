@@ -0,0 +1,44 @@
+// Copyright 2025-2026 Nick Brassel (@tzarc)
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+// On-flash layout of the read-only asset pack, served under FS_ASSETS_PREFIX with FILESYSTEM_ASSETS defined. A pack is
+// a header, followed by an index of fixed-size entries sorted by name, followed by the payloads:
+//
+//   | header | entry 0 | entry 1 | ... | entry N-1 | payload 0 | payload 1 | ... |
+//
+// All values are little-endian. Payloads are contiguous and 4-byte aligned, so that each can be fetched with a single
+// device read, or used in place when the partition is memory-mapped. Packs are built by support/make_asset_pack.py.
+
+#include <stdint.h>
+
+/** @brief Pack header magic, "QFAP" */
+#define FS_ASSET_PACK_MAGIC 0x50414651
+
+/** @brief Version of the pack layout */
+#define FS_ASSET_PACK_VERSION 1
+
+/** @brief Longest asset name, excluding the terminator */
+#define FS_ASSET_NAME_MAX 23
+
+/** @brief Alignment of each payload within the pack */
+#define FS_ASSET_PACK_ALIGN 4
+
+/** @brief Header at the start of the pack */
+typedef struct __attribute__((packed)) fs_asset_pack_header_t {
+    uint32_t magic;    /**< FS_ASSET_PACK_MAGIC */
+    uint16_t version;  /**< FS_ASSET_PACK_VERSION */
+    uint16_t count;    /**< Number of index entries */
+    uint32_t size;     /**< Total size of the pack in bytes, including the header and index */
+    uint32_t reserved; /**< Zero */
+} fs_asset_pack_header_t;
+
+/** @brief Index entry, immediately following the header */
+typedef struct __attribute__((packed)) fs_asset_pack_entry_t {
+    char     name[FS_ASSET_NAME_MAX + 1]; /**< Name relative to FS_ASSETS_PREFIX, zero-padded; entries sorted by strcmp() */
+    uint32_t offset;                      /**< Offset of the payload from the start of the pack */
+    uint32_t size;                        /**< Size of the payload in bytes */
+} fs_asset_pack_entry_t;
+
+_Static_assert(sizeof(fs_asset_pack_header_t) == 16, "fs_asset_pack_header_t must be 16 bytes");
+_Static_assert(sizeof(fs_asset_pack_entry_t) == 32, "fs_asset_pack_entry_t must be 32 bytes");
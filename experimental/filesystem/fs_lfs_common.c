@@ -1,11 +1,14 @@
 // Copyright 2022-2026 Nick Brassel (@tzarc)
 // SPDX-License-Identifier: GPL-2.0-or-later
 #include <stdbool.h>
-#include <ch.h>
 #include <string.h>
-#include "chmtx.h"
 #include "filesystem.h"
+#include "fs_platform.h"
+#include "fs_profile.h"
 #include "lfs.h"
+#ifdef FILESYSTEM_ASSETS
+#    include "fs_asset_pack.h"
+#endif // FILESYSTEM_ASSETS
 
 /*
  * ERROR HANDLING CONVENTIONS:
@@ -26,16 +29,38 @@
 /** @brief Maximum path buffer size in bytes for deepest possible paths */
 #define MAX_PATH_BUFFER_SIZE ((LFS_NAME_MAX) * (FS_MAX_FILE_DEPTH) + ((FS_MAX_FILE_DEPTH) - 1) + 1)
 
-/** @brief Current file descriptor counter for allocation */
-static fs_fd_t current_fd = FIRST_VALID_FD;
+/**
+ * @brief Number of low bits of a file descriptor holding the handle slot index
+ *
+ * At least 2 bits are used so that the lowest descriptor handed out (generation 1, slot 0) is FIRST_VALID_FD.
+ */
+#define FD_SLOT_BITS                     \
+    ((FS_MAX_NUM_OPEN_FDS) <= 4     ? 2  \
+     : (FS_MAX_NUM_OPEN_FDS) <= 8   ? 3  \
+     : (FS_MAX_NUM_OPEN_FDS) <= 16  ? 4  \
+     : (FS_MAX_NUM_OPEN_FDS) <= 32  ? 5  \
+     : (FS_MAX_NUM_OPEN_FDS) <= 64  ? 6  \
+     : (FS_MAX_NUM_OPEN_FDS) <= 128 ? 7  \
+                                    : 8)
+
+/** @brief Mask extracting the handle slot index from a file descriptor */
+#define FD_SLOT_MASK ((fs_fd_t)((1u << FD_SLOT_BITS) - 1))
+
+/** @brief Largest generation counter value which fits in a file descriptor */
+#define FD_MAX_GENERATION ((uint16_t)(UINT16_MAX >> FD_SLOT_BITS))
+
+_Static_assert(FS_MAX_NUM_OPEN_FDS > 0 && FS_MAX_NUM_OPEN_FDS <= 256, "FS_MAX_NUM_OPEN_FDS must be between 1 and 256");
+_Static_assert((1u << FD_SLOT_BITS) >= FIRST_VALID_FD, "Lowest allocated file descriptor must not be below FIRST_VALID_FD");
 
 /**
  * @brief File descriptor type enumeration
  */
 typedef enum fs_lfs_fd_type_t {
-    FD_TYPE_EMPTY, /**< Unused handle slot */
-    FD_TYPE_DIR,   /**< Directory handle */
-    FD_TYPE_FILE   /**< File handle */
+    FD_TYPE_EMPTY,     /**< Unused handle slot */
+    FD_TYPE_DIR,       /**< Directory handle */
+    FD_TYPE_FILE,      /**< File handle */
+    FD_TYPE_ASSET,     /**< Asset pack file handle */
+    FD_TYPE_ASSET_DIR, /**< Asset pack listing handle */
 } fs_lfs_fd_type_t;
 
 /**
@@ -55,13 +80,33 @@ typedef struct fs_lfs_handle_t {
         } dir;
         struct {
             lfs_file_t             file_handle; /**< LittleFS file handle */
-            struct lfs_file_config cfg;         /**< File configuration */
+            struct lfs_file_config cfg;         /**< File configuration, its cache allocated from the buffer pool */
+            uint8_t               *stream_buf;  /**< Stream buffer for sequential reads, or NULL */
+            lfs_size_t             stream_size; /**< Size of the stream buffer */
+            lfs_size_t             stream_pos;  /**< Offset of the next unread byte within the stream buffer */
+            lfs_size_t             stream_len;  /**< Number of bytes held in the stream buffer, ending at the littlefs file position */
         } file;
+#ifdef FILESYSTEM_ASSETS
+        struct {
+            uint32_t offset; /**< Offset of the payload from the start of the asset pack */
+            uint32_t size;   /**< Size of the payload in bytes */
+            uint32_t pos;    /**< Current position within the payload */
+        } asset;
+        struct {
+            uint16_t    next;                        /**< Index entry returned by the next read */
+            char        name[FS_ASSET_NAME_MAX + 1]; /**< Name of the most recent entry */
+            fs_dirent_t dirent;                      /**< Public directory entry */
+        } asset_dir;
+#endif // FILESYSTEM_ASSETS
     };
 } fs_lfs_handle_t;
 
-/** @brief LittleFS configuration provided by the underlying driver */
+/** @brief LittleFS configuration provided by the underlying driver, sized by fs_device_init() with FILESYSTEM_SFDP_GEOMETRY */
+#ifdef FILESYSTEM_SFDP_GEOMETRY
+extern struct lfs_config lfs_cfg;
+#else
 extern const struct lfs_config lfs_cfg;
+#endif // FILESYSTEM_SFDP_GEOMETRY
 
 /** @brief LittleFS filesystem instance */
 static lfs_t lfs;
@@ -70,26 +115,21 @@ static lfs_t lfs;
 static fs_lfs_handle_t fs_handles[FS_MAX_NUM_OPEN_FDS];
 
 /**
- * @brief Macro to find and operate on a file descriptor handle
- *
- * Searches through the handle array for a matching file descriptor and type,
- * then executes the provided code block with access to the handle.
+ * @brief Per-slot generation counters, embedded in the high bits of each file descriptor
  *
- * @param search_fd File descriptor to search for
- * @param fd_type Expected type of the file descriptor
- * @param block Code block to execute if handle is found
+ * Bumped every time a slot is reused, so that a stale descriptor no longer matches the slot's current one.
+ * Deliberately not reset by fs_init(), so descriptors from before a reinit remain invalid.
  */
-#define FIND_FD_GET_HANDLE(search_fd, fd_type, block)                              \
-    do {                                                                           \
-        for (int __find_idx = 0; __find_idx < FS_MAX_NUM_OPEN_FDS; ++__find_idx) { \
-            fs_lfs_handle_t *handle = &fs_handles[__find_idx];                     \
-            if (handle->fd == (search_fd) && handle->type == (fd_type)) {          \
-                {                                                                  \
-                    block                                                          \
-                }                                                                  \
-            }                                                                      \
-        }                                                                          \
-    } while (0)
+static uint16_t fs_fd_generation[FS_MAX_NUM_OPEN_FDS];
+
+/** @brief Stack of released handle slots, available for reuse */
+static uint8_t fs_free_slots[FS_MAX_NUM_OPEN_FDS];
+
+/** @brief Number of entries in fs_free_slots */
+static uint16_t fs_free_slot_count = 0;
+
+/** @brief Number of handle slots handed out at least once since init; slots at or above this are free but not on the stack */
+static uint16_t fs_slots_issued = 0;
 
 /**
  * @brief Validate file descriptor range and format
@@ -102,52 +142,126 @@ static inline bool is_valid_fd(fs_fd_t fd) {
 }
 
 /**
- * @brief Check if a file descriptor can be allocated
- *
- * Validates that the file descriptor is in valid range and not currently in use.
+ * @brief Get the handle slot index encoded in a file descriptor
  *
- * @param fd File descriptor to check
- * @return true if fd can be used, false if invalid or already in use
+ * @param fd File descriptor
+ * @return Slot index, or -1 if the file descriptor cannot refer to any slot
  */
-static inline bool fd_can_be_used(fs_fd_t fd) {
+static inline int fd_to_slot(fs_fd_t fd) {
     if (!is_valid_fd(fd)) {
-        return false;
+        return -1;
     }
-    for (int i = 0; i < FS_MAX_NUM_OPEN_FDS; ++i) {
-        if (fs_handles[i].fd == fd) {
-            return false;
-        }
+    int slot = fd & FD_SLOT_MASK;
+    return slot < FS_MAX_NUM_OPEN_FDS ? slot : -1;
+}
+
+/**
+ * @brief Get the handle slot which the next call to allocate_fd() will use
+ *
+ * Does not claim the slot, so a failed open leaves the slot available.
+ *
+ * @return Slot index, or -1 if all slots are in use
+ */
+static inline int peek_free_slot(void) {
+    if (fs_free_slot_count > 0) {
+        return fs_free_slots[fs_free_slot_count - 1];
     }
-    return true;
+    if (fs_slots_issued < FS_MAX_NUM_OPEN_FDS) {
+        return fs_slots_issued;
+    }
+    return -1;
+}
+
+/**
+ * @brief Reset the free slot tracking, marking every slot as available
+ */
+static inline void reset_free_slots(void) {
+    fs_free_slot_count = 0;
+    fs_slots_issued    = 0;
 }
 
 /**
  * @brief Allocate a new file descriptor
  *
- * Searches for an available file descriptor using a round-robin approach
- * with intentional uint16_t wraparound.
+ * Claims the slot returned by peek_free_slot(), and bumps its generation
+ * so the new descriptor differs from any previously issued for that slot.
  *
  * @return New file descriptor, or INVALID_FILESYSTEM_FD if none available
  */
 static inline fs_fd_t allocate_fd(void) {
-    fs_fd_t first = current_fd;
-    do {
-        // Prevent overflow by checking before increment
-        if (current_fd == UINT16_MAX) {
-            current_fd = FIRST_VALID_FD;
-        } else {
-            ++current_fd;
-        }
-        if (fd_can_be_used(current_fd)) {
-            return current_fd;
-        }
-        if (current_fd == first) {
-            // If we've looped back around to the first, everything is already allocated (yikes!). Need to exit with a failure.
-            return INVALID_FILESYSTEM_FD;
-        }
-    } while (true);
+    int slot;
+    if (fs_free_slot_count > 0) {
+        slot = fs_free_slots[--fs_free_slot_count];
+    } else if (fs_slots_issued < FS_MAX_NUM_OPEN_FDS) {
+        slot = fs_slots_issued++;
+    } else {
+        return INVALID_FILESYSTEM_FD;
+    }
+
+    // Generation 0 is never used, keeping every descriptor at or above FIRST_VALID_FD
+    uint16_t generation = fs_fd_generation[slot];
+    generation          = (generation >= FD_MAX_GENERATION) ? 1 : (generation + 1);
+
+    fs_fd_generation[slot] = generation;
+    return (fs_fd_t)((generation << FD_SLOT_BITS) | slot);
 }
 
+/**
+ * @brief Release a handle slot, making it available for reuse
+ *
+ * @param handle Handle to release
+ */
+static inline void release_handle(fs_lfs_handle_t *handle) {
+    handle->fd   = INVALID_FILESYSTEM_FD;
+    handle->type = FD_TYPE_EMPTY;
+
+    fs_free_slots[fs_free_slot_count++] = (uint8_t)(handle - fs_handles);
+}
+
+/**
+ * @brief Macro to find and operate on a file descriptor handle
+ *
+ * Decodes the slot index from the file descriptor and checks the slot still
+ * holds that descriptor with the expected type, then executes the provided
+ * code block with access to the handle. Closed or stale descriptors fail the
+ * check as the slot's generation will have moved on.
+ *
+ * @param search_fd File descriptor to search for
+ * @param fd_type Expected type of the file descriptor
+ * @param block Code block to execute if handle is found
+ */
+#define FIND_FD_GET_HANDLE(search_fd, fd_type, block)                     \
+    do {                                                                  \
+        int __find_idx = fd_to_slot(search_fd);                           \
+        if (__find_idx >= 0) {                                            \
+            fs_lfs_handle_t *handle = &fs_handles[__find_idx];            \
+            if (handle->fd == (search_fd) && handle->type == (fd_type)) { \
+                {                                                         \
+                    block                                                 \
+                }                                                         \
+            }                                                             \
+        }                                                                 \
+    } while (0)
+
+/**
+ * @brief Macro to find and operate on a free handle
+ *
+ * Executes the provided code block with access to the handle which the next
+ * call to allocate_fd() will claim, if any are free.
+ *
+ * @param block Code block to execute if a handle is free
+ */
+#define FIND_FREE_HANDLE(block)                                \
+    do {                                                       \
+        int __find_idx = peek_free_slot();                     \
+        if (__find_idx >= 0) {                                 \
+            fs_lfs_handle_t *handle = &fs_handles[__find_idx]; \
+            {                                                  \
+                block                                          \
+            }                                                  \
+        }                                                      \
+    } while (0)
+
 /**
  * @brief Macro for LittleFS API calls with error logging
  *
@@ -167,25 +281,57 @@ static inline fs_fd_t allocate_fd(void) {
     })
 
 /** @brief Mutex for filesystem thread safety */
-static MUTEX_DECL(fs_mutex);
+static FS_MUTEX_DECL(fs_mutex);
+
+// The owner and depth are only read or changed within fs_critical_enter()/fs_critical_exit(), as other threads check
+// them without holding fs_mutex
+
+/** @brief Thread currently holding fs_mutex, only meaningful while fs_lock_depth is non-zero */
+static fs_thread_t fs_lock_owner;
+
+/** @brief Number of times the owning thread has acquired the filesystem lock */
+static int fs_lock_depth = 0;
 
 /**
  * @brief Acquire filesystem lock
  *
- * @return true (lock always succeeds with ChibiOS mutexes)
+ * The lock is recursive, so that public API calls can be made while a batch
+ * is held open by the same thread. The recursion is tracked here rather than
+ * relying on recursive mutexes, which ChibiOS only provides system-wide.
+ *
+ * @return true (lock always succeeds with ChibiOS/pthread mutexes)
  */
 static bool fs_lock(void) {
-    chMtxLock(&fs_mutex);
+    fs_critical_enter();
+    bool reentered = fs_lock_depth > 0 && fs_thread_is_self(fs_lock_owner);
+    if (reentered) {
+        ++fs_lock_depth;
+    }
+    fs_critical_exit();
+    if (reentered) {
+        return true;
+    }
+
+    fs_mutex_lock(&fs_mutex);
+    fs_critical_enter();
+    fs_lock_owner = fs_thread_self();
+    fs_lock_depth = 1;
+    fs_critical_exit();
     return true;
 }
 
 /**
  * @brief Release filesystem lock
  *
- * @return true (unlock always succeeds with ChibiOS mutexes)
+ * @return true (unlock always succeeds with ChibiOS/pthread mutexes)
  */
 static bool fs_unlock(void) {
-    chMtxUnlock(&fs_mutex);
+    fs_critical_enter();
+    bool released = --fs_lock_depth == 0;
+    fs_critical_exit();
+    if (released) {
+        fs_mutex_unlock(&fs_mutex);
+    }
     return true;
 }
 
@@ -232,7 +378,14 @@ static void fs_unlock_helper(bool *locked) {
 
 // Forward declarations for device functions
 extern bool  fs_device_init(void);
-extern void *fs_device_filebuf(int file_idx);
+extern void *fs_device_buffer_pool(size_t *size);
+extern bool  fs_device_erase_blocks(lfs_block_t first, lfs_size_t count);
+extern bool  fs_device_block_erased(lfs_block_t block);
+#ifdef FILESYSTEM_ASSETS
+extern const void *fs_device_assets_map(void);
+extern bool        fs_device_assets_read(uint32_t offset, void *buffer, uint32_t length);
+extern uint32_t    fs_device_assets_size(void);
+#endif // FILESYSTEM_ASSETS
 
 // Forward declarations for internal functions
 static void         fs_unmount_helper(bool *mounted);
@@ -249,7 +402,7 @@ static fs_dirent_t *fs_readdir_nolock(fs_fd_t fd);
 static void         fs_closedir_nolock(fs_fd_t fd);
 static bool         fs_exists_nolock(const char *path);
 static bool         fs_delete_nolock(const char *path);
-static fs_fd_t      fs_open_nolock(const char *filename, fs_mode_t mode);
+static fs_fd_t      fs_open_nolock(const char *filename, fs_mode_t mode, fs_access_t access, fs_size_t buffer_size);
 static fs_offset_t  fs_seek_nolock(fs_fd_t fd, fs_offset_t offset, fs_whence_t whence);
 static fs_offset_t  fs_tell_nolock(fs_fd_t fd);
 static fs_size_t    fs_read_nolock(fs_fd_t fd, void *buffer, fs_size_t length);
@@ -260,6 +413,56 @@ static void         fs_close_nolock(fs_fd_t fd);
 /** @brief Mount reference counter for nested mount/unmount calls */
 static int mount_count = 0;
 
+/** @brief Nesting depth of fs_batch_begin() calls */
+static int batch_depth = 0;
+
+/** @brief Whether the current batch holds a reference on the mount */
+static bool batch_mounted = false;
+
+/** @brief Whether the filesystem should stay mounted between operations */
+#ifdef FILESYSTEM_STAY_MOUNTED
+static bool persistent_mount = true;
+#else
+static bool persistent_mount = false;
+#endif
+
+/** @brief Whether persistent mount mode holds a reference on the mount */
+static bool persistent_mounted = false;
+
+/** @brief Counters of actual mount/unmount operations performed on the underlying filesystem */
+static fs_mount_stats_t mount_stats = {0};
+
+// Configurable: Number of erases which may accumulate before the wear counters are persisted
+#ifndef FS_WEAR_PERSIST_INTERVAL
+#    define FS_WEAR_PERSIST_INTERVAL 16
+#endif
+
+/** @brief LittleFS attribute type holding the wear counters, attached to the root directory */
+#define FS_WEAR_ATTR_TYPE 0x57
+
+/** @brief Version of the persisted wear counters */
+#define FS_WEAR_RECORD_VERSION 1
+
+/** @brief Persisted form of the wear counters */
+typedef struct __attribute__((packed)) fs_wear_record_t {
+    uint16_t version;                            /**< FS_WEAR_RECORD_VERSION */
+    uint16_t num_buckets;                        /**< FS_WEAR_NUM_BUCKETS at the time of writing */
+    uint32_t erases;                             /**< Total number of block erases */
+    uint64_t prog_bytes;                         /**< Total number of bytes programmed */
+    uint32_t bucket_erases[FS_WEAR_NUM_BUCKETS]; /**< Number of block erases within each bucket */
+} fs_wear_record_t;
+_Static_assert(sizeof(fs_wear_record_t) <= LFS_ATTR_MAX, "FS_WEAR_NUM_BUCKETS too large to persist in a littlefs attribute");
+
+/** @brief Wear counters, including any loaded from the filesystem */
+static fs_wear_stats_t wear_stats = {0};
+
+/** @brief Whether the persisted wear counters have been merged into wear_stats */
+static bool wear_loaded = false;
+
+/** @brief Values of the wear counters when they were last persisted */
+static uint32_t wear_persisted_erases     = 0;
+static uint64_t wear_persisted_prog_bytes = 0;
+
 /**
  * @brief RAII-style helper for automatic filesystem unmount
  *
@@ -295,6 +498,663 @@ static void fs_unmount_helper(bool *mounted) {
         __fs_mount = false;    \
     } while (0)
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Wear Accounting
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief Record a successful block erase
+ *
+ * Called by the device layer, with the filesystem lock held.
+ *
+ * @param block Block number which was erased
+ */
+void fs_wear_record_erase(lfs_block_t block) {
+    ++wear_stats.erases;
+    if (block < lfs_cfg.block_count) {
+        ++wear_stats.bucket_erases[(uint64_t)block * FS_WEAR_NUM_BUCKETS / lfs_cfg.block_count];
+    }
+}
+
+/**
+ * @brief Record a successful program operation
+ *
+ * Called by the device layer, with the filesystem lock held.
+ *
+ * @param size Number of bytes programmed
+ */
+void fs_wear_record_prog(lfs_size_t size) {
+    wear_stats.prog_bytes += size;
+}
+
+/**
+ * @brief Merge the persisted wear counters into the running totals (internal, not thread-safe)
+ *
+ * Only done on the first mount, later mounts would otherwise count the persisted values again.
+ * Requires the filesystem to be mounted.
+ */
+static void fs_wear_load_nolock(void) {
+    if (wear_loaded) {
+        return;
+    }
+    wear_loaded = true;
+
+    fs_wear_record_t record;
+    lfs_ssize_t      size = LFS_API_CALL(lfs_getattr, &lfs, "/", FS_WEAR_ATTR_TYPE, &record, sizeof(record));
+    if (size != sizeof(record) || record.version != FS_WEAR_RECORD_VERSION || record.num_buckets != FS_WEAR_NUM_BUCKETS) {
+        fs_dprintf("no usable wear counters\n");
+        return;
+    }
+    wear_stats.erases += record.erases;
+    wear_stats.prog_bytes += record.prog_bytes;
+    for (int i = 0; i < FS_WEAR_NUM_BUCKETS; ++i) {
+        wear_stats.bucket_erases[i] += record.bucket_erases[i];
+    }
+    wear_persisted_erases     = record.erases;
+    wear_persisted_prog_bytes = record.prog_bytes;
+}
+
+/**
+ * @brief Persist the wear counters if they've changed (internal, not thread-safe)
+ *
+ * Requires the filesystem to be mounted.
+ *
+ * @param force Persist any change, rather than waiting for FS_WEAR_PERSIST_INTERVAL erases to accumulate
+ * @return true on success or if there was nothing to persist, false on failure
+ */
+static bool fs_wear_save_nolock(bool force) {
+    if (!wear_loaded) {
+        return true;
+    }
+    uint32_t new_erases = wear_stats.erases - wear_persisted_erases;
+    if (force ? (new_erases == 0 && wear_stats.prog_bytes == wear_persisted_prog_bytes) : (new_erases < FS_WEAR_PERSIST_INTERVAL)) {
+        return true;
+    }
+
+    fs_wear_record_t record = {
+        .version     = FS_WEAR_RECORD_VERSION,
+        .num_buckets = FS_WEAR_NUM_BUCKETS,
+        .erases      = wear_stats.erases,
+        .prog_bytes  = wear_stats.prog_bytes,
+    };
+    memcpy(record.bucket_erases, wear_stats.bucket_erases, sizeof(record.bucket_erases));
+    if (LFS_API_CALL(lfs_setattr, &lfs, "/", FS_WEAR_ATTR_TYPE, &record, sizeof(record)) < 0) {
+        return false;
+    }
+    // Writing the attribute may itself erase or program, which is picked up next time around
+    wear_persisted_erases     = record.erases;
+    wear_persisted_prog_bytes = record.prog_bytes;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Buffer Pool
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// All of littlefs' buffers are carved out of a single pool provided by the device layer: the read, program and lookahead
+// caches while mounted, and each open file's cache and stream buffer. Nothing is reserved while the filesystem is idle,
+// so the pool can be lent out through fs_buffer_alloc() in the meantime.
+// Allocation is first-fit, with each buffer preceded by a header, and freeing merges neighbouring free chunks.
+
+/** @brief Header preceding each chunk of the buffer pool */
+typedef struct fs_pool_chunk_t {
+    uint32_t size; /**< Size of the chunk in bytes, excluding this header */
+    uint32_t used; /**< Whether the chunk is allocated */
+} fs_pool_chunk_t;
+
+_Static_assert(sizeof(fs_pool_chunk_t) == (FS_BUFFER_POOL_OVERHEAD), "FS_BUFFER_POOL_OVERHEAD must match the pool chunk header size");
+
+/** @brief Start of the buffer pool */
+static uint8_t *fs_pool_base = NULL;
+
+/** @brief Usable size of the buffer pool in bytes, a multiple of the chunk header size */
+static size_t fs_pool_size = 0;
+
+static inline fs_pool_chunk_t *fs_pool_next(fs_pool_chunk_t *chunk) {
+    return (fs_pool_chunk_t *)((uint8_t *)(chunk + 1) + chunk->size);
+}
+
+static inline bool fs_pool_is_end(fs_pool_chunk_t *chunk) {
+    return (uint8_t *)chunk >= fs_pool_base + fs_pool_size;
+}
+
+/**
+ * @brief Set up the buffer pool, marking it all as free, if not already done (internal, not thread-safe)
+ *
+ * Only done once, so that buffers lent out by fs_buffer_alloc() survive the filesystem being reinitialised.
+ */
+static void fs_pool_init(void) {
+    if (fs_pool_base) {
+        return;
+    }
+    fs_pool_base = fs_device_buffer_pool(&fs_pool_size);
+    fs_pool_size -= fs_pool_size % sizeof(fs_pool_chunk_t);
+    if (!fs_pool_base || fs_pool_size <= sizeof(fs_pool_chunk_t)) {
+        fs_pool_size = 0;
+        return;
+    }
+    fs_pool_chunk_t *chunk = (fs_pool_chunk_t *)fs_pool_base;
+    chunk->size            = fs_pool_size - sizeof(fs_pool_chunk_t);
+    chunk->used            = false;
+}
+
+/**
+ * @brief Allocate a buffer from the pool (internal, not thread-safe)
+ *
+ * @param size Size of the buffer in bytes
+ * @return Pointer to the buffer, aligned to 8 bytes, or NULL if there's no free chunk large enough
+ */
+static void *fs_pool_alloc(size_t size) {
+    // Rounded up so that every header stays aligned
+    size = (size + sizeof(fs_pool_chunk_t) - 1) & ~(sizeof(fs_pool_chunk_t) - 1);
+    if (size == 0) {
+        return NULL;
+    }
+    for (fs_pool_chunk_t *chunk = (fs_pool_chunk_t *)fs_pool_base; !fs_pool_is_end(chunk); chunk = fs_pool_next(chunk)) {
+        if (chunk->used || chunk->size < size) {
+            continue;
+        }
+        if (chunk->size - size > sizeof(fs_pool_chunk_t)) {
+            fs_pool_chunk_t *rest = (fs_pool_chunk_t *)((uint8_t *)(chunk + 1) + size);
+            rest->size            = chunk->size - size - sizeof(fs_pool_chunk_t);
+            rest->used            = false;
+            chunk->size           = size;
+        }
+        chunk->used = true;
+        return chunk + 1;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Return a buffer to the pool (internal, not thread-safe)
+ *
+ * @param ptr Buffer from fs_pool_alloc(), or NULL
+ */
+static void fs_pool_free(void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    ((fs_pool_chunk_t *)ptr - 1)->used = false;
+    for (fs_pool_chunk_t *chunk = (fs_pool_chunk_t *)fs_pool_base; !fs_pool_is_end(chunk); chunk = fs_pool_next(chunk)) {
+        if (chunk->used) {
+            continue;
+        }
+        fs_pool_chunk_t *next = fs_pool_next(chunk);
+        while (!fs_pool_is_end(next) && !next->used) {
+            chunk->size += sizeof(fs_pool_chunk_t) + next->size;
+            next = fs_pool_next(chunk);
+        }
+    }
+}
+
+/**
+ * @brief Get the size of the largest buffer the pool can currently provide (internal, not thread-safe)
+ *
+ * @return Size in bytes
+ */
+static size_t fs_pool_largest_free(void) {
+    size_t largest = 0;
+    for (fs_pool_chunk_t *chunk = (fs_pool_chunk_t *)fs_pool_base; !fs_pool_is_end(chunk); chunk = fs_pool_next(chunk)) {
+        if (!chunk->used && chunk->size > largest) {
+            largest = chunk->size;
+        }
+    }
+    return largest;
+}
+
+/**
+ * @brief Get the number of bytes free in the pool (internal, not thread-safe)
+ *
+ * @return Size in bytes, excluding the headers of the free chunks
+ */
+static size_t fs_pool_total_free(void) {
+    size_t total = 0;
+    for (fs_pool_chunk_t *chunk = (fs_pool_chunk_t *)fs_pool_base; !fs_pool_is_end(chunk); chunk = fs_pool_next(chunk)) {
+        if (!chunk->used) {
+            total += chunk->size;
+        }
+    }
+    return total;
+}
+
+/** @brief Configuration littlefs is mounted and formatted with: the driver's, plus buffers allocated from the pool */
+static struct lfs_config fs_mount_cfg;
+
+/**
+ * @brief Return littlefs' read, program and lookahead buffers to the pool (internal, not thread-safe)
+ */
+static void fs_mount_buffers_release(void) {
+    fs_pool_free(fs_mount_cfg.read_buffer);
+    fs_pool_free(fs_mount_cfg.prog_buffer);
+    fs_pool_free(fs_mount_cfg.lookahead_buffer);
+    fs_mount_cfg.read_buffer      = NULL;
+    fs_mount_cfg.prog_buffer      = NULL;
+    fs_mount_cfg.lookahead_buffer = NULL;
+}
+
+/**
+ * @brief Allocate littlefs' read, program and lookahead buffers from the pool, if not already held (internal, not thread-safe)
+ *
+ * Takes a fresh copy of the driver's configuration, as fs_device_init() may have resized it.
+ *
+ * @return true on success, false if the pool couldn't provide them
+ */
+static bool fs_mount_buffers_acquire(void) {
+    if (fs_mount_cfg.read_buffer) {
+        return true;
+    }
+    fs_pool_init();
+    fs_mount_cfg                  = lfs_cfg;
+    fs_mount_cfg.read_buffer      = fs_pool_alloc(lfs_cfg.cache_size);
+    fs_mount_cfg.prog_buffer      = fs_pool_alloc(lfs_cfg.cache_size);
+    fs_mount_cfg.lookahead_buffer = fs_pool_alloc(lfs_cfg.lookahead_size);
+    if (!fs_mount_cfg.read_buffer || !fs_mount_cfg.prog_buffer || !fs_mount_cfg.lookahead_buffer) {
+        fs_dprintf("no buffers to mount with, %lu bytes free\n", (unsigned long)fs_pool_total_free());
+        fs_mount_buffers_release();
+        return false;
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Bulk Erase
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Configurable: Number of blocks examined per filesystem traversal when erasing free space, trading passes over the
+// metadata against stack usage
+#ifndef FS_ERASE_SCAN_WINDOW
+#    define FS_ERASE_SCAN_WINDOW 256
+#endif
+
+_Static_assert((FS_ERASE_SCAN_WINDOW) % 32 == 0, "FS_ERASE_SCAN_WINDOW must be a multiple of 32");
+
+/** @brief Window of blocks being scanned for use */
+typedef struct fs_erase_scan_t {
+    lfs_block_t start;                                /**< First block in the window */
+    uint32_t    in_use[(FS_ERASE_SCAN_WINDOW) / 32]; /**< Blocks referenced by the filesystem */
+} fs_erase_scan_t;
+
+/**
+ * @brief Traversal callback marking in-use blocks within the scan window
+ *
+ * The window may wrap around the end of the device.
+ */
+static int fs_erase_scan_cb(void *data, lfs_block_t block) {
+    fs_erase_scan_t *scan = (fs_erase_scan_t *)data;
+    lfs_block_t      idx  = block >= scan->start ? block - scan->start : block + lfs_cfg.block_count - scan->start;
+    if (idx < (FS_ERASE_SCAN_WINDOW)) {
+        scan->in_use[idx / 32] |= 1UL << (idx % 32);
+    }
+    return 0;
+}
+
+/**
+ * @brief Erase all blocks not in use by the filesystem (internal, not thread-safe)
+ *
+ * Free blocks are gathered into runs and handed to the device layer, which
+ * erases them with the largest erase commands that fit and remembers them as
+ * erased, so littlefs allocating them later costs program time only.
+ * The filesystem must be mounted.
+ *
+ * @return true on success, false on failure
+ */
+static bool fs_erase_free_nolock(void) {
+    for (lfs_block_t start = 0; start < lfs_cfg.block_count; start += (FS_ERASE_SCAN_WINDOW)) {
+        fs_erase_scan_t scan = {.start = start};
+        if (LFS_API_CALL(lfs_fs_traverse, &lfs, fs_erase_scan_cb, &scan) < 0) {
+            return false;
+        }
+
+        lfs_block_t end       = (lfs_cfg.block_count - start < (FS_ERASE_SCAN_WINDOW)) ? lfs_cfg.block_count : start + (FS_ERASE_SCAN_WINDOW);
+        lfs_block_t run_start = end;
+        for (lfs_block_t block = start; block <= end; ++block) {
+            lfs_block_t idx     = block - start;
+            bool        pending = block < end && !(scan.in_use[idx / 32] & (1UL << (idx % 32))) && !fs_device_block_erased(block);
+            if (pending && run_start == end) {
+                run_start = block;
+            } else if (!pending && run_start != end) {
+                if (!fs_device_erase_blocks(run_start, block - run_start)) {
+                    return false;
+                }
+                run_start = end;
+            }
+        }
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Pre-erase
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Free blocks are erased a few at a time while the keyboard is idle, so that the next ones littlefs will allocate are
+// ready without waiting on an erase. littlefs' allocator starts from a position derived from the metadata at mount and
+// moves forward through the device from there, so the pool is the first few free blocks after its current position.
+// Which blocks are erased is only known until the next reboot, after which littlefs erases any that weren't allocated
+// yet a second time.
+
+// Configurable: Number of free blocks ahead of littlefs' allocator kept erased by fs_pre_erase()
+#ifndef FS_PRE_ERASE_POOL_BLOCKS
+#    define FS_PRE_ERASE_POOL_BLOCKS 8
+#endif
+
+/** @brief Bytes programmed when the pool was last found full, so it isn't checked again until more is written */
+static uint64_t pre_erase_full_at = UINT64_MAX;
+
+/**
+ * @brief Whether the pre-erase pool may need topping up (internal, not thread-safe)
+ *
+ * Anything written may have allocated from the pool or, on remount, moved the allocator's starting position.
+ */
+static bool fs_pre_erase_wanted_nolock(void) {
+    return wear_stats.prog_bytes != pre_erase_full_at;
+}
+
+/**
+ * @brief Block littlefs' allocator examines next (internal, not thread-safe)
+ *
+ * The filesystem must be mounted.
+ */
+static lfs_block_t fs_alloc_position_nolock(void) {
+#if LFS_VERSION >= 0x00020009
+    return (lfs.lookahead.start + lfs.lookahead.next) % lfs_cfg.block_count;
+#else
+    return (lfs.free.off + lfs.free.i) % lfs_cfg.block_count;
+#endif
+}
+
+/**
+ * @brief Erase the free blocks littlefs will allocate next (internal, not thread-safe)
+ *
+ * Walks forward from the allocator's position until FS_PRE_ERASE_POOL_BLOCKS
+ * free blocks are known to be erased, erasing at most max_blocks of them.
+ * The filesystem must be mounted.
+ *
+ * @param max_blocks Most blocks to erase
+ * @return Number of blocks erased
+ */
+static uint32_t fs_pre_erase_nolock(uint32_t max_blocks) {
+    fs_erase_scan_t scan = {.start = fs_alloc_position_nolock()};
+    if (LFS_API_CALL(lfs_fs_traverse, &lfs, fs_erase_scan_cb, &scan) < 0) {
+        return 0;
+    }
+
+    lfs_block_t window = lfs_cfg.block_count < (FS_ERASE_SCAN_WINDOW) ? lfs_cfg.block_count : (FS_ERASE_SCAN_WINDOW);
+    lfs_block_t idx    = 0;
+    uint32_t    ready  = 0;
+    uint32_t    erased = 0;
+    for (; idx < window && ready < (FS_PRE_ERASE_POOL_BLOCKS); ++idx) {
+        lfs_block_t block = (scan.start + idx) % lfs_cfg.block_count;
+        if (scan.in_use[idx / 32] & (1UL << (idx % 32))) {
+            continue;
+        }
+        if (!fs_device_block_erased(block)) {
+            if (erased == max_blocks) {
+                return erased;
+            }
+            // Failures leave the block marked as unknown, littlefs erases it again when it's allocated
+            if (!fs_device_erase_blocks(block, 1)) {
+                continue;
+            }
+            ++erased;
+        }
+        ++ready;
+    }
+
+    // Either the pool is full, or the window ran out of free blocks; nothing changes until something is written
+    pre_erase_full_at = wear_stats.prog_bytes;
+    return erased;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Asset Pack
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifdef FILESYSTEM_ASSETS
+// Immutable assets are served from a read-only pack in their own flash partition, laid out as per fs_asset_pack.h, and
+// appear under FS_ASSETS_PREFIX alongside littlefs. Lookups binary search the pack's sorted index, and each payload is
+// contiguous, so opening an asset never mounts littlefs or walks its metadata. Where the device layer can memory-map
+// the partition, everything is read in place; otherwise each read is a single device read.
+
+/** @brief Header of the asset pack, valid once fs_assets_checked is set and the magic matches */
+static fs_asset_pack_header_t fs_assets_header;
+
+/** @brief Whether the asset pack header has been read since the last fs_init() */
+static bool fs_assets_checked = false;
+
+/**
+ * @brief Get the name of an asset within the pack from a path (internal)
+ *
+ * @param path Path, with or without a leading slash
+ * @return Name relative to FS_ASSETS_PREFIX, empty for the prefix itself, or NULL if the path is outside it
+ */
+static const char *fs_asset_name(const char *path) {
+    static const char prefix[] = FS_ASSETS_PREFIX;
+    while (*path == '/') {
+        ++path;
+    }
+    if (strncmp(path, prefix, sizeof(prefix) - 1) != 0) {
+        return NULL;
+    }
+    path += sizeof(prefix) - 1;
+    if (*path == '\0') {
+        return path;
+    }
+    return *path == '/' ? path + 1 : NULL;
+}
+
+/**
+ * @brief Read from the asset pack (internal, not thread-safe)
+ *
+ * @param offset Offset from the start of the pack
+ * @param buffer Buffer to fill
+ * @param length Number of bytes to read
+ * @return true on success
+ */
+static bool fs_asset_read_raw(uint32_t offset, void *buffer, uint32_t length) {
+    const uint8_t *mapped = fs_device_assets_map();
+    if (mapped) {
+        memcpy(buffer, mapped + offset, length);
+        return true;
+    }
+    return fs_device_assets_read(offset, buffer, length);
+}
+
+/**
+ * @brief Check the asset pack is present and well-formed, reading its header on first use (internal, not thread-safe)
+ *
+ * @return true if the pack can be used
+ */
+static bool fs_assets_valid_nolock(void) {
+    if (!fs_assets_checked) {
+        fs_assets_checked = true;
+        if (!fs_asset_read_raw(0, &fs_assets_header, sizeof(fs_assets_header))) {
+            memset(&fs_assets_header, 0, sizeof(fs_assets_header));
+        }
+        uint32_t index_end = sizeof(fs_asset_pack_header_t) + (uint32_t)fs_assets_header.count * sizeof(fs_asset_pack_entry_t);
+        if (fs_assets_header.magic != FS_ASSET_PACK_MAGIC || fs_assets_header.version != FS_ASSET_PACK_VERSION || fs_assets_header.size < index_end || fs_assets_header.size > fs_device_assets_size()) {
+            fs_dprintf("no usable asset pack\n");
+            fs_assets_header.magic = 0;
+        }
+    }
+    return fs_assets_header.magic == FS_ASSET_PACK_MAGIC;
+}
+
+/**
+ * @brief Read an index entry of the asset pack (internal, not thread-safe)
+ *
+ * @param index Entry number, less than the header's count
+ * @param entry Entry to fill, its name always terminated
+ * @return true on success, false on a read failure or if the entry's payload lies outside the pack
+ */
+static bool fs_asset_entry_nolock(uint16_t index, fs_asset_pack_entry_t *entry) {
+    if (!fs_asset_read_raw(sizeof(fs_asset_pack_header_t) + (uint32_t)index * sizeof(fs_asset_pack_entry_t), entry, sizeof(*entry))) {
+        return false;
+    }
+    entry->name[FS_ASSET_NAME_MAX] = '\0';
+    return entry->offset <= fs_assets_header.size && entry->size <= fs_assets_header.size - entry->offset;
+}
+
+/**
+ * @brief Find an asset in the pack's index (internal, not thread-safe)
+ *
+ * @param name Name relative to FS_ASSETS_PREFIX
+ * @param entry Entry to fill if found
+ * @return true if found
+ */
+static bool fs_asset_find_nolock(const char *name, fs_asset_pack_entry_t *entry) {
+    if (!fs_assets_valid_nolock() || strlen(name) > FS_ASSET_NAME_MAX) {
+        return false;
+    }
+    uint16_t low  = 0;
+    uint16_t high = fs_assets_header.count;
+    while (low < high) {
+        uint16_t mid = low + (high - low) / 2;
+        if (!fs_asset_entry_nolock(mid, entry)) {
+            return false;
+        }
+        int cmp = strcmp(name, entry->name);
+        if (cmp == 0) {
+            return true;
+        }
+        if (cmp < 0) {
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Check whether an asset path exists (internal, not thread-safe)
+ *
+ * @param name Name relative to FS_ASSETS_PREFIX, empty for the prefix itself
+ * @return true if the asset exists, or the prefix was given and the pack is usable
+ */
+static bool fs_asset_exists_nolock(const char *name) {
+    if (*name == '\0') {
+        return fs_assets_valid_nolock();
+    }
+    fs_asset_pack_entry_t entry;
+    return fs_asset_find_nolock(name, &entry);
+}
+
+/**
+ * @brief Open an asset (internal, not thread-safe)
+ *
+ * @param name Name relative to FS_ASSETS_PREFIX
+ * @param mode File access mode, which must be FS_READ
+ * @return File descriptor on success, INVALID_FILESYSTEM_FD on failure
+ */
+static fs_fd_t fs_asset_open_nolock(const char *name, fs_mode_t mode) {
+    if (mode != FS_READ) {
+        fs_dprintf("assets are read-only\n");
+        return INVALID_FILESYSTEM_FD;
+    }
+    FIND_FREE_HANDLE({
+        fs_asset_pack_entry_t entry;
+        if (!fs_asset_find_nolock(name, &entry)) {
+            return INVALID_FILESYSTEM_FD;
+        }
+
+        handle->asset.offset = entry.offset;
+        handle->asset.size   = entry.size;
+        handle->asset.pos    = 0;
+
+        fs_fd_t fd   = allocate_fd();
+        handle->fd   = fd;
+        handle->type = FD_TYPE_ASSET;
+        return fd;
+    });
+    return INVALID_FILESYSTEM_FD;
+}
+
+/**
+ * @brief Read from an open asset (internal, not thread-safe)
+ *
+ * @param handle Handle of the asset
+ * @param buffer Buffer to store read data
+ * @param length Number of bytes to read
+ * @return Number of bytes read, or -1 on failure
+ */
+static fs_size_t fs_asset_read_nolock(fs_lfs_handle_t *handle, void *buffer, fs_size_t length) {
+    if (length < 0) {
+        return -1;
+    }
+    uint32_t remaining = handle->asset.size - handle->asset.pos;
+    uint32_t count     = (uint32_t)length < remaining ? (uint32_t)length : remaining;
+    if (count > 0) {
+        if (!fs_asset_read_raw(handle->asset.offset + handle->asset.pos, buffer, count)) {
+            return -1;
+        }
+        handle->asset.pos += count;
+    }
+    return (fs_size_t)count;
+}
+
+/**
+ * @brief Seek within an open asset (internal, not thread-safe)
+ *
+ * @param handle Handle of the asset
+ * @param offset Offset in bytes
+ * @param whence Seek origin (SET/CUR/END)
+ * @return New position on success, -1 if it would lie outside the asset
+ */
+static fs_offset_t fs_asset_seek_nolock(fs_lfs_handle_t *handle, fs_offset_t offset, fs_whence_t whence) {
+    int64_t target = offset;
+    if (whence == FS_SEEK_CUR) {
+        target += handle->asset.pos;
+    } else if (whence == FS_SEEK_END) {
+        target += handle->asset.size;
+    }
+    if (target < 0 || target > (int64_t)handle->asset.size) {
+        return -1;
+    }
+    handle->asset.pos = (uint32_t)target;
+    return (fs_offset_t)target;
+}
+
+/**
+ * @brief Open the listing of the asset pack (internal, not thread-safe)
+ *
+ * @return File descriptor on success, INVALID_FILESYSTEM_FD on failure
+ */
+static fs_fd_t fs_asset_opendir_nolock(void) {
+    if (!fs_assets_valid_nolock()) {
+        return INVALID_FILESYSTEM_FD;
+    }
+    FIND_FREE_HANDLE({
+        handle->asset_dir.next = 0;
+
+        fs_fd_t fd   = allocate_fd();
+        handle->fd   = fd;
+        handle->type = FD_TYPE_ASSET_DIR;
+        return fd;
+    });
+    return INVALID_FILESYSTEM_FD;
+}
+
+/**
+ * @brief Read the next entry of the asset pack's listing (internal, not thread-safe)
+ *
+ * @param handle Handle of the listing
+ * @return Pointer to the directory entry, or NULL at the end of the listing or on error
+ */
+static fs_dirent_t *fs_asset_readdir_nolock(fs_lfs_handle_t *handle) {
+    fs_asset_pack_entry_t entry;
+    if (handle->asset_dir.next >= fs_assets_header.count || !fs_asset_entry_nolock(handle->asset_dir.next++, &entry)) {
+        return NULL;
+    }
+    memcpy(handle->asset_dir.name, entry.name, sizeof(handle->asset_dir.name));
+    handle->asset_dir.dirent.name   = handle->asset_dir.name;
+    handle->asset_dir.dirent.size   = (fs_size_t)entry.size;
+    handle->asset_dir.dirent.is_dir = false;
+    return &handle->asset_dir.dirent;
+}
+#endif // FILESYSTEM_ASSETS
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Internal LittleFS Implementation Functions
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -311,9 +1171,23 @@ static bool fs_format_nolock(void) {
     while (fs_is_mounted_nolock()) {
         fs_unmount_nolock();
     }
-    if (LFS_API_CALL(lfs_format, &lfs, &lfs_cfg) < 0) {
+    batch_mounted      = false;
+    persistent_mounted = false;
+#ifdef FILESYSTEM_BULK_ERASE
+    // Erase the whole device with the largest erase commands available, so subsequent allocations skip erasing
+    fs_device_erase_blocks(0, lfs_cfg.block_count);
+#endif // FILESYSTEM_BULK_ERASE
+    // Held over into the mount at the end of fs_init_nolock()
+    if (!fs_mount_buffers_acquire()) {
+        return false;
+    }
+    if (LFS_API_CALL(lfs_format, &lfs, &fs_mount_cfg) < 0) {
+        fs_mount_buffers_release();
         return false;
     }
+    // Formatting discarded the persisted counters, the running totals still hold everything so write them out afresh
+    wear_persisted_erases     = 0;
+    wear_persisted_prog_bytes = 0;
     return fs_init_nolock();
 }
 
@@ -329,8 +1203,25 @@ static bool fs_init_nolock(void) {
     while (fs_is_mounted_nolock()) {
         fs_unmount_nolock();
     }
+    batch_mounted      = false;
+    persistent_mounted = false;
+    // Any open handles are discarded, so their buffers go back to the pool
+    for (int i = 0; i < FS_MAX_NUM_OPEN_FDS; ++i) {
+        if (fs_handles[i].type == FD_TYPE_FILE) {
+            fs_pool_free(fs_handles[i].file.cfg.buffer);
+            fs_pool_free(fs_handles[i].file.stream_buf);
+        }
+    }
     memset(fs_handles, 0, sizeof(fs_handles));
-    return fs_device_init() && fs_mount_nolock();
+    reset_free_slots();
+    if (!fs_device_init()) {
+        return false;
+    }
+    fs_pool_init();
+#ifdef FILESYSTEM_ASSETS
+    fs_assets_checked = false;
+#endif // FILESYSTEM_ASSETS
+    return fs_mount_nolock();
 }
 
 /**
@@ -338,23 +1229,44 @@ static bool fs_init_nolock(void) {
  *
  * Attempts to mount the filesystem, formatting if necessary.
  * Implements reference counting for nested mount calls.
+ * The first mount within a batch takes an extra reference, held until the batch is committed.
+ * Similarly, the first mount in persistent mount mode takes an extra reference, held until the mode is disabled.
  *
  * @return true on success, false on failure
  */
 static bool fs_mount_nolock(void) {
     if (!fs_is_mounted_nolock()) {
+        if (!fs_mount_buffers_acquire()) {
+            return false;
+        }
         // reformat if we can't mount the filesystem
         // this should only happen on the first boot
-        if (LFS_API_CALL(lfs_mount, &lfs, &lfs_cfg) < 0) {
-            if (!fs_format_nolock()) {
-                return false;
+        ++mount_stats.mounts;
+        if (LFS_API_CALL(lfs_mount, &lfs, &fs_mount_cfg) < 0) {
+            bool ok = fs_format_nolock();
+            if (ok) {
+                ++mount_stats.mounts;
+                ok = LFS_API_CALL(lfs_mount, &lfs, &fs_mount_cfg) >= 0;
             }
-            if (LFS_API_CALL(lfs_mount, &lfs, &lfs_cfg) < 0) {
+            if (!ok) {
+                // Don't sit on the buffers without a mount to use them
+                if (!fs_is_mounted_nolock()) {
+                    fs_mount_buffers_release();
+                }
                 return false;
             }
         }
+        fs_wear_load_nolock();
     }
     ++mount_count;
+    if (batch_depth > 0 && !batch_mounted) {
+        ++mount_count;
+        batch_mounted = true;
+    }
+    if (persistent_mount && !persistent_mounted) {
+        ++mount_count;
+        persistent_mounted = true;
+    }
     return true;
 }
 
@@ -365,9 +1277,14 @@ static bool fs_mount_nolock(void) {
  */
 static void fs_unmount_nolock(void) {
     if (fs_is_mounted_nolock()) {
+        if (mount_count == 1) {
+            fs_wear_save_nolock(false);
+        }
         --mount_count;
         if (mount_count == 0) {
+            ++mount_stats.unmounts;
             LFS_API_CALL(lfs_unmount, &lfs);
+            fs_mount_buffers_release();
         }
     }
 }
@@ -388,6 +1305,11 @@ static bool fs_is_mounted_nolock(void) {
  * @return true on success or if directory already exists, false on failure
  */
 static bool fs_mkdir_nolock(const char *path) {
+#ifdef FILESYSTEM_ASSETS
+    if (fs_asset_name(path)) {
+        return false; // The asset pack is read-only
+    }
+#endif // FILESYSTEM_ASSETS
     FS_AUTO_MOUNT_UNMOUNT(false);
 
     int err = LFS_API_CALL(lfs_mkdir, &lfs, path);
@@ -406,6 +1328,11 @@ static bool fs_rmdir_nolock(const char *path, bool recursive, int depth) {
     if (depth > FS_MAX_FILE_DEPTH) {
         return false; // Prevent stack overflow and enforce depth limits
     }
+#ifdef FILESYSTEM_ASSETS
+    if (fs_asset_name(path)) {
+        return false; // The asset pack is read-only
+    }
+#endif // FILESYSTEM_ASSETS
 
     FS_AUTO_MOUNT_UNMOUNT(false);
 
@@ -448,7 +1375,16 @@ static bool fs_rmdir_nolock(const char *path, bool recursive, int depth) {
         }
     }
 
-    return fs_delete_nolock(path);
+    if (!fs_delete_nolock(path)) {
+        return false;
+    }
+#ifdef FILESYSTEM_BULK_ERASE
+    // Reclaim everything released by a recursive removal in as few erases as possible
+    if (recursive && depth == 0) {
+        fs_erase_free_nolock();
+    }
+#endif // FILESYSTEM_BULK_ERASE
+    return true;
 }
 
 /**
@@ -458,7 +1394,14 @@ static bool fs_rmdir_nolock(const char *path, bool recursive, int depth) {
  * @return File descriptor on success, INVALID_FILESYSTEM_FD on failure
  */
 static fs_fd_t fs_opendir_nolock(const char *path) {
-    FIND_FD_GET_HANDLE(INVALID_FILESYSTEM_FD, FD_TYPE_EMPTY, {
+#ifdef FILESYSTEM_ASSETS
+    const char *asset_name = fs_asset_name(path);
+    if (asset_name) {
+        // The pack is flat, so only the prefix itself can be listed
+        return *asset_name == '\0' ? fs_asset_opendir_nolock() : INVALID_FILESYSTEM_FD;
+    }
+#endif // FILESYSTEM_ASSETS
+    FIND_FREE_HANDLE({
         FS_AUTO_MOUNT_UNMOUNT(INVALID_FILESYSTEM_FD);
 
         if (LFS_API_CALL(lfs_dir_open, &lfs, &handle->dir.dir_handle, path) < 0) {
@@ -507,6 +1450,11 @@ static fs_dirent_t *fs_readdir_explicit_nolock(lfs_dir_t *dir_handle, struct lfs
  * @return Pointer to directory entry on success, NULL on end or error
  */
 static fs_dirent_t *fs_readdir_nolock(fs_fd_t fd) {
+#ifdef FILESYSTEM_ASSETS
+    FIND_FD_GET_HANDLE(fd, FD_TYPE_ASSET_DIR, {
+        return fs_asset_readdir_nolock(handle);
+    });
+#endif // FILESYSTEM_ASSETS
     FIND_FD_GET_HANDLE(fd, FD_TYPE_DIR, {
         // Offload to helper
         return fs_readdir_explicit_nolock(&handle->dir.dir_handle, &handle->dir.entry_info, &handle->dir.dirent);
@@ -520,11 +1468,16 @@ static fs_dirent_t *fs_readdir_nolock(fs_fd_t fd) {
  * @param fd Directory file descriptor to close
  */
 static void fs_closedir_nolock(fs_fd_t fd) {
+#ifdef FILESYSTEM_ASSETS
+    FIND_FD_GET_HANDLE(fd, FD_TYPE_ASSET_DIR, {
+        release_handle(handle);
+        return;
+    });
+#endif // FILESYSTEM_ASSETS
     FIND_FD_GET_HANDLE(fd, FD_TYPE_DIR, {
         LFS_API_CALL(lfs_dir_close, &lfs, &handle->dir.dir_handle);
 
-        handle->fd   = INVALID_FILESYSTEM_FD;
-        handle->type = FD_TYPE_EMPTY;
+        release_handle(handle);
 
         fs_unmount_nolock(); // we can unmount here, mirrors the open in fs_opendir()
         return;
@@ -538,6 +1491,12 @@ static void fs_closedir_nolock(fs_fd_t fd) {
  * @return true if exists, false otherwise
  */
 static bool fs_exists_nolock(const char *path) {
+#ifdef FILESYSTEM_ASSETS
+    const char *asset_name = fs_asset_name(path);
+    if (asset_name) {
+        return fs_asset_exists_nolock(asset_name);
+    }
+#endif // FILESYSTEM_ASSETS
     FS_AUTO_MOUNT_UNMOUNT(false);
     struct lfs_info info;
     int             err = lfs_stat(&lfs, path, &info); // Note: Don't use LFS_API_CALL here - file not existing is expected, not an error
@@ -551,6 +1510,11 @@ static bool fs_exists_nolock(const char *path) {
  * @return true on success or if already deleted, false on failure
  */
 static bool fs_delete_nolock(const char *path) {
+#ifdef FILESYSTEM_ASSETS
+    if (fs_asset_name(path)) {
+        return false; // The asset pack is read-only
+    }
+#endif // FILESYSTEM_ASSETS
     FS_AUTO_MOUNT_UNMOUNT(false);
     if (!fs_exists_nolock(path)) {
         return true;
@@ -564,10 +1528,19 @@ static bool fs_delete_nolock(const char *path) {
  *
  * @param filename File path to open
  * @param mode File access mode (read/write/truncate flags)
+ * @param access Access pattern hint
+ * @param buffer_size Requested stream buffer size for FS_ACCESS_SEQUENTIAL
  * @return File descriptor on success, INVALID_FILESYSTEM_FD on failure
  */
-static fs_fd_t fs_open_nolock(const char *filename, fs_mode_t mode) {
-    FIND_FD_GET_HANDLE(INVALID_FILESYSTEM_FD, FD_TYPE_EMPTY, {
+static fs_fd_t fs_open_nolock(const char *filename, fs_mode_t mode, fs_access_t access, fs_size_t buffer_size) {
+#ifdef FILESYSTEM_ASSETS
+    // Assets are read in a single device read each, so there's nothing for a stream buffer to save
+    const char *asset_name = fs_asset_name(filename);
+    if (asset_name) {
+        return fs_asset_open_nolock(asset_name, mode);
+    }
+#endif // FILESYSTEM_ASSETS
+    FIND_FREE_HANDLE({
         FS_AUTO_MOUNT_UNMOUNT(INVALID_FILESYSTEM_FD);
 
         int flags = 0;
@@ -582,13 +1555,35 @@ static fs_fd_t fs_open_nolock(const char *filename, fs_mode_t mode) {
             flags |= LFS_O_TRUNC;
         }
 
-        memset(&handle->file.cfg, 0, sizeof(handle->file.cfg));
-        handle->file.cfg.buffer = fs_device_filebuf(__find_idx);
+        memset(&handle->file, 0, sizeof(handle->file));
+        handle->file.cfg.buffer = fs_pool_alloc(lfs_cfg.cache_size);
+        if (!handle->file.cfg.buffer) {
+            fs_dprintf("no buffer for %s\n", filename);
+            return INVALID_FILESYSTEM_FD;
+        }
 
         if (LFS_API_CALL(lfs_file_opencfg, &lfs, &handle->file.file_handle, filename, flags, &handle->file.cfg) < 0) {
+            fs_pool_free(handle->file.cfg.buffer);
             return INVALID_FILESYSTEM_FD;
         }
 
+        // Stream buffers only pay off for reads, and only if they hold more than the file cache
+        if (access == FS_ACCESS_SEQUENTIAL && mode == FS_READ && buffer_size > 0) {
+            // Shrunk to fit if need be, but always leaving room in the pool for another file's cache, so that one large
+            // stream buffer can't make every later fs_open() fail
+            lfs_size_t stream_size = (lfs_size_t)buffer_size;
+            size_t     largest     = fs_pool_largest_free();
+            size_t     reserve     = lfs_cfg.cache_size + sizeof(fs_pool_chunk_t);
+            size_t     available   = largest > reserve ? (largest - reserve) & ~(sizeof(fs_pool_chunk_t) - 1) : 0;
+            if (stream_size > available) {
+                stream_size = available;
+            }
+            if (stream_size > lfs_cfg.cache_size) {
+                handle->file.stream_buf  = fs_pool_alloc(stream_size);
+                handle->file.stream_size = stream_size;
+            }
+        }
+
         fs_fd_t fd   = allocate_fd();
         handle->fd   = fd;
         handle->type = FD_TYPE_FILE;
@@ -609,11 +1604,37 @@ static fs_fd_t fs_open_nolock(const char *filename, fs_mode_t mode) {
  * @return New position on success, -1 on failure
  */
 static fs_offset_t fs_seek_nolock(fs_fd_t fd, fs_offset_t offset, fs_whence_t whence) {
+#ifdef FILESYSTEM_ASSETS
+    FIND_FD_GET_HANDLE(fd, FD_TYPE_ASSET, {
+        return fs_asset_seek_nolock(handle, offset, whence);
+    });
+#endif // FILESYSTEM_ASSETS
     FIND_FD_GET_HANDLE(fd, FD_TYPE_FILE, {
         if (!fs_is_mounted_nolock()) {
             return -1;
         }
 
+        if (handle->file.stream_buf) {
+            lfs_soff_t end = LFS_API_CALL(lfs_file_tell, &lfs, &handle->file.file_handle);
+            if (end < 0) {
+                return -1;
+            }
+            // Seeks within what's already buffered don't need to touch littlefs
+            lfs_soff_t start  = end - (lfs_soff_t)handle->file.stream_len;
+            lfs_soff_t target = (lfs_soff_t)offset;
+            if (whence == FS_SEEK_CUR) {
+                target += start + (lfs_soff_t)handle->file.stream_pos;
+                whence = FS_SEEK_SET;
+            }
+            if (whence == FS_SEEK_SET && target >= start && target <= end) {
+                handle->file.stream_pos = (lfs_size_t)(target - start);
+                return (fs_offset_t)target;
+            }
+            handle->file.stream_pos = 0;
+            handle->file.stream_len = 0;
+            offset                  = (fs_offset_t)target;
+        }
+
         // Validate enum values match at compile time
         _Static_assert((int)FS_SEEK_SET == (int)LFS_SEEK_SET, "FS_SEEK_SET must match LFS_SEEK_SET");
         _Static_assert((int)FS_SEEK_CUR == (int)LFS_SEEK_CUR, "FS_SEEK_CUR must match LFS_SEEK_CUR");
@@ -636,17 +1657,63 @@ static fs_offset_t fs_seek_nolock(fs_fd_t fd, fs_offset_t offset, fs_whence_t wh
  * @return Current position in bytes, or -1 on failure
  */
 static fs_offset_t fs_tell_nolock(fs_fd_t fd) {
+#ifdef FILESYSTEM_ASSETS
+    FIND_FD_GET_HANDLE(fd, FD_TYPE_ASSET, {
+        return (fs_offset_t)handle->asset.pos;
+    });
+#endif // FILESYSTEM_ASSETS
     FIND_FD_GET_HANDLE(fd, FD_TYPE_FILE, {
         if (!fs_is_mounted_nolock()) {
             return -1;
         }
 
         fs_offset_t offset = (fs_offset_t)LFS_API_CALL(lfs_file_tell, &lfs, &handle->file.file_handle);
-        return (offset < 0) ? -1 : offset;
+        return (offset < 0) ? -1 : offset - (fs_offset_t)(handle->file.stream_len - handle->file.stream_pos);
     });
     return -1;
 }
 
+/**
+ * @brief Read data from a file through its stream buffer (internal, not thread-safe)
+ *
+ * Small reads are served from the stream buffer, which is refilled with a
+ * single littlefs read when empty. Reads at least as large as the buffer go
+ * straight through, as littlefs reads those from the device without caching.
+ *
+ * @param handle Handle of the file, which must have a stream buffer
+ * @param buffer Buffer to store read data
+ * @param length Number of bytes to read
+ * @return Number of bytes read, or -1 on failure
+ */
+static fs_size_t fs_stream_read_nolock(fs_lfs_handle_t *handle, uint8_t *buffer, lfs_size_t length) {
+    lfs_size_t done = 0;
+    while (done < length) {
+        lfs_size_t available = handle->file.stream_len - handle->file.stream_pos;
+        if (available == 0) {
+            handle->file.stream_pos = 0;
+            handle->file.stream_len = 0;
+            if (length - done >= handle->file.stream_size) {
+                lfs_ssize_t ret = LFS_API_CALL(lfs_file_read, &lfs, &handle->file.file_handle, buffer + done, length - done);
+                if (ret < 0) {
+                    return done > 0 ? (fs_size_t)done : -1;
+                }
+                return (fs_size_t)(done + ret);
+            }
+            lfs_ssize_t ret = LFS_API_CALL(lfs_file_read, &lfs, &handle->file.file_handle, handle->file.stream_buf, handle->file.stream_size);
+            if (ret <= 0) {
+                return (ret < 0 && done == 0) ? -1 : (fs_size_t)done;
+            }
+            handle->file.stream_len = (lfs_size_t)ret;
+            available               = (lfs_size_t)ret;
+        }
+        lfs_size_t count = (available < length - done) ? available : length - done;
+        memcpy(buffer + done, handle->file.stream_buf + handle->file.stream_pos, count);
+        handle->file.stream_pos += count;
+        done += count;
+    }
+    return (fs_size_t)done;
+}
+
 /**
  * @brief Read data from file (internal, not thread-safe)
  *
@@ -656,12 +1723,22 @@ static fs_offset_t fs_tell_nolock(fs_fd_t fd) {
  * @return Number of bytes read, or -1 on failure
  */
 static fs_size_t fs_read_nolock(fs_fd_t fd, void *buffer, fs_size_t length) {
+#ifdef FILESYSTEM_ASSETS
+    FIND_FD_GET_HANDLE(fd, FD_TYPE_ASSET, {
+        return fs_asset_read_nolock(handle, buffer, length);
+    });
+#endif // FILESYSTEM_ASSETS
     FIND_FD_GET_HANDLE(fd, FD_TYPE_FILE, {
         if (!fs_is_mounted_nolock()) {
             return -1;
         }
 
-        fs_size_t ret = (fs_size_t)LFS_API_CALL(lfs_file_read, &lfs, &handle->file.file_handle, buffer, (lfs_size_t)length);
+        fs_size_t ret;
+        if (handle->file.stream_buf) {
+            ret = fs_stream_read_nolock(handle, (uint8_t *)buffer, (lfs_size_t)length);
+        } else {
+            ret = (fs_size_t)LFS_API_CALL(lfs_file_read, &lfs, &handle->file.file_handle, buffer, (lfs_size_t)length);
+        }
 
         // Write out a hexdump of the data if FILESYSTEM_DEBUG is defined
 #ifdef FILESYSTEM_DEBUG
@@ -718,10 +1795,18 @@ static fs_size_t fs_write_nolock(fs_fd_t fd, const void *buffer, fs_size_t lengt
  * @return true if at EOF or on error, false otherwise
  */
 static bool fs_is_eof_nolock(fs_fd_t fd) {
+#ifdef FILESYSTEM_ASSETS
+    FIND_FD_GET_HANDLE(fd, FD_TYPE_ASSET, {
+        return handle->asset.pos >= handle->asset.size;
+    });
+#endif // FILESYSTEM_ASSETS
     FIND_FD_GET_HANDLE(fd, FD_TYPE_FILE, {
         if (!fs_is_mounted_nolock()) {
             return true;
         }
+        if (handle->file.stream_pos < handle->file.stream_len) {
+            return false;
+        }
 
         lfs_soff_t orig_offset = LFS_API_CALL(lfs_file_tell, &lfs, &handle->file.file_handle);
         if (orig_offset < 0) {
@@ -746,11 +1831,19 @@ static bool fs_is_eof_nolock(fs_fd_t fd) {
  * @param fd File descriptor to close
  */
 static void fs_close_nolock(fs_fd_t fd) {
+#ifdef FILESYSTEM_ASSETS
+    FIND_FD_GET_HANDLE(fd, FD_TYPE_ASSET, {
+        release_handle(handle); // Nothing was mounted or allocated for it
+        return;
+    });
+#endif // FILESYSTEM_ASSETS
     FIND_FD_GET_HANDLE(fd, FD_TYPE_FILE, {
         LFS_API_CALL(lfs_file_close, &lfs, &handle->file.file_handle);
+        fs_pool_free(handle->file.cfg.buffer);
+        fs_pool_free(handle->file.stream_buf);
 
-        handle->fd   = INVALID_FILESYSTEM_FD;
-        handle->type = FD_TYPE_EMPTY;
+        release_handle(handle);
+        fs_wear_save_nolock(false); // the filesystem may be staying mounted, so don't rely on unmount to persist
 
         fs_unmount_nolock(); // we can unmount here, mirrors the open in fs_open()
         return;
@@ -762,33 +1855,39 @@ static void fs_close_nolock(fs_fd_t fd) {
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 bool fs_format(void) {
+    FS_PROFILE_SCOPE(FS_PROFILE_FORMAT);
     fs_dprintf("\n");
     FS_AUTO_LOCK_UNLOCK(false);
     return fs_format_nolock();
 }
 
 bool fs_init(void) {
+    FS_PROFILE_SCOPE(FS_PROFILE_INIT);
     fs_dprintf("\n");
     FS_AUTO_LOCK_UNLOCK(false);
     return fs_init_nolock();
 }
 
 bool fs_mount(void) {
+    FS_PROFILE_SCOPE(FS_PROFILE_MOUNT);
     FS_AUTO_LOCK_UNLOCK(false);
     return fs_mount_nolock();
 }
 
 void fs_unmount(void) {
+    FS_PROFILE_SCOPE(FS_PROFILE_UNMOUNT);
     FS_AUTO_LOCK_UNLOCK();
     fs_unmount_nolock();
 }
 
 bool fs_is_mounted(void) {
+    FS_PROFILE_SCOPE(FS_PROFILE_IS_MOUNTED);
     FS_AUTO_LOCK_UNLOCK(false);
     return fs_is_mounted_nolock();
 }
 
 bool fs_mkdir(const char *path) {
+    FS_PROFILE_SCOPE(FS_PROFILE_MKDIR);
     if (!fs_is_path_safe(path) || !fs_is_path_depth_valid(path, FS_MAX_DIR_DEPTH)) {
         return false;
     }
@@ -799,6 +1898,7 @@ bool fs_mkdir(const char *path) {
 }
 
 bool fs_rmdir(const char *path, bool recursive) {
+    FS_PROFILE_SCOPE(FS_PROFILE_RMDIR);
     if (!fs_is_path_safe(path) || !fs_is_path_depth_valid(path, FS_MAX_DIR_DEPTH)) {
         return false;
     }
@@ -809,6 +1909,7 @@ bool fs_rmdir(const char *path, bool recursive) {
 }
 
 fs_fd_t fs_opendir(const char *path) {
+    FS_PROFILE_SCOPE(FS_PROFILE_OPENDIR);
     if (!fs_is_path_safe(path) || !fs_is_path_depth_valid(path, FS_MAX_DIR_DEPTH)) {
         return INVALID_FILESYSTEM_FD;
     }
@@ -823,18 +1924,21 @@ fs_fd_t fs_opendir(const char *path) {
 }
 
 fs_dirent_t *fs_readdir(fs_fd_t fd) {
+    FS_PROFILE_SCOPE(FS_PROFILE_READDIR);
     fs_dprintf("%d\n", (int)fd);
     FS_AUTO_LOCK_UNLOCK(NULL);
     return fs_readdir_nolock(fd);
 }
 
 void fs_closedir(fs_fd_t fd) {
+    FS_PROFILE_SCOPE(FS_PROFILE_CLOSEDIR);
     fs_dprintf("%d\n", (int)fd);
     FS_AUTO_LOCK_UNLOCK();
     fs_closedir_nolock(fd);
 }
 
 bool fs_exists(const char *path) {
+    FS_PROFILE_SCOPE(FS_PROFILE_EXISTS);
     if (!fs_is_path_safe(path) || !fs_is_path_depth_valid(path, FS_MAX_FILE_DEPTH)) {
         return false;
     }
@@ -845,6 +1949,7 @@ bool fs_exists(const char *path) {
 }
 
 bool fs_delete(const char *path) {
+    FS_PROFILE_SCOPE(FS_PROFILE_DELETE);
     if (!fs_is_path_safe(path) || !fs_is_path_depth_valid(path, FS_MAX_FILE_DEPTH)) {
         return false;
     }
@@ -855,6 +1960,11 @@ bool fs_delete(const char *path) {
 }
 
 fs_fd_t fs_open(const char *filename, fs_mode_t mode) {
+    return fs_open_ex(filename, mode, FS_ACCESS_DEFAULT, 0);
+}
+
+fs_fd_t fs_open_ex(const char *filename, fs_mode_t mode, fs_access_t access, fs_size_t buffer_size) {
+    FS_PROFILE_SCOPE(FS_PROFILE_OPEN);
     if (!fs_is_path_safe(filename) || !fs_is_path_depth_valid(filename, FS_MAX_FILE_DEPTH)) {
         return INVALID_FILESYSTEM_FD;
     }
@@ -862,7 +1972,7 @@ fs_fd_t fs_open(const char *filename, fs_mode_t mode) {
     fs_fd_t fd;
     {
         FS_AUTO_LOCK_UNLOCK(INVALID_FILESYSTEM_FD);
-        fd = fs_open_nolock(filename, mode);
+        fd = fs_open_nolock(filename, mode, access, buffer_size);
     }
 #ifdef CONSOLE_ENABLE
     char mode_str[8] = {0};
@@ -881,42 +1991,162 @@ fs_fd_t fs_open(const char *filename, fs_mode_t mode) {
 }
 
 fs_offset_t fs_seek(fs_fd_t fd, fs_offset_t offset, fs_whence_t whence) {
+    FS_PROFILE_SCOPE(FS_PROFILE_SEEK);
     FS_AUTO_LOCK_UNLOCK(-1);
     return fs_seek_nolock(fd, offset, whence);
 }
 
 fs_offset_t fs_tell(fs_fd_t fd) {
+    FS_PROFILE_SCOPE(FS_PROFILE_TELL);
     FS_AUTO_LOCK_UNLOCK(-1);
     return fs_tell_nolock(fd);
 }
 
 fs_size_t fs_read(fs_fd_t fd, void *buffer, fs_size_t length) {
+    FS_PROFILE_SCOPE(FS_PROFILE_READ);
     FS_AUTO_LOCK_UNLOCK(-1);
     return fs_read_nolock(fd, buffer, length);
 }
 
 fs_size_t fs_write(fs_fd_t fd, const void *buffer, fs_size_t length) {
+    FS_PROFILE_SCOPE(FS_PROFILE_WRITE);
     FS_AUTO_LOCK_UNLOCK(-1);
     return fs_write_nolock(fd, buffer, length);
 }
 
 bool fs_is_eof(fs_fd_t fd) {
+    FS_PROFILE_SCOPE(FS_PROFILE_IS_EOF);
     FS_AUTO_LOCK_UNLOCK(true);
     return fs_is_eof_nolock(fd);
 }
 
 void fs_close(fs_fd_t fd) {
+    FS_PROFILE_SCOPE(FS_PROFILE_CLOSE);
     fs_dprintf("%d\n", (int)fd);
     FS_AUTO_LOCK_UNLOCK();
     fs_close_nolock(fd);
 }
 
+void fs_batch_begin(void) {
+    FS_PROFILE_SCOPE(FS_PROFILE_BATCH_BEGIN);
+    fs_dprintf("depth=%d\n", batch_depth + 1);
+    fs_lock(); // Released in fs_batch_commit()
+    ++batch_depth;
+}
+
+void fs_batch_commit(void) {
+    FS_PROFILE_SCOPE(FS_PROFILE_BATCH_COMMIT);
+    fs_dprintf("depth=%d\n", batch_depth);
+    FS_AUTO_LOCK_UNLOCK();
+    if (batch_depth == 0) {
+        return;
+    }
+    if (--batch_depth == 0 && batch_mounted) {
+        batch_mounted = false;
+        fs_unmount_nolock();
+    }
+    fs_unlock(); // Acquired in fs_batch_begin()
+}
+
+void fs_set_persistent_mount(bool enable) {
+    fs_dprintf("%s\n", enable ? "enable" : "disable");
+    FS_AUTO_LOCK_UNLOCK();
+    persistent_mount = enable;
+    if (!enable && persistent_mounted) {
+        persistent_mounted = false;
+        fs_unmount_nolock();
+    }
+}
+
+bool fs_get_persistent_mount(void) {
+    FS_AUTO_LOCK_UNLOCK(false);
+    return persistent_mount;
+}
+
+void fs_get_mount_stats(fs_mount_stats_t *stats) {
+    FS_AUTO_LOCK_UNLOCK();
+    *stats = mount_stats;
+}
+
+void fs_get_wear_stats(fs_wear_stats_t *stats) {
+    FS_AUTO_LOCK_UNLOCK();
+    *stats             = wear_stats;
+    stats->block_count = lfs_cfg.block_count;
+}
+
+bool fs_flush_wear_stats(void) {
+    FS_AUTO_LOCK_UNLOCK(false);
+    FS_AUTO_MOUNT_UNMOUNT(false);
+    return fs_wear_save_nolock(true);
+}
+
+bool fs_erase_free_space(void) {
+    FS_PROFILE_SCOPE(FS_PROFILE_ERASE_FREE_SPACE);
+    FS_AUTO_LOCK_UNLOCK(false);
+    FS_AUTO_MOUNT_UNMOUNT(false);
+    return fs_erase_free_nolock();
+}
+
+uint32_t fs_pre_erase(uint32_t max_blocks) {
+    FS_PROFILE_SCOPE(FS_PROFILE_PRE_ERASE);
+    FS_AUTO_LOCK_UNLOCK(0);
+    // Checked before mounting, so that calls with nothing to do are cheap
+    if (max_blocks == 0 || !fs_pre_erase_wanted_nolock()) {
+        return 0;
+    }
+    FS_AUTO_MOUNT_UNMOUNT(0);
+    return fs_pre_erase_nolock(max_blocks);
+}
+
+const void *fs_asset_map(const char *path, fs_size_t *size) {
+    FS_PROFILE_SCOPE(FS_PROFILE_ASSET_MAP);
+#ifdef FILESYSTEM_ASSETS
+    FS_AUTO_LOCK_UNLOCK(NULL);
+    const uint8_t        *mapped = fs_device_assets_map();
+    const char           *name   = fs_asset_name(path);
+    fs_asset_pack_entry_t entry;
+    if (!mapped || !name || !fs_asset_find_nolock(name, &entry)) {
+        return NULL;
+    }
+    if (size) {
+        *size = (fs_size_t)entry.size;
+    }
+    return mapped + entry.offset;
+#else  // FILESYSTEM_ASSETS
+    (void)path;
+    (void)size;
+    return NULL;
+#endif // FILESYSTEM_ASSETS
+}
+
+void *fs_buffer_alloc(size_t size) {
+    FS_AUTO_LOCK_UNLOCK(NULL);
+    fs_pool_init();
+    return fs_pool_alloc(size);
+}
+
+void fs_buffer_free(void *ptr) {
+    FS_AUTO_LOCK_UNLOCK();
+    fs_pool_free(ptr);
+}
+
+void fs_get_buffer_pool_stats(fs_buffer_pool_stats_t *stats) {
+    FS_AUTO_LOCK_UNLOCK();
+    fs_pool_init();
+    stats->size         = fs_pool_size;
+    stats->free         = fs_pool_total_free();
+    stats->largest_free = fs_pool_largest_free();
+}
+
 void fs_dump_info(void) {
 #if defined(CONSOLE_ENABLE)
     struct lfs_fsinfo fs_info;
     lfs_ssize_t       size;
+    fs_mount_stats_t  stats;
     {
         FS_AUTO_LOCK_UNLOCK();
+        // littlefs' caches are only allocated while mounted, so the queries need a mount of their own
+        FS_AUTO_MOUNT_UNMOUNT();
         if ((size = lfs_fs_size(&lfs)) < 0) {
             return;
         }
@@ -927,6 +2157,22 @@ void fs_dump_info(void) {
     fs_dprintf("LFS disk version: 0x%08x, block size: %d bytes, block count: %d, allocated blocks: %d, name_max: %d bytes, file_max: %d bytes, attr_max: %d bytes\n", //
                (int)fs_info.disk_version, (int)fs_info.block_size, (int)fs_info.block_count, (int)size,                                                               //
                (int)fs_info.name_max, (int)fs_info.file_max, (int)fs_info.attr_max);
+    fs_get_mount_stats(&stats);
+    fs_dprintf("Mounts: %lu, unmounts: %lu, persistent mount: %s\n", (unsigned long)stats.mounts, (unsigned long)stats.unmounts, fs_get_persistent_mount() ? "yes" : "no");
+    fs_buffer_pool_stats_t pool;
+    fs_get_buffer_pool_stats(&pool);
+    fs_dprintf("Buffer pool: %lu bytes, free: %lu bytes, largest free: %lu bytes\n", (unsigned long)pool.size, (unsigned long)pool.free, (unsigned long)pool.largest_free);
+
+    fs_wear_stats_t wear;
+    fs_get_wear_stats(&wear);
+    uint32_t busiest = 0;
+    for (int i = 1; i < FS_WEAR_NUM_BUCKETS; ++i) {
+        if (wear.bucket_erases[i] > wear.bucket_erases[busiest]) {
+            busiest = i;
+        }
+    }
+    fs_dprintf("Erases: %lu, programmed: %lu KiB, busiest blocks: %lu-%lu with %lu erases\n", (unsigned long)wear.erases, (unsigned long)(wear.prog_bytes / 1024), //
+               (unsigned long)(busiest * wear.block_count / FS_WEAR_NUM_BUCKETS), (unsigned long)((busiest + 1) * wear.block_count / FS_WEAR_NUM_BUCKETS - 1), (unsigned long)wear.bucket_erases[busiest]);
 
 #endif
 }
@@ -1,28 +1,66 @@
 // Copyright 2022-2026 Nick Brassel (@tzarc)
 // SPDX-License-Identifier: GPL-2.0-or-later
 #include <stdbool.h>
+#include <string.h>
 #include <ch.h>
 #include "filesystem.h"
 #include "lfs.h"
 #include "flash_spi.h"
 
+// The sfdp_flash module is available, either enabled alongside this one (its rules.mk defines SFDP_FLASH_ENABLE) or
+// required by FILESYSTEM_SFDP_GEOMETRY
+#if defined(SFDP_FLASH_ENABLE) || defined(FILESYSTEM_SFDP_GEOMETRY)
+#    define FS_DEVICE_SFDP_FLASH
+#    include "sfdp_flash.h"
+#endif
+
+// Wear accounting, implemented in fs_lfs_common.c
+extern void fs_wear_record_erase(lfs_block_t block);
+extern void fs_wear_record_prog(lfs_size_t size);
+
 // Configurable LittleFS flash parameters (normally should not need to be overridden):
 // - LFS_BLOCK_SIZE: defaults to EXTERNAL_FLASH_BLOCK_SIZE
 // - LFS_BLOCK_COUNT: defaults to EXTERNAL_FLASH_BLOCK_COUNT
 // - LFS_CACHE_SIZE: defaults to EXTERNAL_FLASH_PAGE_SIZE
 // - LFS_BLOCK_CYCLES: defaults to 100 erase cycles
+// - FS_DEVICE_READ_AHEAD_SIZE: defaults to 4x LFS_CACHE_SIZE, 0 disables read-ahead
+// - FS_BUFFER_POOL_SIZE: defaults to littlefs' read, program and lookahead caches, plus a file cache for each of
+//   FS_MAX_NUM_OPEN_FDS
+// - FS_DEVICE_READ_RANGE: defaults to sfdp_flash_read_range if the sfdp_flash module is enabled, to use the fastest read
+//   command advertised by the device's SFDP tables, otherwise flash_read_range
+// - FS_DEVICE_WRITE_RANGE: defaults to sfdp_flash_write_range if the sfdp_flash module is enabled, to program devices
+//   larger than 16MB with native 4-byte address commands, otherwise flash_write_range
+// - FS_DEVICE_ERASE_RANGE: defaults to sfdp_flash_erase_range if the sfdp_flash module is enabled, to use the erase
+//   sizes advertised by the device's SFDP tables, otherwise fs_flash_erase_range
+//
+// flash_write_range() and flash_erase_sector() spin on the status register until the device is ready, so a save stalls
+// its thread for the whole of each erase. The sfdp_flash replacements sleep between status polls while erasing and
+// yield while programming, which lets the main loop run while FILESYSTEM_ASYNC_SAVE saves from its worker thread. They
+// fall back to the plain functions until the device has been probed.
+//
+// With FILESYSTEM_SFDP_GEOMETRY defined (requires the sfdp_flash module), fs_init() probes the device and sizes the
+// block count and read/program/cache sizes from its SFDP tables. LFS_BLOCK_COUNT and LFS_CACHE_SIZE then act as upper
+// bounds, as they size the statically allocated buffers.
+//
+// With FILESYSTEM_ASSETS defined, a read-only asset pack occupies the partition from FS_ASSETS_FLASH_ADDR, by default
+// everything after littlefs' LFS_BLOCK_COUNT blocks -- so LFS_BLOCK_COUNT must be reduced to leave room for it. The
+// pack is written by flashing the partition directly, littlefs never touches it:
+// - FS_ASSETS_FLASH_ADDR: defaults to LFS_BLOCK_COUNT * LFS_BLOCK_SIZE
+// - FS_ASSETS_FLASH_SIZE: defaults to the remainder of the device
+// - FS_ASSETS_XIP_BASE: address flash address 0 is memory-mapped at, if the MCU maps the device (e.g. a QSPI
+//   peripheral in memory-mapped mode); assets are then read in place rather than with FS_DEVICE_READ_RANGE
 
 /** @brief Size of each filesystem block in bytes */
 #ifndef LFS_BLOCK_SIZE
 #    define LFS_BLOCK_SIZE (EXTERNAL_FLASH_BLOCK_SIZE)
 #endif // LFS_BLOCK_SIZE
 
-/** @brief Total number of blocks used by the filesystem */
+/** @brief Total number of blocks used by the filesystem, or the most detected with FILESYSTEM_SFDP_GEOMETRY */
 #ifndef LFS_BLOCK_COUNT
 #    define LFS_BLOCK_COUNT (EXTERNAL_FLASH_BLOCK_COUNT)
 #endif // LFS_BLOCK_COUNT
 
-/** @brief Size of cache buffers in bytes */
+/** @brief Size of cache buffers in bytes, or the largest detected page size used with FILESYSTEM_SFDP_GEOMETRY */
 #ifndef LFS_CACHE_SIZE
 #    define LFS_CACHE_SIZE (EXTERNAL_FLASH_PAGE_SIZE)
 #endif // LFS_CACHE_SIZE
@@ -32,52 +70,322 @@
 #    define LFS_BLOCK_CYCLES 100
 #endif // LFS_BLOCK_CYCLES
 
+/** @brief Number of bytes prefetched in a single transfer once reads are found to be sequential */
+#ifndef FS_DEVICE_READ_AHEAD_SIZE
+#    define FS_DEVICE_READ_AHEAD_SIZE (4 * (LFS_CACHE_SIZE))
+#endif // FS_DEVICE_READ_AHEAD_SIZE
+
+/** @brief RAM budget all of littlefs' buffers are allocated from while in use, see fs_buffer_alloc() */
+#ifndef FS_BUFFER_POOL_SIZE
+#    define FS_BUFFER_POOL_SIZE ((3 + (FS_MAX_NUM_OPEN_FDS)) * ((LFS_CACHE_SIZE) + (FS_BUFFER_POOL_OVERHEAD)))
+#endif // FS_BUFFER_POOL_SIZE
+
+/** @brief Function used for all flash reads, must match the signature of flash_read_range() */
+#ifndef FS_DEVICE_READ_RANGE
+#    ifdef FS_DEVICE_SFDP_FLASH
+#        define FS_DEVICE_READ_RANGE sfdp_flash_read_range
+#    else
+#        define FS_DEVICE_READ_RANGE flash_read_range
+#    endif
+#endif // FS_DEVICE_READ_RANGE
+
+flash_status_t FS_DEVICE_READ_RANGE(uint32_t addr, void *data, size_t length);
+
+/** @brief Function used for all flash programming, must match the signature of flash_write_range() */
+#ifndef FS_DEVICE_WRITE_RANGE
+#    ifdef FS_DEVICE_SFDP_FLASH
+#        define FS_DEVICE_WRITE_RANGE sfdp_flash_write_range
+#    else
+#        define FS_DEVICE_WRITE_RANGE flash_write_range
+#    endif
+#endif // FS_DEVICE_WRITE_RANGE
+
+flash_status_t FS_DEVICE_WRITE_RANGE(uint32_t addr, const void *data, size_t length);
+
+/** @brief Function used to erase ranges of flash, must match the signature of fs_flash_erase_range() */
+#ifndef FS_DEVICE_ERASE_RANGE
+#    ifdef FS_DEVICE_SFDP_FLASH
+#        define FS_DEVICE_ERASE_RANGE sfdp_flash_erase_range
+#    else
+#        define FS_DEVICE_ERASE_RANGE fs_flash_erase_range
+#    endif
+#endif // FS_DEVICE_ERASE_RANGE
+
+flash_status_t FS_DEVICE_ERASE_RANGE(uint32_t addr, size_t length);
+
 // Compile-time validation of filesystem parameters
 _Static_assert((LFS_BLOCK_SIZE) >= 128, "LFS_BLOCK_SIZE must be >= 128 bytes");
 _Static_assert((LFS_CACHE_SIZE) % 8 == 0, "LFS_CACHE_SIZE must be a multiple of 8 bytes");
 _Static_assert((LFS_BLOCK_SIZE) % (LFS_CACHE_SIZE) == 0, "LFS_BLOCK_SIZE must be a multiple of LFS_CACHE_SIZE");
+_Static_assert((FS_BUFFER_POOL_SIZE) >= 4 * ((LFS_CACHE_SIZE) + (FS_BUFFER_POOL_OVERHEAD)), "FS_BUFFER_POOL_SIZE must have room to mount and open one file");
+_Static_assert((FS_DEVICE_READ_AHEAD_SIZE) == 0 || (FS_DEVICE_READ_AHEAD_SIZE) > (LFS_CACHE_SIZE), "FS_DEVICE_READ_AHEAD_SIZE must be larger than LFS_CACHE_SIZE");
+
+#ifdef FILESYSTEM_ASSETS
+/** @brief Flash address of the asset partition */
+#    ifndef FS_ASSETS_FLASH_ADDR
+#        define FS_ASSETS_FLASH_ADDR ((LFS_BLOCK_COUNT) * (LFS_BLOCK_SIZE))
+#    endif // FS_ASSETS_FLASH_ADDR
+
+/** @brief Size of the asset partition in bytes */
+#    ifndef FS_ASSETS_FLASH_SIZE
+#        define FS_ASSETS_FLASH_SIZE ((EXTERNAL_FLASH_SIZE) - (FS_ASSETS_FLASH_ADDR))
+#    endif // FS_ASSETS_FLASH_SIZE
+
+_Static_assert((FS_ASSETS_FLASH_ADDR) >= (LFS_BLOCK_COUNT) * (LFS_BLOCK_SIZE), "FS_ASSETS_FLASH_ADDR must not overlap littlefs' blocks");
+_Static_assert((FS_ASSETS_FLASH_SIZE) > 0 && (FS_ASSETS_FLASH_ADDR) + (FS_ASSETS_FLASH_SIZE) <= (EXTERNAL_FLASH_SIZE), "FS_ASSETS_FLASH_SIZE must be non-zero and fit the device, reduce LFS_BLOCK_COUNT to make room");
+#endif // FILESYSTEM_ASSETS
+
+// The configuration is only writable when its geometry is detected at runtime
+#ifdef FILESYSTEM_SFDP_GEOMETRY
+#    define FS_LFS_CONFIG_QUALIFIER
+#else
+#    define FS_LFS_CONFIG_QUALIFIER const
+#endif // FILESYSTEM_SFDP_GEOMETRY
+
+extern FS_LFS_CONFIG_QUALIFIER struct lfs_config lfs_cfg;
 
 /**
  * @brief LittleFS buffer storage
  *
  * Contains all the buffers required by LittleFS operations:
- * - Read cache buffer for block reads (LFS_CACHE_SIZE bytes)
- * - Program cache buffer for block writes (LFS_CACHE_SIZE bytes)
- * - Lookahead buffer for block allocation (LFS_CACHE_SIZE bytes)
- * - Per-file buffers for open file operations (LFS_CACHE_SIZE bytes each)
+ * - Pool for the read, program and lookahead caches while mounted, and open
+ *   files' caches and stream buffers (FS_BUFFER_POOL_SIZE bytes)
+ * - Read-ahead buffer for sequential reads (FS_DEVICE_READ_AHEAD_SIZE bytes)
  */
 static struct {
-    uint8_t lfs_read_buf[LFS_CACHE_SIZE] __attribute__((aligned(4)));
-    uint8_t lfs_prog_buf[LFS_CACHE_SIZE] __attribute__((aligned(4)));
-    uint8_t lfs_lookahead_buf[LFS_CACHE_SIZE] __attribute__((aligned(4)));
-    uint8_t lfs_file_bufs[FS_MAX_NUM_OPEN_FDS][LFS_CACHE_SIZE] __attribute__((aligned(4)));
+    uint8_t buffer_pool[FS_BUFFER_POOL_SIZE] __attribute__((aligned(8)));
+#if (FS_DEVICE_READ_AHEAD_SIZE) > 0
+    uint8_t read_ahead_buf[FS_DEVICE_READ_AHEAD_SIZE] __attribute__((aligned(4)));
+#endif // (FS_DEVICE_READ_AHEAD_SIZE) > 0
 } fs_lfs_buffers;
 
+/**
+ * @brief Blocks known to be erased
+ *
+ * Set once a block has been erased and cleared when it is programmed, so that
+ * littlefs erasing a block which was already erased in bulk costs nothing.
+ * Starts out clear, as nothing is known about the flash contents at boot.
+ */
+static uint8_t fs_erased_blocks[((LFS_BLOCK_COUNT) + 7) / 8];
+
+static inline bool fs_erased_get(lfs_block_t block) {
+    return fs_erased_blocks[block / 8] & (1 << (block % 8));
+}
+
+static inline void fs_erased_set(lfs_block_t block, bool erased) {
+    if (erased) {
+        fs_erased_blocks[block / 8] |= (1 << (block % 8));
+    } else {
+        fs_erased_blocks[block / 8] &= ~(1 << (block % 8));
+    }
+}
+
+#if (FS_DEVICE_READ_AHEAD_SIZE) > 0
+/**
+ * @brief Read-ahead state
+ *
+ * littlefs reads in LFS_CACHE_SIZE units, and each flash read is a separate SPI
+ * transaction with its own command and address overhead. Once a read starts
+ * where the previous one ended, a whole FS_DEVICE_READ_AHEAD_SIZE window is
+ * fetched in one transaction, and subsequent reads are served from it.
+ */
+static struct {
+    uint32_t addr;      /**< Flash address of the start of the buffered window */
+    uint32_t length;    /**< Number of valid bytes in the window, 0 if empty */
+    uint32_t next_addr; /**< Address immediately following the previous read */
+} fs_read_ahead;
+
+/**
+ * @brief Discard the read-ahead window
+ *
+ * Must be called whenever the flash contents change.
+ */
+static inline void fs_read_ahead_invalidate(void) {
+    fs_read_ahead.length = 0;
+}
+#endif // (FS_DEVICE_READ_AHEAD_SIZE) > 0
+
+/** @brief Mutex serialising use of the flash's SPI bus, see fs_device_bus_lock() */
+static MUTEX_DECL(fs_bus_mutex);
+
+/**
+ * @brief Take exclusive use of the SPI bus the flash is attached to
+ *
+ * Held around each flash operation, erases included. Other drivers sharing the
+ * bus take it around their own transfers.
+ */
+void fs_device_bus_lock(void) {
+    chMtxLock(&fs_bus_mutex);
+}
+
+/**
+ * @brief Release the SPI bus taken by fs_device_bus_lock()
+ */
+void fs_device_bus_unlock(void) {
+    chMtxUnlock(&fs_bus_mutex);
+}
+
+#ifdef FILESYSTEM_SFDP_GEOMETRY
+/**
+ * @brief Size the filesystem from the attached device's SFDP tables
+ *
+ * The block count comes from the device density, and the read, program and
+ * cache sizes from its page size, so that each cache flush is a single page
+ * program. Both are bounded by the compile-time values sizing the buffers. The
+ * compile-time geometry is kept if SFDP is unavailable, or if the device
+ * cannot erase in units dividing LFS_BLOCK_SIZE.
+ */
+static void fs_device_configure_geometry(void) {
+    lfs_cfg.block_count = (LFS_BLOCK_COUNT);
+    lfs_cfg.read_size   = (LFS_CACHE_SIZE);
+    lfs_cfg.prog_size   = (LFS_CACHE_SIZE);
+    lfs_cfg.cache_size  = (LFS_CACHE_SIZE);
+
+    fs_device_bus_lock();
+    bool detected = sfdp_init();
+    fs_device_bus_unlock();
+    if (!detected) {
+        fs_dprintf("SFDP unavailable, using default geometry\n");
+        return;
+    }
+
+    uint32_t density   = sfdp_get_density();
+    uint32_t min_erase = sfdp_get_min_erase_size();
+    if (density < 2 * (LFS_BLOCK_SIZE) || min_erase == 0 || (LFS_BLOCK_SIZE) % min_erase != 0) {
+        fs_dprintf("SFDP geometry unusable (density %lu, erase %lu), using default geometry\n", (unsigned long)density, (unsigned long)min_erase);
+        return;
+    }
+
+    lfs_size_t block_count = density / (LFS_BLOCK_SIZE);
+    if (block_count > (LFS_BLOCK_COUNT)) {
+        fs_dprintf("device has %lu blocks, limited to LFS_BLOCK_COUNT\n", (unsigned long)block_count);
+        block_count = (LFS_BLOCK_COUNT);
+    }
+    lfs_cfg.block_count = block_count;
+
+    // Smaller pages than the buffers allow are used as-is; larger pages can only be programmed in part
+    uint16_t page_size = sfdp_get_page_size();
+    if (page_size >= 8 && page_size <= (LFS_CACHE_SIZE) && (LFS_CACHE_SIZE) % page_size == 0) {
+        lfs_cfg.read_size  = page_size;
+        lfs_cfg.prog_size  = page_size;
+        lfs_cfg.cache_size = page_size;
+    }
+
+    fs_dprintf("SFDP geometry: %lu blocks of %lu bytes, %lu byte caches\n", (unsigned long)lfs_cfg.block_count, (unsigned long)lfs_cfg.block_size, (unsigned long)lfs_cfg.cache_size);
+}
+#endif // FILESYSTEM_SFDP_GEOMETRY
+
 /**
  * @brief Initialize the filesystem device
  *
- * Clears all LittleFS buffers and initializes the underlying flash hardware.
+ * Resets the read-ahead state and initializes the underlying flash hardware.
+ * The buffer pool is left alone, as buffers may be lent out from it.
+ * With FILESYSTEM_SFDP_GEOMETRY, also sizes lfs_cfg from the detected device.
  *
  * @return true on successful initialization
  */
 bool fs_device_init(void) {
-    memset(&fs_lfs_buffers, 0, sizeof(fs_lfs_buffers));
+#if (FS_DEVICE_READ_AHEAD_SIZE) > 0
+    memset(&fs_read_ahead, 0, sizeof(fs_read_ahead));
+#endif // (FS_DEVICE_READ_AHEAD_SIZE) > 0
+    fs_device_bus_lock();
     flash_init();
+    fs_device_bus_unlock();
+#ifdef FILESYSTEM_SFDP_GEOMETRY
+    fs_device_configure_geometry();
+#endif // FILESYSTEM_SFDP_GEOMETRY
     return true;
 }
 
 /**
- * @brief Get a file buffer for the specified file index
+ * @brief Erase a range of flash using the largest erase commands available
+ *
+ * Default implementation of FS_DEVICE_ERASE_RANGE without the sfdp_flash
+ * module, using 64kB block erases where the range allows and sector erases
+ * elsewhere.
+ *
+ * @param addr Start of the range, aligned to EXTERNAL_FLASH_SECTOR_SIZE
+ * @param length Length of the range, a multiple of EXTERNAL_FLASH_SECTOR_SIZE
+ * @return FLASH_STATUS_SUCCESS on success, flash error otherwise
+ */
+flash_status_t fs_flash_erase_range(uint32_t addr, size_t length) {
+    if (addr % (EXTERNAL_FLASH_SECTOR_SIZE) != 0 || length % (EXTERNAL_FLASH_SECTOR_SIZE) != 0) {
+        return FLASH_STATUS_BAD_ADDRESS;
+    }
+    while (length > 0) {
+        flash_status_t status;
+        uint32_t       step;
+        if (addr % (EXTERNAL_FLASH_BLOCK_SIZE) == 0 && length >= (EXTERNAL_FLASH_BLOCK_SIZE)) {
+            status = flash_erase_block(addr);
+            step   = (EXTERNAL_FLASH_BLOCK_SIZE);
+        } else {
+            status = flash_erase_sector(addr);
+            step   = (EXTERNAL_FLASH_SECTOR_SIZE);
+        }
+        if (status != FLASH_STATUS_SUCCESS) {
+            return status;
+        }
+        addr += step;
+        length -= step;
+    }
+    return FLASH_STATUS_SUCCESS;
+}
+
+/**
+ * @brief Get the memory littlefs' buffers are allocated from
  *
- * @param file_idx Index of the file (0 to FS_MAX_NUM_OPEN_FDS-1)
- * @return Pointer to LFS_CACHE_SIZE byte file buffer, or NULL if index is invalid
+ * @param size Set to the size of the pool in bytes
+ * @return Pointer to the pool, aligned to 8 bytes
  */
-void *fs_device_filebuf(int file_idx) {
-    if (file_idx < 0 || file_idx >= FS_MAX_NUM_OPEN_FDS) {
-        return NULL;
+void *fs_device_buffer_pool(size_t *size) {
+    *size = sizeof(fs_lfs_buffers.buffer_pool);
+    return fs_lfs_buffers.buffer_pool;
+}
+
+#ifdef FILESYSTEM_ASSETS
+/**
+ * @brief Get the asset partition's memory-mapped address
+ *
+ * @return Pointer to the start of the partition, or NULL if it isn't memory-mapped
+ */
+const void *fs_device_assets_map(void) {
+#    ifdef FS_ASSETS_XIP_BASE
+    return (const void *)((uintptr_t)(FS_ASSETS_XIP_BASE) + (FS_ASSETS_FLASH_ADDR));
+#    else  // FS_ASSETS_XIP_BASE
+    return NULL;
+#    endif // FS_ASSETS_XIP_BASE
+}
+
+/**
+ * @brief Read from the asset partition
+ *
+ * Issues a single FS_DEVICE_READ_RANGE for the whole range. Must be called
+ * with the filesystem locked.
+ *
+ * @param offset Offset from the start of the partition
+ * @param buffer Buffer to fill
+ * @param length Number of bytes to read
+ * @return true on success, false if the range lies outside the partition or the read failed
+ */
+bool fs_device_assets_read(uint32_t offset, void *buffer, uint32_t length) {
+    if (offset > (FS_ASSETS_FLASH_SIZE) || length > (FS_ASSETS_FLASH_SIZE) - offset) {
+        return false;
     }
-    return fs_lfs_buffers.lfs_file_bufs[file_idx];
+    fs_device_bus_lock();
+    flash_status_t status = FS_DEVICE_READ_RANGE((FS_ASSETS_FLASH_ADDR) + offset, buffer, length);
+    fs_device_bus_unlock();
+    return status == FLASH_STATUS_SUCCESS;
+}
+
+/**
+ * @brief Get the size of the asset partition
+ *
+ * @return Size in bytes
+ */
+uint32_t fs_device_assets_size(void) {
+    return (FS_ASSETS_FLASH_SIZE);
 }
+#endif // FILESYSTEM_ASSETS
 
 /**
  * @brief Validate block parameters and calculate flash address safely
@@ -154,6 +462,7 @@ static int fs_flash_status_to_lfs_error(flash_status_t status) {
  *
  * LittleFS callback function to read data from the flash device.
  * Validates parameters and translates block/offset to flash address.
+ * Sequential reads are coalesced into larger transfers via the read-ahead window.
  *
  * @param c LittleFS configuration
  * @param block Block number to read from
@@ -173,7 +482,36 @@ int fs_device_read(const struct lfs_config *c, lfs_block_t block, lfs_off_t off,
         return ret;
     }
 
-    flash_status_t status = flash_read_range(addr, buffer, size);
+#if (FS_DEVICE_READ_AHEAD_SIZE) > 0
+    bool sequential         = addr == fs_read_ahead.next_addr;
+    fs_read_ahead.next_addr = addr + size;
+
+    // Serve from the window if it covers the whole read
+    if (fs_read_ahead.length > 0 && addr >= fs_read_ahead.addr && addr + size <= fs_read_ahead.addr + fs_read_ahead.length) {
+        memcpy(buffer, &fs_lfs_buffers.read_ahead_buf[addr - fs_read_ahead.addr], size);
+        return 0;
+    }
+
+    // Refill the window if reads are sequential, clamped to the end of the device
+    if (sequential && size < (FS_DEVICE_READ_AHEAD_SIZE)) {
+        uint32_t device_end = c->block_count * c->block_size;
+        uint32_t length     = device_end - addr < (FS_DEVICE_READ_AHEAD_SIZE) ? device_end - addr : (FS_DEVICE_READ_AHEAD_SIZE);
+        fs_read_ahead_invalidate();
+        fs_device_bus_lock();
+        flash_status_t status = FS_DEVICE_READ_RANGE(addr, fs_lfs_buffers.read_ahead_buf, length);
+        fs_device_bus_unlock();
+        if (status == FLASH_STATUS_SUCCESS) {
+            fs_read_ahead.addr   = addr;
+            fs_read_ahead.length = length;
+            memcpy(buffer, fs_lfs_buffers.read_ahead_buf, size);
+        }
+        return fs_flash_status_to_lfs_error(status);
+    }
+#endif // (FS_DEVICE_READ_AHEAD_SIZE) > 0
+
+    fs_device_bus_lock();
+    flash_status_t status = FS_DEVICE_READ_RANGE(addr, buffer, size);
+    fs_device_bus_unlock();
     return fs_flash_status_to_lfs_error(status);
 }
 
@@ -202,7 +540,17 @@ int fs_device_prog(const struct lfs_config *c, lfs_block_t block, lfs_off_t off,
         return ret;
     }
 
-    flash_status_t status = flash_write_range(addr, buffer, size);
+#if (FS_DEVICE_READ_AHEAD_SIZE) > 0
+    fs_read_ahead_invalidate();
+#endif // (FS_DEVICE_READ_AHEAD_SIZE) > 0
+
+    fs_erased_set(block, false);
+    fs_device_bus_lock();
+    flash_status_t status = FS_DEVICE_WRITE_RANGE(addr, buffer, size);
+    fs_device_bus_unlock();
+    if (status == FLASH_STATUS_SUCCESS) {
+        fs_wear_record_prog(size);
+    }
     return fs_flash_status_to_lfs_error(status);
 }
 
@@ -210,7 +558,8 @@ int fs_device_prog(const struct lfs_config *c, lfs_block_t block, lfs_off_t off,
  * @brief Erase a flash block
  *
  * LittleFS callback function to erase an entire block of flash memory.
- * After erasing, any location within the block can be programmed.
+ * After erasing, any location within the block can be programmed. Blocks
+ * which are still erased from an earlier bulk erase are skipped.
  *
  * @param c LittleFS configuration
  * @param block Block number to erase (entire block will be erased)
@@ -222,11 +571,69 @@ int fs_device_erase(const struct lfs_config *c, lfs_block_t block) {
     if (ret < 0) {
         return ret;
     }
+    if (fs_erased_get(block)) {
+        return 0;
+    }
+
+#if (FS_DEVICE_READ_AHEAD_SIZE) > 0
+    fs_read_ahead_invalidate();
+#endif // (FS_DEVICE_READ_AHEAD_SIZE) > 0
 
-    flash_status_t status = flash_erase_sector(addr);
+    fs_device_bus_lock();
+    flash_status_t status = FS_DEVICE_ERASE_RANGE(addr, c->block_size);
+    fs_device_bus_unlock();
+    if (status == FLASH_STATUS_SUCCESS) {
+        fs_erased_set(block, true);
+        fs_wear_record_erase(block);
+    }
     return fs_flash_status_to_lfs_error(status);
 }
 
+/**
+ * @brief Erase a run of blocks ahead of time
+ *
+ * Erases the whole run through FS_DEVICE_ERASE_RANGE, so aligned spans use the
+ * largest erase commands available, and marks each block as erased so that
+ * littlefs' own erase of it later is skipped. Must be called with the filesystem
+ * locked, and only for blocks which littlefs is not using.
+ *
+ * @param first First block to erase
+ * @param count Number of blocks to erase
+ * @return true on success
+ */
+bool fs_device_erase_blocks(lfs_block_t first, lfs_size_t count) {
+    if (count == 0 || first >= lfs_cfg.block_count || count > lfs_cfg.block_count - first) {
+        return false;
+    }
+
+#if (FS_DEVICE_READ_AHEAD_SIZE) > 0
+    fs_read_ahead_invalidate();
+#endif // (FS_DEVICE_READ_AHEAD_SIZE) > 0
+
+    fs_device_bus_lock();
+    flash_status_t status = FS_DEVICE_ERASE_RANGE(first * (LFS_BLOCK_SIZE), count * (LFS_BLOCK_SIZE));
+    fs_device_bus_unlock();
+    if (status != FLASH_STATUS_SUCCESS) {
+        // Partially erased runs are left marked as unknown
+        return false;
+    }
+    for (lfs_block_t block = first; block < first + count; ++block) {
+        fs_erased_set(block, true);
+        fs_wear_record_erase(block);
+    }
+    return true;
+}
+
+/**
+ * @brief Check whether a block is known to be erased
+ *
+ * @param block Block number
+ * @return true if the block has been erased and not programmed since
+ */
+bool fs_device_block_erased(lfs_block_t block) {
+    return block < lfs_cfg.block_count && fs_erased_get(block);
+}
+
 /**
  * @brief Synchronize flash operations
  *
@@ -289,7 +696,7 @@ int fs_device_unlock(const struct lfs_config *c) {
  * - Pre-allocated buffer pointers
  * - Wear leveling parameters (block cycles)
  */
-const struct lfs_config lfs_cfg = {
+FS_LFS_CONFIG_QUALIFIER struct lfs_config lfs_cfg = {
     // thread safety
     .lock   = fs_device_lock,
     .unlock = fs_device_unlock,
@@ -309,7 +716,5 @@ const struct lfs_config lfs_cfg = {
     .cache_size     = (LFS_CACHE_SIZE),
     .lookahead_size = (LFS_CACHE_SIZE),
 
-    .read_buffer      = fs_lfs_buffers.lfs_read_buf,
-    .prog_buffer      = fs_lfs_buffers.lfs_prog_buf,
-    .lookahead_buffer = fs_lfs_buffers.lfs_lookahead_buf,
+    // read, program and lookahead buffers are allocated from the buffer pool when mounting
 };
@@ -0,0 +1,555 @@
+// Copyright 2025-2026 Nick Brassel (@tzarc)
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "filesystem.h"
+#include "fs_platform.h"
+#include "fs_lfs_host.h"
+#include "lfs.h"
+
+#ifdef FILESYSTEM_SFDP_GEOMETRY
+#    error "FILESYSTEM_SFDP_GEOMETRY is only supported by the lfs_flash driver"
+#endif // FILESYSTEM_SFDP_GEOMETRY
+
+// Wear accounting, implemented in fs_lfs_common.c
+extern void fs_wear_record_erase(lfs_block_t block);
+extern void fs_wear_record_prog(lfs_size_t size);
+
+// Configurable simulated flash parameters:
+// - LFS_BLOCK_SIZE: defaults to 4096 bytes
+// - LFS_BLOCK_COUNT: defaults to 256 blocks
+// - LFS_CACHE_SIZE: defaults to 256 bytes
+// - LFS_BLOCK_CYCLES: defaults to 100 erase cycles
+// - FS_BUFFER_POOL_SIZE: defaults to littlefs' read, program and lookahead caches, plus a file cache for each of
+//   FS_MAX_NUM_OPEN_FDS
+// - FS_ASSETS_FLASH_SIZE: defaults to 64kB, the size of the simulated asset partition with FILESYSTEM_ASSETS
+
+/** @brief Size of each filesystem block in bytes */
+#ifndef LFS_BLOCK_SIZE
+#    define LFS_BLOCK_SIZE 4096
+#endif // LFS_BLOCK_SIZE
+
+/** @brief Total number of blocks used by the filesystem */
+#ifndef LFS_BLOCK_COUNT
+#    define LFS_BLOCK_COUNT 256
+#endif // LFS_BLOCK_COUNT
+
+/** @brief Size of cache buffers in bytes */
+#ifndef LFS_CACHE_SIZE
+#    define LFS_CACHE_SIZE 256
+#endif // LFS_CACHE_SIZE
+
+/** @brief Number of erase cycles before wear leveling kicks in */
+#ifndef LFS_BLOCK_CYCLES
+#    define LFS_BLOCK_CYCLES 100
+#endif // LFS_BLOCK_CYCLES
+
+/** @brief RAM budget all of littlefs' buffers are allocated from while in use, see fs_buffer_alloc() */
+#ifndef FS_BUFFER_POOL_SIZE
+#    define FS_BUFFER_POOL_SIZE ((3 + (FS_MAX_NUM_OPEN_FDS)) * ((LFS_CACHE_SIZE) + (FS_BUFFER_POOL_OVERHEAD)))
+#endif // FS_BUFFER_POOL_SIZE
+
+#ifdef FILESYSTEM_ASSETS
+/** @brief Size of the simulated asset partition in bytes */
+#    ifndef FS_ASSETS_FLASH_SIZE
+#        define FS_ASSETS_FLASH_SIZE (64 * 1024)
+#    endif // FS_ASSETS_FLASH_SIZE
+#endif // FILESYSTEM_ASSETS
+
+// Compile-time validation of filesystem parameters
+_Static_assert((LFS_BLOCK_SIZE) >= 128, "LFS_BLOCK_SIZE must be >= 128 bytes");
+_Static_assert((LFS_CACHE_SIZE) % 8 == 0, "LFS_CACHE_SIZE must be a multiple of 8 bytes");
+_Static_assert((LFS_BLOCK_SIZE) % (LFS_CACHE_SIZE) == 0, "LFS_BLOCK_SIZE must be a multiple of LFS_CACHE_SIZE");
+_Static_assert((FS_BUFFER_POOL_SIZE) >= 4 * ((LFS_CACHE_SIZE) + (FS_BUFFER_POOL_OVERHEAD)), "FS_BUFFER_POOL_SIZE must have room to mount and open one file");
+
+/**
+ * @brief LittleFS buffer storage
+ *
+ * Mirrors the layout used by the flash driver, so RAM usage is representative.
+ */
+static struct {
+    uint8_t buffer_pool[FS_BUFFER_POOL_SIZE] __attribute__((aligned(8)));
+} fs_lfs_buffers;
+
+/** @brief Simulated flash contents */
+static uint8_t fs_host_image[(LFS_BLOCK_SIZE) * (LFS_BLOCK_COUNT)];
+
+/** @brief Whether the simulated flash has been brought up in the erased state */
+static bool fs_host_image_valid = false;
+
+/** @brief Optional backing file for the simulated flash */
+static FILE *fs_host_image_file = NULL;
+
+/** @brief Per-block erase counters, preserved across resets of the other statistics */
+static uint32_t fs_host_block_erases[LFS_BLOCK_COUNT];
+
+/** @brief Blocks known to be erased, mirroring the flash driver */
+static uint8_t fs_erased_blocks[((LFS_BLOCK_COUNT) + 7) / 8];
+
+static inline bool fs_erased_get(lfs_block_t block) {
+    return fs_erased_blocks[block / 8] & (1 << (block % 8));
+}
+
+static inline void fs_erased_set(lfs_block_t block, bool erased) {
+    if (erased) {
+        fs_erased_blocks[block / 8] |= (1 << (block % 8));
+    } else {
+        fs_erased_blocks[block / 8] &= ~(1 << (block % 8));
+    }
+}
+
+/** @brief Device operation counters */
+static fs_host_stats_t fs_host_stats;
+
+/** @brief Simulated latency */
+static fs_host_latency_t fs_host_latency;
+
+void fs_host_image_erase(void) {
+    memset(fs_host_image, 0xFF, sizeof(fs_host_image));
+    // As with a real part, the driver has no way of knowing
+    memset(fs_erased_blocks, 0, sizeof(fs_erased_blocks));
+    fs_host_image_valid = true;
+    if (fs_host_image_file) {
+        fseek(fs_host_image_file, 0, SEEK_SET);
+        fwrite(fs_host_image, 1, sizeof(fs_host_image), fs_host_image_file);
+        fflush(fs_host_image_file);
+    }
+}
+
+bool fs_host_image_attach(const char *path) {
+    fs_host_image_detach();
+
+    FILE *f = fopen(path, "r+b");
+    if (f) {
+        size_t count = fread(fs_host_image, 1, sizeof(fs_host_image), f);
+        if (count < sizeof(fs_host_image)) {
+            // Short (or new) image, treat the remainder as erased
+            memset(fs_host_image + count, 0xFF, sizeof(fs_host_image) - count);
+        }
+        fs_host_image_valid = true;
+        fs_host_image_file  = f;
+        memset(fs_erased_blocks, 0, sizeof(fs_erased_blocks));
+    } else {
+        f = fopen(path, "w+b");
+        if (!f) {
+            return false;
+        }
+        fs_host_image_file = f;
+        fs_host_image_erase();
+    }
+    return true;
+}
+
+void fs_host_image_detach(void) {
+    if (fs_host_image_file) {
+        fclose(fs_host_image_file);
+        fs_host_image_file = NULL;
+    }
+}
+
+void fs_host_set_latency(const fs_host_latency_t *latency) {
+    if (latency) {
+        fs_host_latency = *latency;
+    } else {
+        memset(&fs_host_latency, 0, sizeof(fs_host_latency));
+    }
+}
+
+const fs_host_stats_t *fs_host_get_stats(void) {
+    return &fs_host_stats;
+}
+
+void fs_host_reset_stats(void) {
+    memset(&fs_host_stats, 0, sizeof(fs_host_stats));
+}
+
+uint32_t fs_host_get_block_erase_count(uint32_t block) {
+    if (block >= (LFS_BLOCK_COUNT)) {
+        return 0;
+    }
+    return fs_host_block_erases[block];
+}
+
+/**
+ * @brief Busy-wait to simulate device latency
+ *
+ * Spins rather than sleeps so that short delays are accurate.
+ *
+ * @param ns Delay in nanoseconds
+ */
+static void fs_host_delay(uint64_t ns) {
+    if (ns == 0) {
+        return;
+    }
+    fs_host_stats.device_ns += ns;
+
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    } while ((uint64_t)(now.tv_sec - start.tv_sec) * 1000000000ull + (uint64_t)(now.tv_nsec - start.tv_nsec) < ns);
+}
+
+/**
+ * @brief Write a region of the simulated flash through to the backing file, if any
+ *
+ * @param addr Start address in bytes
+ * @param size Number of bytes
+ */
+static void fs_host_write_through(uint32_t addr, lfs_size_t size) {
+    if (fs_host_image_file) {
+        fseek(fs_host_image_file, addr, SEEK_SET);
+        fwrite(&fs_host_image[addr], 1, size, fs_host_image_file);
+    }
+}
+
+/**
+ * @brief Initialize the filesystem device
+ *
+ * The simulated flash starts out erased the first time around, and retains its
+ * contents across subsequent reinitialisation. The buffer pool is left alone,
+ * as buffers may be lent out from it.
+ *
+ * @return true on successful initialization
+ */
+bool fs_device_init(void) {
+    if (!fs_host_image_valid) {
+        fs_host_image_erase();
+    }
+    return true;
+}
+
+/**
+ * @brief Get the memory littlefs' buffers are allocated from
+ *
+ * @param size Set to the size of the pool in bytes
+ * @return Pointer to the pool, aligned to 8 bytes
+ */
+void *fs_device_buffer_pool(size_t *size) {
+    *size = sizeof(fs_lfs_buffers.buffer_pool);
+    return fs_lfs_buffers.buffer_pool;
+}
+
+#ifdef FILESYSTEM_ASSETS
+/** @brief Simulated asset partition, separate from the littlefs image */
+static uint8_t fs_host_assets[FS_ASSETS_FLASH_SIZE];
+
+/** @brief Whether the simulated asset partition behaves as memory-mapped */
+static bool fs_host_assets_mapped = false;
+
+bool fs_host_assets_load(const void *pack, size_t size, bool mapped) {
+    if (size > sizeof(fs_host_assets)) {
+        return false;
+    }
+    memcpy(fs_host_assets, pack, size);
+    memset(fs_host_assets + size, 0xFF, sizeof(fs_host_assets) - size);
+    fs_host_assets_mapped = mapped;
+    return true;
+}
+
+/**
+ * @brief Get the asset partition's memory-mapped address
+ *
+ * @return Pointer to the start of the simulated partition, or NULL unless loaded as memory-mapped
+ */
+const void *fs_device_assets_map(void) {
+    return fs_host_assets_mapped ? fs_host_assets : NULL;
+}
+
+/**
+ * @brief Read from the simulated asset partition
+ *
+ * Counted and delayed as a single device read.
+ *
+ * @param offset Offset from the start of the partition
+ * @param buffer Buffer to fill
+ * @param length Number of bytes to read
+ * @return true on success, false if the range lies outside the partition
+ */
+bool fs_device_assets_read(uint32_t offset, void *buffer, uint32_t length) {
+    if (offset > sizeof(fs_host_assets) || length > sizeof(fs_host_assets) - offset) {
+        return false;
+    }
+    memcpy(buffer, &fs_host_assets[offset], length);
+    fs_host_stats.read_count++;
+    fs_host_stats.read_bytes += length;
+    fs_host_delay(fs_host_latency.read_ns + ((uint64_t)fs_host_latency.read_byte_ns * length));
+    return true;
+}
+
+/**
+ * @brief Get the size of the simulated asset partition
+ *
+ * @return Size in bytes
+ */
+uint32_t fs_device_assets_size(void) {
+    return sizeof(fs_host_assets);
+}
+#else  // FILESYSTEM_ASSETS
+bool fs_host_assets_load(const void *pack, size_t size, bool mapped) {
+    (void)pack;
+    (void)size;
+    (void)mapped;
+    return false;
+}
+#endif // FILESYSTEM_ASSETS
+
+/**
+ * @brief Validate block parameters and calculate the simulated flash address
+ *
+ * @param c LittleFS configuration
+ * @param block Block number to access
+ * @param off Offset within the block in bytes
+ * @param size Size of the operation in bytes (0 for erase operations)
+ * @param addr_out Output parameter for calculated address in bytes
+ * @return 0 on success, negative LFS error code on failure
+ */
+static int fs_validate_block_address(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, lfs_size_t size, uint32_t *addr_out) {
+    if (!c || block >= c->block_count || off > c->block_size || size > c->block_size - off) {
+        return LFS_ERR_INVAL;
+    }
+    *addr_out = (block * c->block_size) + off;
+    return 0;
+}
+
+/**
+ * @brief Read data from simulated flash
+ *
+ * @param c LittleFS configuration
+ * @param block Block number to read from
+ * @param off Offset within the block in bytes
+ * @param buffer Buffer to store read data
+ * @param size Number of bytes to read
+ * @return 0 on success, negative LFS error code on failure
+ */
+int fs_device_read(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, void *buffer, lfs_size_t size) {
+    if (!buffer || size == 0) {
+        return LFS_ERR_INVAL;
+    }
+
+    uint32_t addr;
+    int      ret = fs_validate_block_address(c, block, off, size, &addr);
+    if (ret < 0) {
+        return ret;
+    }
+
+    memcpy(buffer, &fs_host_image[addr], size);
+    fs_host_stats.read_count++;
+    fs_host_stats.read_bytes += size;
+    fs_host_delay(fs_host_latency.read_ns + ((uint64_t)fs_host_latency.read_byte_ns * size));
+    return 0;
+}
+
+/**
+ * @brief Program (write) data to simulated flash
+ *
+ * Mimics NOR flash semantics: programming can only clear bits, so writes to a
+ * region that was not previously erased are counted in prog_unerased.
+ *
+ * @param c LittleFS configuration
+ * @param block Block number to write to
+ * @param off Offset within the block in bytes
+ * @param buffer Buffer containing data to write
+ * @param size Number of bytes to write
+ * @return 0 on success, negative LFS error code on failure
+ */
+int fs_device_prog(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, const void *buffer, lfs_size_t size) {
+    if (!buffer || size == 0) {
+        return LFS_ERR_INVAL;
+    }
+
+    uint32_t addr;
+    int      ret = fs_validate_block_address(c, block, off, size, &addr);
+    if (ret < 0) {
+        return ret;
+    }
+
+    fs_erased_set(block, false);
+    const uint8_t *src      = (const uint8_t *)buffer;
+    bool           unerased = false;
+    for (lfs_size_t i = 0; i < size; ++i) {
+        if ((fs_host_image[addr + i] & src[i]) != src[i]) {
+            unerased = true;
+        }
+        fs_host_image[addr + i] &= src[i];
+    }
+    fs_host_write_through(addr, size);
+
+    if (unerased) {
+        fs_host_stats.prog_unerased++;
+    }
+    fs_host_stats.prog_count++;
+    fs_host_stats.prog_bytes += size;
+    fs_wear_record_prog(size);
+    fs_host_delay(fs_host_latency.prog_ns + ((uint64_t)fs_host_latency.prog_byte_ns * size));
+    return 0;
+}
+
+/**
+ * @brief Erase a simulated flash block
+ *
+ * @param c LittleFS configuration
+ * @param block Block number to erase (entire block will be erased)
+ * @return 0 on success, negative LFS error code on failure
+ */
+int fs_device_erase(const struct lfs_config *c, lfs_block_t block) {
+    uint32_t addr;
+    int      ret = fs_validate_block_address(c, block, 0, 0, &addr);
+    if (ret < 0) {
+        return ret;
+    }
+    if (fs_erased_get(block)) {
+        fs_host_stats.erase_skipped++;
+        return 0;
+    }
+
+    memset(&fs_host_image[addr], 0xFF, c->block_size);
+    fs_host_write_through(addr, c->block_size);
+
+    fs_host_block_erases[block]++;
+    fs_host_stats.erase_count++;
+    fs_erased_set(block, true);
+    fs_wear_record_erase(block);
+    fs_host_delay(fs_host_latency.erase_ns);
+    return 0;
+}
+
+/**
+ * @brief Erase a run of simulated flash blocks ahead of time
+ *
+ * Aligned 64kB spans are charged as a single erase_64k_ns erase, everything
+ * else as per-block erases. Each block is marked as erased so that littlefs'
+ * own erase of it later is skipped.
+ *
+ * @param first First block to erase
+ * @param count Number of blocks to erase
+ * @return true on success
+ */
+bool fs_device_erase_blocks(lfs_block_t first, lfs_size_t count) {
+    if (count == 0 || first >= (LFS_BLOCK_COUNT) || count > (LFS_BLOCK_COUNT) - first) {
+        return false;
+    }
+
+    const uint32_t large = 64 * 1024;
+    uint32_t       addr  = first * (LFS_BLOCK_SIZE);
+    uint32_t       end   = (first + count) * (LFS_BLOCK_SIZE);
+    while (addr < end) {
+        uint32_t step = (addr % large == 0 && end - addr >= large && large % (LFS_BLOCK_SIZE) == 0) ? large : (LFS_BLOCK_SIZE);
+        memset(&fs_host_image[addr], 0xFF, step);
+        fs_host_write_through(addr, step);
+        fs_host_stats.erase_count++;
+        fs_host_delay(step == large ? fs_host_latency.erase_64k_ns : fs_host_latency.erase_ns);
+        addr += step;
+    }
+    for (lfs_block_t block = first; block < first + count; ++block) {
+        fs_host_block_erases[block]++;
+        fs_erased_set(block, true);
+        fs_wear_record_erase(block);
+    }
+    return true;
+}
+
+/**
+ * @brief Check whether a simulated flash block is known to be erased
+ *
+ * @param block Block number
+ * @return true if the block has been erased and not programmed since
+ */
+bool fs_device_block_erased(lfs_block_t block) {
+    return block < (LFS_BLOCK_COUNT) && fs_erased_get(block);
+}
+
+/**
+ * @brief Synchronize simulated flash operations
+ *
+ * Flushes the backing file, if any.
+ *
+ * @param c LittleFS configuration
+ * @return 0 (always successful)
+ */
+int fs_device_sync(const struct lfs_config *c) {
+    (void)c; // Unused parameter
+    if (fs_host_image_file) {
+        fflush(fs_host_image_file);
+    }
+    fs_host_stats.sync_count++;
+    return 0;
+}
+
+/** @brief Stand-in for the flash driver's SPI bus mutex, as the simulated flash has no bus to share */
+static FS_MUTEX_DECL(fs_bus_mutex);
+
+/**
+ * @brief Take exclusive use of the flash's bus, as per the flash driver
+ */
+void fs_device_bus_lock(void) {
+    fs_mutex_lock(&fs_bus_mutex);
+}
+
+/**
+ * @brief Release the bus taken by fs_device_bus_lock()
+ */
+void fs_device_bus_unlock(void) {
+    fs_mutex_unlock(&fs_bus_mutex);
+}
+
+/** @brief Mutex for thread-safe device access */
+static FS_MUTEX_DECL(fs_dev_mutex);
+
+/**
+ * @brief Lock the simulated flash device for exclusive access
+ *
+ * @param c LittleFS configuration
+ * @return 0 on success, LFS_ERR_INVAL if config is NULL
+ */
+int fs_device_lock(const struct lfs_config *c) {
+    if (!c) {
+        return LFS_ERR_INVAL;
+    }
+    fs_mutex_lock(&fs_dev_mutex);
+    return 0;
+}
+
+/**
+ * @brief Unlock the simulated flash device
+ *
+ * @param c LittleFS configuration
+ * @return 0 on success, LFS_ERR_INVAL if config is NULL
+ */
+int fs_device_unlock(const struct lfs_config *c) {
+    if (!c) {
+        return LFS_ERR_INVAL;
+    }
+    fs_mutex_unlock(&fs_dev_mutex);
+    return 0;
+}
+
+/**
+ * @brief LittleFS configuration structure
+ *
+ * Matches the flash driver's configuration, with the simulated flash geometry.
+ */
+const struct lfs_config lfs_cfg = {
+    // thread safety
+    .lock   = fs_device_lock,
+    .unlock = fs_device_unlock,
+
+    // block device operations
+    .read  = fs_device_read,
+    .prog  = fs_device_prog,
+    .erase = fs_device_erase,
+    .sync  = fs_device_sync,
+
+    // block device configuration
+    .read_size      = (LFS_CACHE_SIZE),
+    .prog_size      = (LFS_CACHE_SIZE),
+    .block_size     = (LFS_BLOCK_SIZE),
+    .block_count    = (LFS_BLOCK_COUNT),
+    .block_cycles   = (LFS_BLOCK_CYCLES),
+    .cache_size     = (LFS_CACHE_SIZE),
+    .lookahead_size = (LFS_CACHE_SIZE),
+
+    // read, program and lookahead buffers are allocated from the buffer pool when mounting
+};
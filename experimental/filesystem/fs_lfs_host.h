@@ -0,0 +1,100 @@
+// Copyright 2025-2026 Nick Brassel (@tzarc)
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Simulated per-operation latency
+ *
+ * Each device operation busy-waits for its fixed cost plus its per-byte cost,
+ * so that timings measured on the host resemble those of real flash.
+ */
+typedef struct fs_host_latency_t {
+    uint32_t read_ns;       /**< Fixed cost of each read operation */
+    uint32_t read_byte_ns;  /**< Additional cost per byte read */
+    uint32_t prog_ns;       /**< Fixed cost of each program operation */
+    uint32_t prog_byte_ns;  /**< Additional cost per byte programmed */
+    uint32_t erase_ns;      /**< Cost of each block erase */
+    uint32_t erase_64k_ns;  /**< Cost of each 64kB erase, issued by bulk erases covering an aligned 64kB span */
+} fs_host_latency_t;
+
+/**
+ * @brief Simulated device operation counters
+ */
+typedef struct fs_host_stats_t {
+    uint32_t read_count;    /**< Number of read operations */
+    uint64_t read_bytes;    /**< Number of bytes read */
+    uint32_t prog_count;    /**< Number of program operations */
+    uint64_t prog_bytes;    /**< Number of bytes programmed */
+    uint32_t erase_count;   /**< Number of erase commands, a 64kB erase counts once */
+    uint32_t erase_skipped; /**< Number of block erases skipped as the block was already erased */
+    uint32_t sync_count;    /**< Number of sync operations */
+    uint32_t prog_unerased; /**< Number of program operations which attempted to set bits that were not erased */
+    uint64_t device_ns;     /**< Total simulated device time */
+} fs_host_stats_t;
+
+/**
+ * @brief Back the simulated flash with a file on disk
+ *
+ * Loads the image from the file if it exists, otherwise creates an erased image.
+ * Subsequent program and erase operations are written through to the file.
+ *
+ * @param path Path to the image file
+ * @return true on success, false on failure
+ */
+bool fs_host_image_attach(const char *path);
+
+/**
+ * @brief Detach the backing file, leaving the image in RAM
+ */
+void fs_host_image_detach(void);
+
+/**
+ * @brief Erase the entire simulated flash, as per a factory-fresh part
+ */
+void fs_host_image_erase(void);
+
+/**
+ * @brief Write an asset pack into the simulated asset partition
+ *
+ * The rest of the partition is left erased. Takes effect from the next
+ * fs_init(). Only available with FILESYSTEM_ASSETS defined.
+ *
+ * @param pack Asset pack, as built by make_asset_pack.py
+ * @param size Size of the pack in bytes, at most FS_ASSETS_FLASH_SIZE
+ * @param mapped Whether the partition behaves as memory-mapped, making fs_asset_map() available
+ * @return true on success, false if the pack doesn't fit or assets are disabled
+ */
+bool fs_host_assets_load(const void *pack, size_t size, bool mapped);
+
+/**
+ * @brief Set the simulated per-operation latency
+ *
+ * @param latency Latency to apply, or NULL to disable latency injection
+ */
+void fs_host_set_latency(const fs_host_latency_t *latency);
+
+/**
+ * @brief Get the device operation counters accumulated since the last reset
+ *
+ * @return Pointer to the counters
+ */
+const fs_host_stats_t *fs_host_get_stats(void);
+
+/**
+ * @brief Reset the device operation counters
+ *
+ * Per-block wear counters are unaffected.
+ */
+void fs_host_reset_stats(void);
+
+/**
+ * @brief Get the number of times a block has been erased
+ *
+ * @param block Block number
+ * @return Erase count, or 0 if the block number is invalid
+ */
+uint32_t fs_host_get_block_erase_count(uint32_t block);
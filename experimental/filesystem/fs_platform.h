@@ -0,0 +1,135 @@
+// Copyright 2025-2026 Nick Brassel (@tzarc)
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+// Thin OS abstraction so the littlefs binding can be built against ChibiOS on-device, or pthreads on a host PC
+// (when FILESYSTEM_HOST is defined).
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(FILESYSTEM_HOST)
+#    include <pthread.h>
+#    include <time.h>
+
+typedef pthread_mutex_t fs_mutex_t;
+#    define FS_MUTEX_DECL(name) fs_mutex_t name = PTHREAD_MUTEX_INITIALIZER
+
+typedef pthread_t fs_thread_t;
+
+static inline fs_thread_t fs_thread_self(void) {
+    return pthread_self();
+}
+
+static inline bool fs_thread_is_self(fs_thread_t thread) {
+    return pthread_equal(thread, pthread_self()) != 0;
+}
+
+static inline void fs_mutex_lock(fs_mutex_t *mutex) {
+    pthread_mutex_lock(mutex);
+}
+
+static inline void fs_mutex_unlock(fs_mutex_t *mutex) {
+    pthread_mutex_unlock(mutex);
+}
+
+// Short critical sections for state shared between threads; each translation unit gets its own, which is all the
+// callers need
+static fs_mutex_t fs_critical_mutex __attribute__((unused)) = PTHREAD_MUTEX_INITIALIZER;
+
+static inline void fs_critical_enter(void) {
+    pthread_mutex_lock(&fs_critical_mutex);
+}
+
+static inline void fs_critical_exit(void) {
+    pthread_mutex_unlock(&fs_critical_mutex);
+}
+
+typedef uint64_t fs_timestamp_t; // Nanoseconds
+
+static inline fs_timestamp_t fs_timestamp(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static inline uint32_t fs_timestamp_to_us(fs_timestamp_t timestamp) {
+    return (uint32_t)(timestamp / 1000);
+}
+
+static inline uint32_t fs_elapsed_us(fs_timestamp_t since) {
+    return (uint32_t)((fs_timestamp() - since) / 1000);
+}
+
+#else // defined(FILESYSTEM_HOST)
+#    include <ch.h>
+#    include <hal.h>
+
+typedef mutex_t fs_mutex_t;
+#    define FS_MUTEX_DECL(name) MUTEX_DECL(name)
+
+typedef thread_t *fs_thread_t;
+
+static inline fs_thread_t fs_thread_self(void) {
+    return chThdGetSelfX();
+}
+
+static inline bool fs_thread_is_self(fs_thread_t thread) {
+    return thread == chThdGetSelfX();
+}
+
+static inline void fs_mutex_lock(fs_mutex_t *mutex) {
+    chMtxLock(mutex);
+}
+
+static inline void fs_mutex_unlock(fs_mutex_t *mutex) {
+    chMtxUnlock(mutex);
+}
+
+static inline void fs_critical_enter(void) {
+    chSysLock();
+}
+
+static inline void fs_critical_exit(void) {
+    chSysUnlock();
+}
+
+// Configurable: Frequency of the realtime counter used for profiling timestamps, normally the core clock
+#    if !defined(FS_REALTIME_COUNTER_FREQUENCY) && defined(STM32_HCLK)
+#        define FS_REALTIME_COUNTER_FREQUENCY STM32_HCLK
+#    endif
+
+#    if PORT_SUPPORTS_RT && defined(FS_REALTIME_COUNTER_FREQUENCY)
+typedef rtcnt_t fs_timestamp_t; // Realtime counter cycles, wrapping every 2^32 cycles
+
+static inline fs_timestamp_t fs_timestamp(void) {
+    return chSysGetRealtimeCounterX();
+}
+
+static inline uint32_t fs_timestamp_to_us(fs_timestamp_t timestamp) {
+    return (uint32_t)RTC2US(FS_REALTIME_COUNTER_FREQUENCY, timestamp);
+}
+
+static inline uint32_t fs_elapsed_us(fs_timestamp_t since) {
+    return (uint32_t)RTC2US(FS_REALTIME_COUNTER_FREQUENCY, (rtcnt_t)(chSysGetRealtimeCounterX() - since));
+}
+
+#    else // PORT_SUPPORTS_RT && defined(FS_REALTIME_COUNTER_FREQUENCY)
+// No realtime counter on this port (e.g. Cortex-M0), so fall back to system ticks -- resolution is then limited to
+// CH_CFG_ST_FREQUENCY, and most operations shorter than a tick profile as 0us
+typedef systime_t fs_timestamp_t; // System ticks
+
+static inline fs_timestamp_t fs_timestamp(void) {
+    return chVTGetSystemTimeX();
+}
+
+static inline uint32_t fs_timestamp_to_us(fs_timestamp_t timestamp) {
+    return (uint32_t)chTimeI2US((sysinterval_t)timestamp);
+}
+
+static inline uint32_t fs_elapsed_us(fs_timestamp_t since) {
+    return (uint32_t)chTimeI2US(chTimeDiffX(since, chVTGetSystemTimeX()));
+}
+#    endif // PORT_SUPPORTS_RT && defined(FS_REALTIME_COUNTER_FREQUENCY)
+
+#endif // defined(FILESYSTEM_HOST)
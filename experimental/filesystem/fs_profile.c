@@ -0,0 +1,149 @@
+// Copyright 2025-2026 Nick Brassel (@tzarc)
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <string.h>
+#include "filesystem.h"
+#include "fs_profile.h"
+
+#if defined(FILESYSTEM_PROFILE)
+#    include "fs_platform.h"
+
+#    if defined(CONSOLE_ENABLE) && !defined(FILESYSTEM_HOST)
+#        include <debug.h>
+#        include <print.h>
+#    endif
+
+typedef struct fs_profile_stats_t {
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t total_us;
+    uint16_t histogram[FS_PROFILE_HISTOGRAM_BUCKETS]; // Saturating
+} fs_profile_stats_t;
+
+typedef struct fs_profile_sample_t {
+    uint32_t start_us;
+    uint32_t duration_us;
+    uint8_t  op;
+} fs_profile_sample_t;
+
+static FS_MUTEX_DECL(fs_profile_mutex);
+static fs_profile_stats_t  fs_profile_stats[FS_PROFILE_NUM_OPS];
+static fs_profile_sample_t fs_profile_ring[FS_PROFILE_RING_SIZE];
+static uint32_t            fs_profile_ring_count = 0; // Total samples recorded, the ring holds the most recent
+
+static int fs_profile_bucket(uint32_t duration_us) {
+    int bucket = 0;
+    while ((duration_us >> bucket) > 1 && bucket < FS_PROFILE_HISTOGRAM_BUCKETS - 1) {
+        ++bucket;
+    }
+    return bucket;
+}
+
+void fs_profile_scope_end(fs_profile_scope_t *scope) {
+    uint32_t duration_us = fs_elapsed_us(scope->start);
+    if (scope->op >= FS_PROFILE_NUM_OPS) {
+        return;
+    }
+
+    fs_mutex_lock(&fs_profile_mutex);
+    fs_profile_stats_t *stats = &fs_profile_stats[scope->op];
+    if (stats->count == 0 || duration_us < stats->min_us) {
+        stats->min_us = duration_us;
+    }
+    if (duration_us > stats->max_us) {
+        stats->max_us = duration_us;
+    }
+    ++stats->count;
+    stats->total_us += duration_us;
+    uint16_t *bucket = &stats->histogram[fs_profile_bucket(duration_us)];
+    if (*bucket < UINT16_MAX) {
+        ++*bucket;
+    }
+
+    fs_profile_sample_t *sample = &fs_profile_ring[fs_profile_ring_count % FS_PROFILE_RING_SIZE];
+    sample->start_us            = fs_timestamp_to_us(scope->start);
+    sample->duration_us         = duration_us;
+    sample->op                  = scope->op;
+    ++fs_profile_ring_count;
+    fs_mutex_unlock(&fs_profile_mutex);
+}
+
+void fs_profile_reset(void) {
+    fs_mutex_lock(&fs_profile_mutex);
+    memset(fs_profile_stats, 0, sizeof(fs_profile_stats));
+    memset(fs_profile_ring, 0, sizeof(fs_profile_ring));
+    fs_profile_ring_count = 0;
+    fs_mutex_unlock(&fs_profile_mutex);
+}
+
+#    if defined(CONSOLE_ENABLE) || defined(FILESYSTEM_HOST)
+static const char *const fs_profile_op_names[FS_PROFILE_NUM_OPS] = {
+    [FS_PROFILE_HOUSEKEEPING]     = "housekeeping",
+    [FS_PROFILE_FORMAT]           = "format",
+    [FS_PROFILE_INIT]             = "init",
+    [FS_PROFILE_MOUNT]            = "mount",
+    [FS_PROFILE_UNMOUNT]          = "unmount",
+    [FS_PROFILE_IS_MOUNTED]       = "is_mounted",
+    [FS_PROFILE_MKDIR]            = "mkdir",
+    [FS_PROFILE_RMDIR]            = "rmdir",
+    [FS_PROFILE_OPENDIR]          = "opendir",
+    [FS_PROFILE_READDIR]          = "readdir",
+    [FS_PROFILE_CLOSEDIR]         = "closedir",
+    [FS_PROFILE_EXISTS]           = "exists",
+    [FS_PROFILE_DELETE]           = "delete",
+    [FS_PROFILE_OPEN]             = "open",
+    [FS_PROFILE_SEEK]             = "seek",
+    [FS_PROFILE_TELL]             = "tell",
+    [FS_PROFILE_READ]             = "read",
+    [FS_PROFILE_WRITE]            = "write",
+    [FS_PROFILE_IS_EOF]           = "is_eof",
+    [FS_PROFILE_CLOSE]            = "close",
+    [FS_PROFILE_BATCH_BEGIN]      = "batch_begin",
+    [FS_PROFILE_BATCH_COMMIT]     = "batch_commit",
+    [FS_PROFILE_ERASE_FREE_SPACE] = "erase_free_space",
+    [FS_PROFILE_PRE_ERASE]        = "pre_erase",
+    [FS_PROFILE_ASSET_MAP]        = "asset_map",
+};
+#    endif // defined(CONSOLE_ENABLE) || defined(FILESYSTEM_HOST)
+
+void fs_profile_dump(void) {
+#    if defined(CONSOLE_ENABLE) || defined(FILESYSTEM_HOST)
+    fs_mutex_lock(&fs_profile_mutex);
+    dprintf("Filesystem profile (microseconds):\n");
+    for (int op = 0; op < FS_PROFILE_NUM_OPS; ++op) {
+        const fs_profile_stats_t *stats = &fs_profile_stats[op];
+        if (stats->count == 0) {
+            continue;
+        }
+        dprintf("  %-16s count: %lu, min: %lu, avg: %lu, max: %lu\n", fs_profile_op_names[op], (unsigned long)stats->count, (unsigned long)stats->min_us, (unsigned long)(stats->total_us / stats->count), (unsigned long)stats->max_us);
+        dprintf("  %-16s", "");
+        for (int bucket = 0; bucket < FS_PROFILE_HISTOGRAM_BUCKETS; ++bucket) {
+            if (stats->histogram[bucket] == 0) {
+                continue;
+            }
+            if (bucket == FS_PROFILE_HISTOGRAM_BUCKETS - 1) {
+                dprintf(" >=%lu:%u", 1UL << bucket, (unsigned)stats->histogram[bucket]);
+            } else {
+                dprintf(" <%lu:%u", 2UL << bucket, (unsigned)stats->histogram[bucket]);
+            }
+        }
+        dprintf("\n");
+    }
+
+    uint32_t count = fs_profile_ring_count < FS_PROFILE_RING_SIZE ? fs_profile_ring_count : FS_PROFILE_RING_SIZE;
+    dprintf("Most recent %lu of %lu samples:\n", (unsigned long)count, (unsigned long)fs_profile_ring_count);
+    for (uint32_t i = fs_profile_ring_count - count; i < fs_profile_ring_count; ++i) {
+        const fs_profile_sample_t *sample = &fs_profile_ring[i % FS_PROFILE_RING_SIZE];
+        dprintf("  @%lu %s: %lu\n", (unsigned long)sample->start_us, fs_profile_op_names[sample->op], (unsigned long)sample->duration_us);
+    }
+    fs_mutex_unlock(&fs_profile_mutex);
+#    endif // defined(CONSOLE_ENABLE) || defined(FILESYSTEM_HOST)
+}
+
+#else // defined(FILESYSTEM_PROFILE)
+
+void fs_profile_reset(void) {}
+
+void fs_profile_dump(void) {}
+
+#endif // defined(FILESYSTEM_PROFILE)
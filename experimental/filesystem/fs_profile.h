@@ -0,0 +1,98 @@
+// Copyright 2025-2026 Nick Brassel (@tzarc)
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+// Timing instrumentation for filesystem calls and housekeeping, enabled by defining FILESYSTEM_PROFILE. Each profiled
+// scope records its duration into per-operation statistics and a ring buffer of recent samples, which are printed
+// by fs_profile_dump() -- the FS_DUMP keycode does so alongside fs_dump_info().
+
+#include <stdint.h>
+
+// Configurable: Number of recent samples kept in the ring buffer
+#ifndef FS_PROFILE_RING_SIZE
+#    define FS_PROFILE_RING_SIZE 32
+#endif
+
+/** @brief Number of histogram buckets per operation; bucket N counts durations below 2^(N+1) microseconds, the last bucket counts everything longer */
+#define FS_PROFILE_HISTOGRAM_BUCKETS 16
+
+/** @brief Profiled operations */
+typedef enum fs_profile_op_t {
+    FS_PROFILE_HOUSEKEEPING,     /**< housekeeping_task_filesystem() */
+    FS_PROFILE_FORMAT,           /**< fs_format() */
+    FS_PROFILE_INIT,             /**< fs_init() */
+    FS_PROFILE_MOUNT,            /**< fs_mount() */
+    FS_PROFILE_UNMOUNT,          /**< fs_unmount() */
+    FS_PROFILE_IS_MOUNTED,       /**< fs_is_mounted() */
+    FS_PROFILE_MKDIR,            /**< fs_mkdir() */
+    FS_PROFILE_RMDIR,            /**< fs_rmdir() */
+    FS_PROFILE_OPENDIR,          /**< fs_opendir() */
+    FS_PROFILE_READDIR,          /**< fs_readdir() */
+    FS_PROFILE_CLOSEDIR,         /**< fs_closedir() */
+    FS_PROFILE_EXISTS,           /**< fs_exists() */
+    FS_PROFILE_DELETE,           /**< fs_delete() */
+    FS_PROFILE_OPEN,             /**< fs_open() */
+    FS_PROFILE_SEEK,             /**< fs_seek() */
+    FS_PROFILE_TELL,             /**< fs_tell() */
+    FS_PROFILE_READ,             /**< fs_read() */
+    FS_PROFILE_WRITE,            /**< fs_write() */
+    FS_PROFILE_IS_EOF,           /**< fs_is_eof() */
+    FS_PROFILE_CLOSE,            /**< fs_close() */
+    FS_PROFILE_BATCH_BEGIN,      /**< fs_batch_begin() */
+    FS_PROFILE_BATCH_COMMIT,     /**< fs_batch_commit() */
+    FS_PROFILE_ERASE_FREE_SPACE, /**< fs_erase_free_space() */
+    FS_PROFILE_PRE_ERASE,        /**< fs_pre_erase() */
+    FS_PROFILE_ASSET_MAP,        /**< fs_asset_map() */
+    FS_PROFILE_NUM_OPS
+} fs_profile_op_t;
+
+#if defined(FILESYSTEM_PROFILE)
+#    include "fs_platform.h"
+
+/** @brief In-flight profiled scope, see FS_PROFILE_SCOPE() */
+typedef struct fs_profile_scope_t {
+    fs_timestamp_t start; /**< Time the scope was entered */
+    uint8_t        op;    /**< Operation being profiled (fs_profile_op_t) */
+} fs_profile_scope_t;
+
+/**
+ * @brief Record the duration of a profiled scope
+ *
+ * Invoked automatically when the variable declared by FS_PROFILE_SCOPE() goes out of scope.
+ * Thread-safe.
+ *
+ * @param scope Scope being exited
+ */
+void fs_profile_scope_end(fs_profile_scope_t *scope);
+
+/**
+ * @brief Profile the remainder of the enclosing scope
+ *
+ * Declare before any FS_AUTO_LOCK_UNLOCK() so that time spent waiting for the lock is included.
+ *
+ * @param profile_op Operation being profiled (fs_profile_op_t)
+ */
+#    define FS_PROFILE_SCOPE(profile_op) fs_profile_scope_t __fs_profile __attribute__((__cleanup__(fs_profile_scope_end))) = {.start = fs_timestamp(), .op = (profile_op)}
+#else // defined(FILESYSTEM_PROFILE)
+#    define FS_PROFILE_SCOPE(profile_op) \
+        do {                             \
+        } while (0)
+#endif // defined(FILESYSTEM_PROFILE)
+
+/**
+ * @brief Clear all profiling statistics and recent samples
+ *
+ * No-op unless FILESYSTEM_PROFILE is defined.
+ * Thread-safe.
+ */
+void fs_profile_reset(void);
+
+/**
+ * @brief Dump profiling statistics and recent samples to console
+ *
+ * Prints min/avg/max and a histogram for each operation which has been
+ * recorded, followed by the ring buffer of recent samples. Only available
+ * when FILESYSTEM_PROFILE and CONSOLE_ENABLE are defined.
+ * Thread-safe.
+ */
+void fs_profile_dump(void);
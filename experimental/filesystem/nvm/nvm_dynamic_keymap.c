@@ -31,6 +31,12 @@ static uint16_t dynamic_keymap_altered_count[DYNAMIC_KEYMAP_LAYER_COUNT] = {0};
 static uint32_t dynamic_keymap_altered_keys[DYNAMIC_KEYMAP_LAYER_COUNT][(((MATRIX_ROWS) * (MATRIX_COLS)) + 31) / 32];
 // The "live" copy of the keymap, cached in RAM
 static uint16_t dynamic_keymap_layer_cache[DYNAMIC_KEYMAP_LAYER_COUNT][MATRIX_ROWS][MATRIX_COLS];
+// Keep track of the keys changed since the layer was last saved, by bitmask
+static uint32_t dynamic_keymap_unsaved_keys[DYNAMIC_KEYMAP_LAYER_COUNT][(((MATRIX_ROWS) * (MATRIX_COLS)) + 31) / 32];
+// Keep track of how many keys have been changed since the layer was last saved
+static uint16_t dynamic_keymap_unsaved_count[DYNAMIC_KEYMAP_LAYER_COUNT] = {0};
+// Number of override entries in the layer's file, which can be appended to -- 0 if the file is absent or holds a full layer
+static uint16_t dynamic_keymap_log_count[DYNAMIC_KEYMAP_LAYER_COUNT] = {0};
 
 // Override entry structure definitions
 typedef struct keymap_override_entry_t {
@@ -59,6 +65,7 @@ typedef struct encodermap_override_entry_t {
 #endif
 
 // Scratch area to hold the to-be-saved keycode data, either as a full keymap or as a list of keycode overrides, whichever is smaller
+// Only used when saving, loads go straight into the live copy
 static struct __attribute__((packed)) {
     uint8_t write_mode; // 0 == full layer, 1 == overrides
     union {
@@ -83,7 +90,7 @@ static struct __attribute__((packed)) {
 static bool is_key_altered(uint8_t layer, uint8_t row, uint8_t col) {
     // Assume layer/encoder_idx already bounds-checked by caller
     size_t index = (row * (MATRIX_COLS)) + col;
-    return (dynamic_keymap_altered_keys[layer][index / 32] & (1 << (index % 32))) != 0;
+    return (dynamic_keymap_altered_keys[layer][index / 32] & (1UL << (index % 32))) != 0;
 }
 
 static void set_key_altered(uint8_t layer, uint8_t row, uint8_t col, bool val) {
@@ -91,20 +98,40 @@ static void set_key_altered(uint8_t layer, uint8_t row, uint8_t col, bool val) {
     size_t index = (row * (MATRIX_COLS)) + col;
 
     // Update the altered key count for the layer if we've had a change
-    bool orig_val = dynamic_keymap_altered_keys[layer][index / 32] & (1 << (index % 32)) ? true : false;
+    bool orig_val = dynamic_keymap_altered_keys[layer][index / 32] & (1UL << (index % 32)) ? true : false;
     if (val != orig_val) {
         dynamic_keymap_altered_count[layer] += val ? 1 : -1;
     }
 
     if (val) {
         // Mark the key index as altered
-        dynamic_keymap_altered_keys[layer][index / 32] |= (1 << (index % 32));
+        dynamic_keymap_altered_keys[layer][index / 32] |= (1UL << (index % 32));
     } else {
         // Unmark the key index from being altered
-        dynamic_keymap_altered_keys[layer][index / 32] &= ~(1 << (index % 32));
+        dynamic_keymap_altered_keys[layer][index / 32] &= ~(1UL << (index % 32));
     }
 }
 
+static bool is_key_unsaved(uint8_t layer, uint8_t row, uint8_t col) {
+    // Assume layer/row/col already bounds-checked by caller
+    size_t index = (row * (MATRIX_COLS)) + col;
+    return (dynamic_keymap_unsaved_keys[layer][index / 32] & (1UL << (index % 32))) != 0;
+}
+
+static void set_key_unsaved(uint8_t layer, uint8_t row, uint8_t col) {
+    // Assume layer/row/col already bounds-checked by caller
+    size_t index = (row * (MATRIX_COLS)) + col;
+    if (!(dynamic_keymap_unsaved_keys[layer][index / 32] & (1UL << (index % 32)))) {
+        dynamic_keymap_unsaved_keys[layer][index / 32] |= (1UL << (index % 32));
+        ++dynamic_keymap_unsaved_count[layer];
+    }
+}
+
+static void clear_keys_unsaved(uint8_t layer) {
+    dynamic_keymap_unsaved_count[layer] = 0;
+    memset(dynamic_keymap_unsaved_keys[layer], 0, sizeof(dynamic_keymap_unsaved_keys[layer]));
+}
+
 static void nvm_dynamic_keymap_reset_cache_layer_to_raw(uint8_t layer);
 static void nvm_dynamic_keymap_reset_cache_to_raw(void);
 #if defined(ENCODER_ENABLE) && defined(ENCODER_MAP_ENABLE)
@@ -113,6 +140,8 @@ static void nvm_dynamic_encodermap_reset_cache_to_raw(void);
 #endif // defined(ENCODER_ENABLE) && defined(ENCODER_MAP_ENABLE)
 
 void nvm_dynamic_keymap_erase(void) {
+    // Let any queued saves land first, so they can't recreate files after the erase
+    nvm_save_barrier();
     fs_rmdir("layers", true);
     fs_mkdir("layers");
     nvm_dynamic_keymap_reset_cache_to_raw();
@@ -122,6 +151,7 @@ void nvm_dynamic_keymap_erase(void) {
 }
 
 void nvm_dynamic_keymap_macro_erase(void) {
+    nvm_save_barrier();
     fs_rmdir("macros", true);
     fs_mkdir("macros");
 }
@@ -135,89 +165,143 @@ uint16_t nvm_dynamic_keymap_read_keycode(uint8_t layer, uint8_t row, uint8_t col
     return dynamic_keymap_layer_cache[layer][row][column];
 }
 
-void nvm_dynamic_keymap_update_keycode(uint8_t layer, uint8_t row, uint8_t column, uint16_t keycode) {
-    if (layer >= keymap_layer_count() || row >= MATRIX_ROWS || column >= MATRIX_COLS) return;
+static void nvm_dynamic_keymap_set_keycode(uint8_t layer, uint8_t row, uint8_t column, uint16_t keycode) {
+    // Assume layer/row/col already bounds-checked by caller
     dynamic_keymap_layer_cache[layer][row][column] = keycode;
     set_key_altered(layer, row, column, keycode != keycode_at_keymap_location_raw(layer, row, column));
+}
+
+void nvm_dynamic_keymap_update_keycode(uint8_t layer, uint8_t row, uint8_t column, uint16_t keycode) {
+    if (layer >= keymap_layer_count() || row >= MATRIX_ROWS || column >= MATRIX_COLS) return;
+    if (dynamic_keymap_layer_cache[layer][row][column] == keycode) return;
+    nvm_dynamic_keymap_set_keycode(layer, row, column, keycode);
+    set_key_unsaved(layer, row, column);
     dynamic_keymap_layer_dirty |= (1 << layer);
+    nvm_filesystem_mark_dirty();
+}
+
+static size_t nvm_dynamic_keymap_collect_overrides(uint8_t layer, bool unsaved_only) {
+    size_t idx = 0;
+    for (int row = 0; row < MATRIX_ROWS; ++row) {
+        for (int col = 0; col < MATRIX_COLS; ++col) {
+            // A key reverted to its default is still logged when appending, so that it overrides any earlier entry
+            if (unsaved_only ? is_key_unsaved(layer, row, col) : is_key_altered(layer, row, col)) {
+                dynamic_keymap_scratch.keymap_layer_overrides[idx].row     = row;
+                dynamic_keymap_scratch.keymap_layer_overrides[idx].col     = col;
+                dynamic_keymap_scratch.keymap_layer_overrides[idx].keycode = dynamic_keymap_layer_cache[layer][row][col];
+                ++idx;
+            }
+        }
+    }
+    return idx;
 }
 
 void nvm_dynamic_keymap_save(void) {
+    // If a deferred append was lost, compact every layer so the files match the cache again
+    static uint32_t failures_seen = 0;
+    uint32_t        failures      = nvm_save_failure_count();
+    if (failures != failures_seen) {
+        failures_seen = failures;
+        for (int layer = 0; layer < keymap_layer_count(); ++layer) {
+            dynamic_keymap_log_count[layer] = 0;
+            dynamic_keymap_layer_dirty |= (1UL << layer);
+        }
+    }
+
     // Skip saving if nothing has changed
     if (!dynamic_keymap_layer_dirty) {
         return;
     }
 
-    // TODO: Implement a more efficient way to save only the altered keycodes, as littlefs prefers appending data instead of writing the whole thing
-    for (int layer = 0; layer < (sizeof(layer_state_t) * 8); ++layer) {
+    // Override lists are treated as a change log -- later entries win on load -- so small edits only append the keys
+    // changed since the last save. Once the log would outgrow the full layer, the file is compacted by rewriting it.
+    // Layers which couldn't be queued for saving are left dirty, and retried on the next pass.
+    for (int layer = 0; layer < keymap_layer_count(); ++layer) {
         // Skip layers that haven't been modified
-        if (!(dynamic_keymap_layer_dirty & (1 << layer))) {
+        if (!(dynamic_keymap_layer_dirty & (1UL << layer))) {
             continue;
         }
         char filename[18] = {0};
         snprintf(filename, sizeof(filename), "layers/key%02d", layer);
+        bool saved;
         if (dynamic_keymap_altered_count[layer] == 0) {
             // If nothing has been altered, delete any existing file as we'll just use the raw keymap for this layer
-            fs_delete(filename);
+            saved = nvm_save_delete(filename);
+            if (saved) {
+                dynamic_keymap_log_count[layer] = 0;
+            }
+        } else if (dynamic_keymap_log_count[layer] > 0 && dynamic_keymap_log_count[layer] + dynamic_keymap_unsaved_count[layer] <= MAX_KEYMAP_OVERRIDES //
+                   && nvm_save_append(filename, dynamic_keymap_scratch.keymap_layer_overrides, sizeof(dynamic_keymap_scratch.keymap_layer_overrides[0]) * nvm_dynamic_keymap_collect_overrides(layer, true))) {
+            // appended the changed keys to the existing overrides
+            dynamic_keymap_log_count[layer] += dynamic_keymap_unsaved_count[layer];
+            saved = true;
         } else {
             if (sizeof(dynamic_keymap_scratch.keymap_layer) <= (sizeof(dynamic_keymap_scratch.keymap_layer_overrides[0]) * dynamic_keymap_altered_count[layer])) {
                 // write the entire layer to filesystem
                 dynamic_keymap_scratch.write_mode = 0;
                 memcpy(dynamic_keymap_scratch.keymap_layer, dynamic_keymap_layer_cache[layer], sizeof(dynamic_keymap_scratch.keymap_layer));
-                fs_update_block(filename, &dynamic_keymap_scratch, sizeof(uint8_t) + sizeof(dynamic_keymap_scratch.keymap_layer));
+                saved = nvm_save_update(filename, &dynamic_keymap_scratch, sizeof(uint8_t) + sizeof(dynamic_keymap_scratch.keymap_layer));
+                if (saved) {
+                    dynamic_keymap_log_count[layer] = 0;
+                }
             } else {
                 // write the overrides to filesystem
                 dynamic_keymap_scratch.write_mode = 1;
-                size_t idx                        = 0;
-                for (int row = 0; row < MATRIX_ROWS; ++row) {
-                    for (int col = 0; col < MATRIX_COLS; ++col) {
-                        if (is_key_altered(layer, row, col)) {
-                            dynamic_keymap_scratch.keymap_layer_overrides[idx].row     = row;
-                            dynamic_keymap_scratch.keymap_layer_overrides[idx].col     = col;
-                            dynamic_keymap_scratch.keymap_layer_overrides[idx].keycode = dynamic_keymap_layer_cache[layer][row][col];
-                            ++idx;
-                        }
-                    }
+                size_t count                      = nvm_dynamic_keymap_collect_overrides(layer, false);
+                saved                             = nvm_save_update(filename, &dynamic_keymap_scratch, sizeof(uint8_t) + (sizeof(dynamic_keymap_scratch.keymap_layer_overrides[0]) * count));
+                if (saved) {
+                    dynamic_keymap_log_count[layer] = count;
                 }
-                fs_update_block(filename, &dynamic_keymap_scratch, sizeof(uint8_t) + (sizeof(dynamic_keymap_scratch.keymap_layer_overrides[0]) * dynamic_keymap_altered_count[layer]));
             }
         }
+        if (saved) {
+            clear_keys_unsaved(layer);
+            dynamic_keymap_layer_dirty &= ~(1UL << layer);
+        }
     }
+}
 
-    dynamic_keymap_layer_dirty = 0;
+static bool nvm_dynamic_keymap_load_override(const void *record, size_t offset, void *user_data) {
+    const keymap_override_entry_t *entry = (const keymap_override_entry_t *)record;
+    uint8_t                        layer = *(const uint8_t *)user_data;
+    if (entry->row < MATRIX_ROWS && entry->col < MATRIX_COLS) {
+        nvm_dynamic_keymap_set_keycode(layer, entry->row, entry->col, entry->keycode);
+    }
+    ++dynamic_keymap_log_count[layer];
+    return true;
 }
 
 void nvm_dynamic_keymap_load(void) {
-    for (int layer = 0; layer < (sizeof(layer_state_t) * 8); ++layer) {
+    for (uint8_t layer = 0; layer < keymap_layer_count(); ++layer) {
         char filename[18] = {0};
         snprintf(filename, sizeof(filename), "layers/key%02d", layer);
         nvm_dynamic_keymap_reset_cache_layer_to_raw(layer);
-        fs_fd_t fd = fs_open(filename, FS_READ);
-        if (fd == INVALID_FILESYSTEM_FD) {
-            fs_dprintf("could not open file\n");
+
+        fs_block_reader_t reader;
+        if (!fs_block_reader_open(&reader, filename)) {
             continue;
         }
-        size_t bytes_read = fs_read(fd, &dynamic_keymap_scratch, sizeof(dynamic_keymap_scratch));
-        fs_close(fd);
-        fs_hexdump("read", filename, &dynamic_keymap_scratch, bytes_read);
-        if (dynamic_keymap_scratch.write_mode == 0) {
-            // full keymap
-            for (int row = 0; row < MATRIX_ROWS; ++row) {
-                for (int col = 0; col < MATRIX_COLS; ++col) {
-                    nvm_dynamic_keymap_update_keycode(layer, row, col, dynamic_keymap_scratch.keymap_layer[row][col]);
+        uint8_t write_mode;
+        if (fs_block_reader_read(&reader, 0, &write_mode, sizeof(write_mode)) == sizeof(write_mode)) {
+            if (write_mode == 0) {
+                // full keymap, read straight into the live copy
+                if (fs_block_reader_read(&reader, sizeof(write_mode), dynamic_keymap_layer_cache[layer], sizeof(dynamic_keymap_layer_cache[layer])) == sizeof(dynamic_keymap_layer_cache[layer])) {
+                    for (uint8_t row = 0; row < MATRIX_ROWS; ++row) {
+                        for (uint8_t col = 0; col < MATRIX_COLS; ++col) {
+                            set_key_altered(layer, row, col, dynamic_keymap_layer_cache[layer][row][col] != keycode_at_keymap_location_raw(layer, row, col));
+                        }
+                    }
+                } else {
+                    nvm_dynamic_keymap_reset_cache_layer_to_raw(layer);
+                }
+            } else {
+                // overrides, applied as they're read
+                if (fs_block_reader_stream(&reader, sizeof(write_mode), sizeof(keymap_override_entry_t), nvm_dynamic_keymap_load_override, &layer) < 0) {
+                    fs_dprintf("could not read keymap layer %d overrides\n", layer);
                 }
-            }
-        } else {
-            // overrides
-            int count = (bytes_read - sizeof(uint8_t)) / sizeof(dynamic_keymap_scratch.keymap_layer_overrides[0]);
-            fs_dprintf("keymap layer %d override count: %d\n", layer, count);
-            for (int j = 0; j < count; ++j) {
-                uint8_t  row     = dynamic_keymap_scratch.keymap_layer_overrides[j].row;
-                uint8_t  column  = dynamic_keymap_scratch.keymap_layer_overrides[j].col;
-                uint16_t keycode = dynamic_keymap_scratch.keymap_layer_overrides[j].keycode;
-                nvm_dynamic_keymap_update_keycode(layer, row, column, keycode);
             }
         }
+        fs_block_reader_close(&reader);
     }
 }
 
@@ -261,11 +345,17 @@ uint16_t nvm_dynamic_keymap_read_encoder(uint8_t layer, uint8_t encoder_id, bool
     return dynamic_encodermap_layer_cache[layer][encoder_id][clockwise ? ENCODER_ARRAYINDEX_CW : ENCODER_ARRAYINDEX_CCW];
 }
 
-void nvm_dynamic_keymap_update_encoder(uint8_t layer, uint8_t encoder_id, bool clockwise, uint16_t keycode) {
-    if (layer >= encodermap_layer_count() || encoder_id >= NUM_ENCODERS) return;
+static void nvm_dynamic_encodermap_set_keycode(uint8_t layer, uint8_t encoder_id, bool clockwise, uint16_t keycode) {
+    // Assume layer/encoder_id already bounds-checked by caller
     dynamic_encodermap_layer_cache[layer][encoder_id][clockwise ? ENCODER_ARRAYINDEX_CW : ENCODER_ARRAYINDEX_CCW] = keycode;
     set_encodermap_altered(layer, encoder_id, clockwise, keycode != keycode_at_encodermap_location_raw(layer, encoder_id, clockwise));
+}
+
+void nvm_dynamic_keymap_update_encoder(uint8_t layer, uint8_t encoder_id, bool clockwise, uint16_t keycode) {
+    if (layer >= encodermap_layer_count() || encoder_id >= NUM_ENCODERS) return;
+    nvm_dynamic_encodermap_set_keycode(layer, encoder_id, clockwise, keycode);
     dynamic_encodermap_layer_dirty |= (1 << layer);
+    nvm_filesystem_mark_dirty();
 }
 
 void nvm_dynamic_encodermap_save(void) {
@@ -282,15 +372,16 @@ void nvm_dynamic_encodermap_save(void) {
         }
         char filename[18] = {0};
         snprintf(filename, sizeof(filename), "layers/enc%02d", layer);
+        bool saved;
         if (dynamic_encodermap_altered_count[layer] == 0) {
             // If nothing has been altered, delete any existing file as we'll just use the raw keymap for this layer
-            fs_delete(filename);
+            saved = nvm_save_delete(filename);
         } else {
             if (sizeof(dynamic_keymap_scratch.encodermap_layer) <= sizeof(dynamic_keymap_scratch.encodermap_layer_overrides[0]) * dynamic_encodermap_altered_count[layer]) {
                 // write the entire layer to filesystem
                 dynamic_keymap_scratch.write_mode = 0;
                 memcpy(dynamic_keymap_scratch.encodermap_layer, dynamic_encodermap_layer_cache[layer], sizeof(dynamic_keymap_scratch.encodermap_layer));
-                fs_update_block(filename, &dynamic_keymap_scratch, sizeof(uint8_t) + sizeof(dynamic_keymap_scratch.encodermap_layer));
+                saved = nvm_save_update(filename, &dynamic_keymap_scratch, sizeof(uint8_t) + sizeof(dynamic_keymap_scratch.encodermap_layer));
             } else {
                 // write the overrides to filesystem
                 dynamic_keymap_scratch.write_mode = 1;
@@ -305,44 +396,57 @@ void nvm_dynamic_encodermap_save(void) {
                         }
                     }
                 }
-                fs_update_block(filename, &dynamic_keymap_scratch, sizeof(uint8_t) + (sizeof(dynamic_keymap_scratch.encodermap_layer_overrides[0]) * dynamic_encodermap_altered_count[layer]));
+                saved = nvm_save_update(filename, &dynamic_keymap_scratch, sizeof(uint8_t) + (sizeof(dynamic_keymap_scratch.encodermap_layer_overrides[0]) * dynamic_encodermap_altered_count[layer]));
             }
         }
+        // Layers which couldn't be queued for saving are left dirty, and retried on the next pass
+        if (saved) {
+            dynamic_encodermap_layer_dirty &= ~(1UL << layer);
+        }
     }
-    dynamic_encodermap_layer_dirty = 0;
+}
+
+static bool nvm_dynamic_encodermap_load_override(const void *record, size_t offset, void *user_data) {
+    const encodermap_override_entry_t *entry = (const encodermap_override_entry_t *)record;
+    uint8_t                            layer = *(const uint8_t *)user_data;
+    if (entry->encoder_id < NUM_ENCODERS && entry->enc_dir < NUM_DIRECTIONS) {
+        nvm_dynamic_encodermap_set_keycode(layer, entry->encoder_id, (entry->enc_dir == ENCODER_ARRAYINDEX_CW), entry->keycode);
+    }
+    return true;
 }
 
 void nvm_dynamic_encodermap_load(void) {
-    for (int layer = 0; layer < (sizeof(layer_state_t) * 8); ++layer) {
+    for (uint8_t layer = 0; layer < encodermap_layer_count(); ++layer) {
         char filename[18] = {0};
         snprintf(filename, sizeof(filename), "layers/enc%02d", layer);
         nvm_dynamic_encodermap_reset_cache_layer_to_raw(layer);
-        fs_fd_t fd = fs_open(filename, FS_READ);
-        if (fd == INVALID_FILESYSTEM_FD) {
-            fs_dprintf("could not open file\n");
+
+        fs_block_reader_t reader;
+        if (!fs_block_reader_open(&reader, filename)) {
             continue;
         }
-        size_t bytes_read = fs_read(fd, &dynamic_keymap_scratch, sizeof(dynamic_keymap_scratch));
-        fs_close(fd);
-        fs_hexdump("read", filename, &dynamic_keymap_scratch, bytes_read);
-        if (dynamic_keymap_scratch.write_mode == 0) {
-            // full keymap
-            for (int enc_id = 0; enc_id < NUM_ENCODERS; ++enc_id) {
-                for (int enc_dir = 0; enc_dir < NUM_DIRECTIONS; ++enc_dir) {
-                    nvm_dynamic_keymap_update_encoder(layer, enc_id, (enc_dir == ENCODER_ARRAYINDEX_CW), dynamic_keymap_scratch.encodermap_layer[enc_id][enc_dir]);
+        uint8_t write_mode;
+        if (fs_block_reader_read(&reader, 0, &write_mode, sizeof(write_mode)) == sizeof(write_mode)) {
+            if (write_mode == 0) {
+                // full encodermap, read straight into the live copy
+                if (fs_block_reader_read(&reader, sizeof(write_mode), dynamic_encodermap_layer_cache[layer], sizeof(dynamic_encodermap_layer_cache[layer])) == sizeof(dynamic_encodermap_layer_cache[layer])) {
+                    for (uint8_t enc_id = 0; enc_id < NUM_ENCODERS; ++enc_id) {
+                        for (uint8_t enc_dir = 0; enc_dir < NUM_DIRECTIONS; ++enc_dir) {
+                            bool clockwise = (enc_dir == ENCODER_ARRAYINDEX_CW);
+                            set_encodermap_altered(layer, enc_id, clockwise, dynamic_encodermap_layer_cache[layer][enc_id][enc_dir] != keycode_at_encodermap_location_raw(layer, enc_id, clockwise));
+                        }
+                    }
+                } else {
+                    nvm_dynamic_encodermap_reset_cache_layer_to_raw(layer);
+                }
+            } else {
+                // overrides, applied as they're read
+                if (fs_block_reader_stream(&reader, sizeof(write_mode), sizeof(encodermap_override_entry_t), nvm_dynamic_encodermap_load_override, &layer) < 0) {
+                    fs_dprintf("could not read encodermap layer %d overrides\n", layer);
                 }
-            }
-        } else {
-            // overrides
-            int count = (bytes_read - sizeof(uint8_t)) / sizeof(dynamic_keymap_scratch.encodermap_layer_overrides[0]);
-            fs_dprintf("keymap layer %d override count: %d\n", layer, count);
-            for (int j = 0; j < count; ++j) {
-                uint8_t  encoder_id = dynamic_keymap_scratch.encodermap_layer_overrides[j].encoder_id;
-                uint8_t  enc_dir    = dynamic_keymap_scratch.encodermap_layer_overrides[j].enc_dir;
-                uint16_t keycode    = dynamic_keymap_scratch.encodermap_layer_overrides[j].keycode;
-                nvm_dynamic_keymap_update_encoder(layer, encoder_id, (enc_dir == ENCODER_ARRAYINDEX_CW), keycode);
             }
         }
+        fs_block_reader_close(&reader);
     }
 }
 
@@ -388,6 +492,9 @@ void nvm_dynamic_keymap_update_buffer(uint32_t offset, uint32_t size, uint8_t *d
 bool dynamic_macro_altered      = false;
 char dynamic_macro_buffer[1024] = {0};
 
+// First macro still to be saved, if a previous save couldn't queue them all
+static int dynamic_macro_save_next = 0;
+
 uint32_t nvm_dynamic_keymap_macro_size(void) {
     return sizeof(dynamic_macro_buffer);
 }
@@ -405,14 +512,17 @@ void nvm_dynamic_keymap_macro_update_buffer(uint32_t offset, uint32_t size, uint
     }
     if (memcmp(dynamic_macro_buffer + offset, data, size) != 0) {
         memcpy(dynamic_macro_buffer + offset, data, size);
-        dynamic_macro_altered = true;
+        dynamic_macro_altered   = true;
+        dynamic_macro_save_next = 0;
+        nvm_filesystem_mark_dirty();
     }
 }
 
 void nvm_dynamic_keymap_macro_reset(void) {
     nvm_dynamic_keymap_macro_erase();
     memset(dynamic_macro_buffer, 0, sizeof(dynamic_macro_buffer));
-    dynamic_macro_altered = false;
+    dynamic_macro_altered   = false;
+    dynamic_macro_save_next = 0;
 }
 
 void nvm_dynamic_keymap_macro_save(void) {
@@ -425,15 +535,20 @@ void nvm_dynamic_keymap_macro_save(void) {
             while (*macro_end != 0 && macro_end < terminator) {
                 macro_end++;
             }
-            if (macro_end - macro_start > 0) {
+            if (macro_end - macro_start > 0 && n >= dynamic_macro_save_next) {
                 char filename[18] = {0};
                 snprintf(filename, sizeof(filename), "macros/%02d", n);
-                fs_update_block(filename, macro_start, macro_end - macro_start);
+                if (!nvm_save_update(filename, macro_start, macro_end - macro_start)) {
+                    // Resume from this macro on the next pass
+                    dynamic_macro_save_next = n;
+                    return;
+                }
             }
             ++n;
             macro_start = macro_end + 1;
         }
-        dynamic_macro_altered = false;
+        dynamic_macro_altered   = false;
+        dynamic_macro_save_next = 0;
     }
 }
 
@@ -446,17 +561,12 @@ void nvm_dynamic_keymap_macro_load(void) {
         char filename[18] = {0};
         snprintf(filename, sizeof(filename), "macros/%02d", n);
         if (fs_exists(filename)) {
-            fs_fd_t fd = fs_open(filename, FS_READ);
-            if (fd != INVALID_FILESYSTEM_FD) {
-                size_t count = fs_read(fd, ptr, max_count);
-                fs_close(fd);
-
-                if (count > 0) {
-                    ptr += (count + 1);
-                    max_count -= (count + 1);
-                } else {
-                    break;
-                }
+            size_t count = fs_read_block_upto(filename, ptr, max_count);
+            if (count > 0) {
+                ptr += (count + 1);
+                max_count -= (count + 1);
+            } else {
+                break;
             }
         } else {
             break;
@@ -476,6 +586,8 @@ static void nvm_dynamic_keymap_reset_cache_layer_to_raw(uint8_t layer) {
     }
     dynamic_keymap_altered_count[layer] = 0;
     memset(dynamic_keymap_altered_keys[layer], 0, sizeof(dynamic_keymap_altered_keys[layer]));
+    dynamic_keymap_log_count[layer] = 0;
+    clear_keys_unsaved(layer);
 }
 
 static void nvm_dynamic_keymap_reset_cache_to_raw(void) {
@@ -501,29 +613,3 @@ static void nvm_dynamic_encodermap_reset_cache_to_raw(void) {
     }
 }
 #endif // defined(ENCODER_ENABLE) && defined(ENCODER_MAP_ENABLE)
-
-////////////////////////////////////////////////////////////////////////////////
-// Base hooks
-
-void keyboard_post_init_filesystem() {
-    keyboard_post_init_filesystem_kb();
-    nvm_dynamic_keymap_load();
-    nvm_dynamic_keymap_macro_load();
-#if defined(ENCODER_ENABLE) && defined(ENCODER_MAP_ENABLE)
-    nvm_dynamic_encodermap_load();
-#endif // defined(ENCODER_ENABLE) && defined(ENCODER_MAP_ENABLE)
-}
-
-void housekeeping_task_filesystem(void) {
-    // Throttle saves to every 250ms
-    static uint32_t last_exec = 0;
-    if (timer_elapsed32(last_exec) >= 250) {
-        last_exec = timer_read32();
-
-        nvm_dynamic_keymap_save();
-        nvm_dynamic_keymap_macro_save();
-#if defined(ENCODER_ENABLE) && defined(ENCODER_MAP_ENABLE)
-        nvm_dynamic_encodermap_save();
-#endif
-    }
-}
@@ -1,8 +1,10 @@
 // Copyright 2022-2026 Nick Brassel (@tzarc)
 // SPDX-License-Identifier: GPL-2.0-or-later
+#include <stddef.h>
 #include <string.h>
 #include "nvm_eeconfig.h"
 #include "filesystem.h"
+#include "nvm_filesystem.h"
 #include "eeconfig.h"
 #include "debug.h"
 #include "keycode_config.h"
@@ -35,275 +37,462 @@
 #    include "haptic.h"
 #endif
 
-void nvm_eeconfig_erase(void) {
-    fs_rmdir("ee", true);
-    fs_mkdir("ee");
-}
-
-// TODO
-// littlefs doesn't like writes mid-way through a file.
-// Swap to a mechanism much like classic QMK wear-leveling:
-// - Write the full data first time around
-// - Subsequent writes are (header+data) appended -- header contains (offset+length)
-// - Once a threahold is reached, rewrite the entire file with the live copy of data instead of playing back the log
-
-#define MAX_STACK_BUFFER_SIZE 32
+// Small eeconfig values are kept in a RAM-resident write-back cache:
+// - All ee/* values are loaded in one pass on first access, and reads are then served from RAM
+// - Updates only touch RAM and mark the value dirty, unchanged values are ignored
+// - Dirty values are written back in a batch by nvm_eeconfig_flush(), invoked from housekeeping, suspend, and shutdown
+// - The magic number is written back last, so an interrupted flush after a reset doesn't validate stale values
+//
+// With FILESYSTEM_EECONFIG_PACKED, the cache is instead stored as a single versioned, CRC-protected record in
+// ee/config, so loading is one read and a flush is one metadata commit. If the record is missing or invalid, the
+// per-setting files are loaded instead, and replaced by the record on the next flush.
+
+typedef struct nvm_eeconfig_cache_t {
+    uint16_t        magic;
+    debug_config_t  debug;
+    layer_state_t   default_layer;
+    keymap_config_t keymap;
+    uint32_t        keyboard;
+    uint32_t        user;
+    uint8_t         handedness;
+    uint32_t        keymap_hash;
+#ifdef AUDIO_ENABLE
+    audio_config_t audio;
+#endif // AUDIO_ENABLE
+#ifdef UNICODE_COMMON_ENABLE
+    unicode_config_t unicodemode;
+#endif // UNICODE_COMMON_ENABLE
+#ifdef BACKLIGHT_ENABLE
+    backlight_config_t backlight;
+#endif // BACKLIGHT_ENABLE
+#ifdef STENO_ENABLE
+    uint8_t stenomode;
+#endif // STENO_ENABLE
+#ifdef RGB_MATRIX_ENABLE
+    rgb_config_t rgb_matrix;
+#endif // RGB_MATRIX_ENABLE
+#ifdef LED_MATRIX_ENABLE
+    led_eeconfig_t led_matrix;
+#endif // LED_MATRIX_ENABLE
+#ifdef RGBLIGHT_ENABLE
+    rgblight_config_t rgblight;
+#endif // RGBLIGHT_ENABLE
+#ifdef HAPTIC_ENABLE
+    haptic_config_t haptic;
+#endif // HAPTIC_ENABLE
+} nvm_eeconfig_cache_t;
+
+typedef enum nvm_eeconfig_entry_id_t {
+    NVM_EECONFIG_DEBUG,
+    NVM_EECONFIG_DEFAULT_LAYER,
+    NVM_EECONFIG_KEYMAP,
+    NVM_EECONFIG_KEYBOARD,
+    NVM_EECONFIG_USER,
+    NVM_EECONFIG_HANDEDNESS,
+    NVM_EECONFIG_KEYMAP_HASH,
+#ifdef AUDIO_ENABLE
+    NVM_EECONFIG_AUDIO,
+#endif // AUDIO_ENABLE
+#ifdef UNICODE_COMMON_ENABLE
+    NVM_EECONFIG_UNICODEMODE,
+#endif // UNICODE_COMMON_ENABLE
+#ifdef BACKLIGHT_ENABLE
+    NVM_EECONFIG_BACKLIGHT,
+#endif // BACKLIGHT_ENABLE
+#ifdef STENO_ENABLE
+    NVM_EECONFIG_STENOMODE,
+#endif // STENO_ENABLE
+#ifdef RGB_MATRIX_ENABLE
+    NVM_EECONFIG_RGB_MATRIX,
+#endif // RGB_MATRIX_ENABLE
+#ifdef LED_MATRIX_ENABLE
+    NVM_EECONFIG_LED_MATRIX,
+#endif // LED_MATRIX_ENABLE
+#ifdef RGBLIGHT_ENABLE
+    NVM_EECONFIG_RGBLIGHT,
+#endif // RGBLIGHT_ENABLE
+#ifdef HAPTIC_ENABLE
+    NVM_EECONFIG_HAPTIC,
+#endif // HAPTIC_ENABLE
+    NVM_EECONFIG_MAGIC, // Must be last, see above
+    NVM_EECONFIG_ENTRY_COUNT,
+} nvm_eeconfig_entry_id_t;
+_Static_assert(NVM_EECONFIG_ENTRY_COUNT <= 32, "Too many eeconfig entries for the dirty mask");
+
+typedef struct nvm_eeconfig_entry_t {
+    const char *filename;
+    uint16_t    offset;
+    uint16_t    size;
+} nvm_eeconfig_entry_t;
+
+#define NVM_EECONFIG_ENTRY(id, name, field) [id] = {.filename = name, .offset = offsetof(nvm_eeconfig_cache_t, field), .size = sizeof(((nvm_eeconfig_cache_t *)0)->field)}
+
+static const nvm_eeconfig_entry_t nvm_eeconfig_entries[NVM_EECONFIG_ENTRY_COUNT] = {
+    NVM_EECONFIG_ENTRY(NVM_EECONFIG_MAGIC, "ee/magic", magic),
+    NVM_EECONFIG_ENTRY(NVM_EECONFIG_DEBUG, "ee/debug", debug),
+    NVM_EECONFIG_ENTRY(NVM_EECONFIG_DEFAULT_LAYER, "ee/default_layer", default_layer),
+    NVM_EECONFIG_ENTRY(NVM_EECONFIG_KEYMAP, "ee/keymap", keymap),
+    NVM_EECONFIG_ENTRY(NVM_EECONFIG_KEYBOARD, "ee/keyboard", keyboard),
+    NVM_EECONFIG_ENTRY(NVM_EECONFIG_USER, "ee/user", user),
+    NVM_EECONFIG_ENTRY(NVM_EECONFIG_HANDEDNESS, "ee/handedness", handedness),
+    NVM_EECONFIG_ENTRY(NVM_EECONFIG_KEYMAP_HASH, "ee/keymap_hash", keymap_hash),
+#ifdef AUDIO_ENABLE
+    NVM_EECONFIG_ENTRY(NVM_EECONFIG_AUDIO, "ee/audio", audio),
+#endif // AUDIO_ENABLE
+#ifdef UNICODE_COMMON_ENABLE
+    NVM_EECONFIG_ENTRY(NVM_EECONFIG_UNICODEMODE, "ee/unicodemode", unicodemode),
+#endif // UNICODE_COMMON_ENABLE
+#ifdef BACKLIGHT_ENABLE
+    NVM_EECONFIG_ENTRY(NVM_EECONFIG_BACKLIGHT, "ee/backlight", backlight),
+#endif // BACKLIGHT_ENABLE
+#ifdef STENO_ENABLE
+    NVM_EECONFIG_ENTRY(NVM_EECONFIG_STENOMODE, "ee/stenomode", stenomode),
+#endif // STENO_ENABLE
+#ifdef RGB_MATRIX_ENABLE
+    NVM_EECONFIG_ENTRY(NVM_EECONFIG_RGB_MATRIX, "ee/rgb_matrix", rgb_matrix),
+#endif // RGB_MATRIX_ENABLE
+#ifdef LED_MATRIX_ENABLE
+    NVM_EECONFIG_ENTRY(NVM_EECONFIG_LED_MATRIX, "ee/led_matrix", led_matrix),
+#endif // LED_MATRIX_ENABLE
+#ifdef RGBLIGHT_ENABLE
+    NVM_EECONFIG_ENTRY(NVM_EECONFIG_RGBLIGHT, "ee/rgblight", rgblight),
+#endif // RGBLIGHT_ENABLE
+#ifdef HAPTIC_ENABLE
+    NVM_EECONFIG_ENTRY(NVM_EECONFIG_HAPTIC, "ee/haptic", haptic),
+#endif // HAPTIC_ENABLE
+};
 
-static bool fs_chunked_data_compare(fs_fd_t fd, const void *data, size_t size) {
-    uint8_t        stack_buffer[MAX_STACK_BUFFER_SIZE];
-    size_t         remaining = size;
-    size_t         offset    = 0;
-    const uint8_t *data_ptr  = (const uint8_t *)data;
+static nvm_eeconfig_cache_t nvm_eeconfig_cache;
+static bool                 nvm_eeconfig_cache_loaded = false;
+static uint32_t             nvm_eeconfig_cache_dirty  = 0;
 
-    while (remaining > 0) {
-        size_t chunk_size = remaining > MAX_STACK_BUFFER_SIZE ? MAX_STACK_BUFFER_SIZE : remaining;
-        if (fs_read(fd, stack_buffer, chunk_size) != chunk_size) {
-            return false; // Read error, assume different
-        }
-        if (memcmp(stack_buffer, data_ptr + offset, chunk_size) != 0) {
-            return false; // Data differs
-        }
-        offset += chunk_size;
-        remaining -= chunk_size;
+static void nvm_eeconfig_load_files(void) {
+    for (int i = 0; i < NVM_EECONFIG_ENTRY_COUNT; ++i) {
+        const nvm_eeconfig_entry_t *entry = &nvm_eeconfig_entries[i];
+        fs_read_block(entry->filename, (uint8_t *)&nvm_eeconfig_cache + entry->offset, entry->size);
     }
-    return true; // All chunks match
 }
 
-size_t fs_read_block(const char *filename, void *data, size_t size) {
-    fs_fd_t fd = fs_open(filename, FS_READ);
-    if (fd == INVALID_FILESYSTEM_FD) {
-        fs_dprintf("could not open file\n");
-        memset(data, 0, size);
-        return 0;
+#ifndef FILESYSTEM_EECONFIG_PACKED
+static void nvm_eeconfig_flush_files(void) {
+    for (int i = 0; i < NVM_EECONFIG_ENTRY_COUNT; ++i) {
+        if (nvm_eeconfig_cache_dirty & (1UL << i)) {
+            const nvm_eeconfig_entry_t *entry = &nvm_eeconfig_entries[i];
+            // Stop at the first entry which couldn't be queued, so the magic number is still written last
+            if (!nvm_save_update(entry->filename, (const uint8_t *)&nvm_eeconfig_cache + entry->offset, entry->size)) {
+                return;
+            }
+            nvm_eeconfig_cache_dirty &= ~(1UL << i);
+        }
     }
-    size_t read_bytes;
-    if ((read_bytes = fs_read(fd, data, size)) != size) {
-        fs_dprintf("did not read correct number of bytes\n");
-        memset(data, 0, size);
-        fs_close(fd);
-        return read_bytes;
+}
+#endif // FILESYSTEM_EECONFIG_PACKED
+
+#ifdef FILESYSTEM_EECONFIG_PACKED
+static const char EECONFIG_RECORD[] = "ee/config";
+
+// Bump whenever the meaning of existing fields changes; adding, removing, or moving fields is caught by the layout check
+#    define NVM_EECONFIG_RECORD_VERSION 2
+
+typedef struct __attribute__((packed)) nvm_eeconfig_record_header_t {
+    uint16_t version; // NVM_EECONFIG_RECORD_VERSION
+    uint16_t size;    // sizeof(nvm_eeconfig_cache_t)
+    uint32_t layout;  // nvm_eeconfig_layout() of the firmware which wrote the record
+    uint32_t crc;     // CRC32 of the cache data following the header
+} nvm_eeconfig_record_header_t;
+_Static_assert(sizeof(nvm_eeconfig_record_header_t) == 12, "nvm_eeconfig_record_header_t size is not 12 bytes");
+
+typedef struct __attribute__((packed)) nvm_eeconfig_record_t {
+    nvm_eeconfig_record_header_t header;
+    nvm_eeconfig_cache_t         data;
+} nvm_eeconfig_record_t;
+
+// Set when the cache was loaded from the per-setting files, which get removed once the record is written
+static bool nvm_eeconfig_record_migrating = false;
+
+// Fingerprint of which settings the cache holds and where each one lives. The size alone isn't enough: enabling one
+// feature while disabling another with a field of the same size moves every later field, yet the size stays the same.
+static uint32_t nvm_eeconfig_layout(void) {
+    uint32_t layout = 0;
+    for (int i = 0; i < NVM_EECONFIG_ENTRY_COUNT; ++i) {
+        const nvm_eeconfig_entry_t *entry   = &nvm_eeconfig_entries[i];
+        uint32_t                    part[3] = {layout ^ fs_crc32(entry->filename, strlen(entry->filename)), entry->offset, entry->size};
+        layout                              = fs_crc32(part, sizeof(part));
     }
-    fs_close(fd);
-    fs_hexdump("read", filename, data, size);
-    return size;
+    return layout;
 }
 
-void fs_update_block(const char *filename, const void *data, size_t size) {
-    fs_hexdump("save", filename, data, size);
+static bool nvm_eeconfig_load_record(void) {
+    nvm_eeconfig_record_t record;
+    if (fs_read_block_upto(EECONFIG_RECORD, &record, sizeof(record)) != sizeof(record)) {
+        return false;
+    }
+    if (record.header.version != NVM_EECONFIG_RECORD_VERSION || record.header.size != sizeof(nvm_eeconfig_cache_t) || record.header.layout != nvm_eeconfig_layout()) {
+        fs_dprintf("record version/layout mismatch\n");
+        return false;
+    }
+    if (record.header.crc != fs_crc32(&record.data, sizeof(record.data))) {
+        fs_dprintf("record crc mismatch\n");
+        return false;
+    }
+    memcpy(&nvm_eeconfig_cache, &record.data, sizeof(nvm_eeconfig_cache));
+    return true;
+}
+
+static void nvm_eeconfig_flush_record(void) {
+    nvm_eeconfig_record_t record = {
+        .header =
+            {
+                .version = NVM_EECONFIG_RECORD_VERSION,
+                .size    = sizeof(nvm_eeconfig_cache_t),
+                .layout  = nvm_eeconfig_layout(),
+                .crc     = fs_crc32(&nvm_eeconfig_cache, sizeof(nvm_eeconfig_cache)),
+            },
+    };
+    memcpy(&record.data, &nvm_eeconfig_cache, sizeof(record.data));
+    if (!nvm_save_update(EECONFIG_RECORD, &record, sizeof(record))) {
+        return;
+    }
 
-    // Check if data has changed using chunked comparison
-    fs_fd_t read_fd = fs_open(filename, FS_READ);
-    if (read_fd != INVALID_FILESYSTEM_FD) {
-        if (fs_chunked_data_compare(read_fd, data, size)) {
-            fs_dprintf("no change, skipping write\n");
-            fs_close(read_fd);
-            return;
+    if (nvm_eeconfig_record_migrating) {
+        for (int i = 0; i < NVM_EECONFIG_ENTRY_COUNT; ++i) {
+            // Deleting is idempotent, so if the queue fills up just retry the lot on the next pass
+            if (!nvm_save_delete(nvm_eeconfig_entries[i].filename)) {
+                return;
+            }
         }
-        fs_close(read_fd);
+        nvm_eeconfig_record_migrating = false;
     }
-    fs_fd_t fd = fs_open(filename, FS_WRITE | FS_TRUNCATE);
-    if (fd == INVALID_FILESYSTEM_FD) {
-        fs_dprintf("could not open file\n");
+    nvm_eeconfig_cache_dirty = 0;
+}
+#endif // FILESYSTEM_EECONFIG_PACKED
+
+static nvm_eeconfig_cache_t *nvm_eeconfig_cache_get(void) {
+    if (!nvm_eeconfig_cache_loaded) {
+        // Keep the filesystem mounted across the whole batch of reads
+        fs_mount();
+        nvm_eeconfig_cache_dirty = 0;
+#ifdef FILESYSTEM_EECONFIG_PACKED
+        if (!nvm_eeconfig_load_record()) {
+            // Fall back to the per-setting files, and write out the record at the next flush
+            nvm_eeconfig_load_files();
+            nvm_eeconfig_record_migrating = true;
+            nvm_eeconfig_cache_dirty      = (1UL << NVM_EECONFIG_ENTRY_COUNT) - 1;
+        }
+#else  // FILESYSTEM_EECONFIG_PACKED
+        nvm_eeconfig_load_files();
+#endif // FILESYSTEM_EECONFIG_PACKED
+        fs_unmount();
+        nvm_eeconfig_cache_loaded = true;
+    }
+    return &nvm_eeconfig_cache;
+}
+
+static void nvm_eeconfig_cache_update(nvm_eeconfig_entry_id_t id, const void *data, size_t size) {
+    const nvm_eeconfig_entry_t *entry = &nvm_eeconfig_entries[id];
+    if (size != entry->size) {
+        fs_dprintf("size mismatch for %s\n", entry->filename);
         return;
     }
-    if (fs_write(fd, data, size) != size) {
-        fs_dprintf("did not write correct number of bytes\n");
+    uint8_t *cached = (uint8_t *)nvm_eeconfig_cache_get() + entry->offset;
+    if (memcmp(cached, data, size) != 0) {
+        memcpy(cached, data, size);
+        nvm_eeconfig_cache_dirty |= (1UL << id);
+        nvm_filesystem_mark_dirty();
     }
-    fs_close(fd);
+}
 
-#if defined(FILESYSTEM_VERIFY_WRITES)
-    // Verify write integrity for data safety
-    fs_fd_t verify_fd = fs_open(filename, FS_READ);
-    if (verify_fd != INVALID_FILESYSTEM_FD) {
-        if (!fs_chunked_data_compare(verify_fd, data, size)) {
-            fs_dprintf("readback mismatch!\n");
-        }
-        fs_close(verify_fd);
+void nvm_eeconfig_flush(void) {
+    if (!nvm_eeconfig_cache_dirty) {
+        return;
     }
-#endif // FILESYSTEM_VERIFY_WRITES
+
+#ifndef FILESYSTEM_ASYNC_SAVE
+    // Keep the filesystem mounted across the whole batch of writes
+    fs_mount();
+#endif // FILESYSTEM_ASYNC_SAVE
+#ifdef FILESYSTEM_EECONFIG_PACKED
+    nvm_eeconfig_flush_record();
+#else  // FILESYSTEM_EECONFIG_PACKED
+    nvm_eeconfig_flush_files();
+#endif // FILESYSTEM_EECONFIG_PACKED
+#ifndef FILESYSTEM_ASYNC_SAVE
+    fs_unmount();
+#endif // FILESYSTEM_ASYNC_SAVE
 }
 
-#define FS_RW_TYPED(type, suffix)                                     \
-    static type fs_read_##suffix(const char *filename) {              \
-        type data;                                                    \
-        fs_read_block(filename, &data, sizeof(type));                 \
-        return data;                                                  \
-    }                                                                 \
-    static void fs_update_##suffix(const char *filename, type data) { \
-        fs_update_block(filename, &data, sizeof(type));               \
-    }
+void nvm_eeconfig_erase(void) {
+    // Let any queued saves land first, so they can't recreate files after the erase
+    nvm_save_barrier();
+    fs_rmdir("ee", true);
+    fs_mkdir("ee");
 
-FS_RW_TYPED(uint32_t, u32)
-FS_RW_TYPED(uint16_t, u16)
-FS_RW_TYPED(uint8_t, u8)
+    // Everything now reads back as zero, and anything pending is now moot
+    memset(&nvm_eeconfig_cache, 0, sizeof(nvm_eeconfig_cache));
+    nvm_eeconfig_cache_loaded = true;
+    nvm_eeconfig_cache_dirty  = 0;
+#ifdef FILESYSTEM_EECONFIG_PACKED
+    nvm_eeconfig_record_migrating = false;
+#endif // FILESYSTEM_EECONFIG_PACKED
+}
+
+#define NVM_EECONFIG_UPDATE_TYPED(type, suffix)                                             \
+    static void nvm_eeconfig_cache_update_##suffix(nvm_eeconfig_entry_id_t id, type data) { \
+        nvm_eeconfig_cache_update(id, &data, sizeof(type));                                 \
+    }
 
-static const char EECONFIG_MAGIC[]         = "ee/magic";
-static const char EECONFIG_DEBUG[]         = "ee/debug";
-static const char EECONFIG_DEFAULT_LAYER[] = "ee/default_layer";
-static const char EECONFIG_KEYMAP[]        = "ee/keymap";
-static const char EECONFIG_KEYBOARD[]      = "ee/keyboard";
-static const char EECONFIG_USER[]          = "ee/user";
-static const char EECONFIG_HANDEDNESS[]    = "ee/handedness";
-static const char EECONFIG_KEYMAP_HASH[]   = "ee/keymap_hash";
+NVM_EECONFIG_UPDATE_TYPED(uint32_t, u32)
+NVM_EECONFIG_UPDATE_TYPED(uint16_t, u16)
+NVM_EECONFIG_UPDATE_TYPED(uint8_t, u8)
 
 bool nvm_eeconfig_is_enabled(void) {
-    return fs_read_u16(EECONFIG_MAGIC) == EECONFIG_MAGIC_NUMBER;
+    return nvm_eeconfig_cache_get()->magic == EECONFIG_MAGIC_NUMBER;
 }
 
 bool nvm_eeconfig_is_disabled(void) {
-    return fs_read_u16(EECONFIG_MAGIC) == EECONFIG_MAGIC_NUMBER_OFF;
+    return nvm_eeconfig_cache_get()->magic == EECONFIG_MAGIC_NUMBER_OFF;
 }
 
 void nvm_eeconfig_enable(void) {
-    fs_update_u16(EECONFIG_MAGIC, EECONFIG_MAGIC_NUMBER);
+    nvm_eeconfig_cache_update_u16(NVM_EECONFIG_MAGIC, EECONFIG_MAGIC_NUMBER);
 }
 
 void nvm_eeconfig_disable(void) {
     nvm_eeconfig_erase();
-    fs_update_u16(EECONFIG_MAGIC, EECONFIG_MAGIC_NUMBER_OFF);
+    nvm_eeconfig_cache_update_u16(NVM_EECONFIG_MAGIC, EECONFIG_MAGIC_NUMBER_OFF);
 }
 
 void nvm_eeconfig_read_debug(debug_config_t *debug_config) {
-    debug_config->raw = fs_read_u8(EECONFIG_DEBUG);
+    *debug_config = nvm_eeconfig_cache_get()->debug;
 }
 void nvm_eeconfig_update_debug(const debug_config_t *debug_config) {
-    fs_update_u8(EECONFIG_DEBUG, debug_config->raw);
+    nvm_eeconfig_cache_update(NVM_EECONFIG_DEBUG, debug_config, sizeof(debug_config_t));
 }
 
 layer_state_t nvm_eeconfig_read_default_layer(void) {
-    layer_state_t layer_state = 0;
-    fs_read_block(EECONFIG_DEFAULT_LAYER, &layer_state, sizeof(layer_state_t));
-    return layer_state;
+    return nvm_eeconfig_cache_get()->default_layer;
 }
 
 void nvm_eeconfig_update_default_layer(layer_state_t val) {
-    fs_update_block(EECONFIG_DEFAULT_LAYER, &val, sizeof(layer_state_t));
+    nvm_eeconfig_cache_update(NVM_EECONFIG_DEFAULT_LAYER, &val, sizeof(layer_state_t));
 }
 
 void nvm_eeconfig_read_keymap(keymap_config_t *keymap_config) {
-    fs_read_block(EECONFIG_KEYMAP, keymap_config, sizeof(keymap_config_t));
+    *keymap_config = nvm_eeconfig_cache_get()->keymap;
 }
 void nvm_eeconfig_update_keymap(const keymap_config_t *keymap_config) {
-    fs_update_block(EECONFIG_KEYMAP, keymap_config, sizeof(keymap_config_t));
+    nvm_eeconfig_cache_update(NVM_EECONFIG_KEYMAP, keymap_config, sizeof(keymap_config_t));
 }
 
 #ifdef AUDIO_ENABLE
-static const char EECONFIG_AUDIO[] = "ee/audio";
-void              nvm_eeconfig_read_audio(audio_config_t *audio_config) {
-    fs_read_block(EECONFIG_AUDIO, audio_config, sizeof(audio_config_t));
+void nvm_eeconfig_read_audio(audio_config_t *audio_config) {
+    *audio_config = nvm_eeconfig_cache_get()->audio;
 }
 void nvm_eeconfig_update_audio(const audio_config_t *audio_config) {
-    fs_update_block(EECONFIG_AUDIO, audio_config, sizeof(audio_config_t));
+    nvm_eeconfig_cache_update(NVM_EECONFIG_AUDIO, audio_config, sizeof(audio_config_t));
 }
 #endif // AUDIO_ENABLE
 
 #ifdef UNICODE_COMMON_ENABLE
-static const char EECONFIG_UNICODEMODE[] = "ee/unicodemode";
-void              nvm_eeconfig_read_unicode_mode(unicode_config_t *unicode_config) {
-    fs_read_block(EECONFIG_UNICODEMODE, unicode_config, sizeof(unicode_config_t));
+void nvm_eeconfig_read_unicode_mode(unicode_config_t *unicode_config) {
+    *unicode_config = nvm_eeconfig_cache_get()->unicodemode;
 }
 void nvm_eeconfig_update_unicode_mode(const unicode_config_t *unicode_config) {
-    fs_update_block(EECONFIG_UNICODEMODE, unicode_config, sizeof(unicode_config_t));
+    nvm_eeconfig_cache_update(NVM_EECONFIG_UNICODEMODE, unicode_config, sizeof(unicode_config_t));
 }
 #endif // UNICODE_COMMON_ENABLE
 
 #ifdef BACKLIGHT_ENABLE
-static const char EECONFIG_BACKLIGHT[] = "ee/backlight";
-void              nvm_eeconfig_read_backlight(backlight_config_t *backlight_config) {
-    fs_read_block(EECONFIG_BACKLIGHT, backlight_config, sizeof(backlight_config_t));
+void nvm_eeconfig_read_backlight(backlight_config_t *backlight_config) {
+    *backlight_config = nvm_eeconfig_cache_get()->backlight;
 }
 void nvm_eeconfig_update_backlight(const backlight_config_t *backlight_config) {
-    fs_update_block(EECONFIG_BACKLIGHT, backlight_config, sizeof(backlight_config_t));
+    nvm_eeconfig_cache_update(NVM_EECONFIG_BACKLIGHT, backlight_config, sizeof(backlight_config_t));
 }
 #endif // BACKLIGHT_ENABLE
 
 #ifdef STENO_ENABLE
-static const char EECONFIG_STENOMODE[] = "ee/stenomode";
-uint8_t           nvm_eeconfig_read_steno_mode(void) {
-    return fs_read_u8(EECONFIG_STENOMODE);
+uint8_t nvm_eeconfig_read_steno_mode(void) {
+    return nvm_eeconfig_cache_get()->stenomode;
 }
 void nvm_eeconfig_update_steno_mode(uint8_t val) {
-    fs_update_u8(EECONFIG_STENOMODE, val);
+    nvm_eeconfig_cache_update_u8(NVM_EECONFIG_STENOMODE, val);
 }
 #endif // STENO_ENABLE
 
 #ifdef RGB_MATRIX_ENABLE
-static const char EECONFIG_RGB_MATRIX[] = "ee/rgb_matrix";
-void              nvm_eeconfig_read_rgb_matrix(rgb_config_t *rgb_matrix_config) {
-    fs_read_block(EECONFIG_RGB_MATRIX, rgb_matrix_config, sizeof(rgb_config_t));
+void nvm_eeconfig_read_rgb_matrix(rgb_config_t *rgb_matrix_config) {
+    *rgb_matrix_config = nvm_eeconfig_cache_get()->rgb_matrix;
 }
 void nvm_eeconfig_update_rgb_matrix(const rgb_config_t *rgb_matrix_config) {
-    fs_update_block(EECONFIG_RGB_MATRIX, rgb_matrix_config, sizeof(rgb_config_t));
+    nvm_eeconfig_cache_update(NVM_EECONFIG_RGB_MATRIX, rgb_matrix_config, sizeof(rgb_config_t));
 }
 #endif // RGB_MATRIX_ENABLE
 
 #ifdef LED_MATRIX_ENABLE
-static const char EECONFIG_LED_MATRIX[] = "ee/led_matrix";
-void              nvm_eeconfig_read_led_matrix(led_eeconfig_t *led_matrix_config) {
-    fs_read_block(EECONFIG_LED_MATRIX, led_matrix_config, sizeof(led_eeconfig_t));
+void nvm_eeconfig_read_led_matrix(led_eeconfig_t *led_matrix_config) {
+    *led_matrix_config = nvm_eeconfig_cache_get()->led_matrix;
 }
 void nvm_eeconfig_update_led_matrix(const led_eeconfig_t *led_matrix_config) {
-    fs_update_block(EECONFIG_LED_MATRIX, led_matrix_config, sizeof(led_eeconfig_t));
+    nvm_eeconfig_cache_update(NVM_EECONFIG_LED_MATRIX, led_matrix_config, sizeof(led_eeconfig_t));
 }
 #endif // LED_MATRIX_ENABLE
 
 #ifdef RGBLIGHT_ENABLE
-static const char EECONFIG_RGBLIGHT[] = "ee/rgblight";
-void              nvm_eeconfig_read_rgblight(rgblight_config_t *rgblight_config) {
-    fs_read_block(EECONFIG_RGBLIGHT, rgblight_config, sizeof(rgblight_config_t));
+void nvm_eeconfig_read_rgblight(rgblight_config_t *rgblight_config) {
+    *rgblight_config = nvm_eeconfig_cache_get()->rgblight;
 }
 void nvm_eeconfig_update_rgblight(const rgblight_config_t *rgblight_config) {
-    fs_update_block(EECONFIG_RGBLIGHT, rgblight_config, sizeof(rgblight_config_t));
+    nvm_eeconfig_cache_update(NVM_EECONFIG_RGBLIGHT, rgblight_config, sizeof(rgblight_config_t));
 }
 #endif // RGBLIGHT_ENABLE
 
 #if (EECONFIG_KB_DATA_SIZE) == 0
 uint32_t nvm_eeconfig_read_kb(void) {
-    return fs_read_u32(EECONFIG_KEYBOARD);
+    return nvm_eeconfig_cache_get()->keyboard;
 }
 void nvm_eeconfig_update_kb(uint32_t val) {
-    fs_update_u32(EECONFIG_KEYBOARD, val);
+    nvm_eeconfig_cache_update_u32(NVM_EECONFIG_KEYBOARD, val);
 }
 #endif // (EECONFIG_KB_DATA_SIZE) == 0
 
 #if (EECONFIG_USER_DATA_SIZE) == 0
 uint32_t nvm_eeconfig_read_user(void) {
-    return fs_read_u32(EECONFIG_USER);
+    return nvm_eeconfig_cache_get()->user;
 }
 void nvm_eeconfig_update_user(uint32_t val) {
-    fs_update_u32(EECONFIG_USER, val);
+    nvm_eeconfig_cache_update_u32(NVM_EECONFIG_USER, val);
 }
 #endif // (EECONFIG_USER_DATA_SIZE) == 0
 
 #ifdef HAPTIC_ENABLE
-static const char EECONFIG_HAPTIC[] = "ee/haptic";
-void              nvm_eeconfig_read_haptic(haptic_config_t *haptic_config) {
-    fs_read_block(EECONFIG_HAPTIC, haptic_config, sizeof(haptic_config_t));
+void nvm_eeconfig_read_haptic(haptic_config_t *haptic_config) {
+    *haptic_config = nvm_eeconfig_cache_get()->haptic;
 }
 void nvm_eeconfig_update_haptic(const haptic_config_t *haptic_config) {
-    fs_update_block(EECONFIG_HAPTIC, haptic_config, sizeof(haptic_config_t));
+    nvm_eeconfig_cache_update(NVM_EECONFIG_HAPTIC, haptic_config, sizeof(haptic_config_t));
 }
 #endif // HAPTIC_ENABLE
 
 bool nvm_eeconfig_read_handedness(void) {
-    return !!fs_read_u8(EECONFIG_HANDEDNESS);
+    return !!nvm_eeconfig_cache_get()->handedness;
 }
 void nvm_eeconfig_update_handedness(bool val) {
-    fs_update_u8(EECONFIG_HANDEDNESS, !!val);
+    nvm_eeconfig_cache_update_u8(NVM_EECONFIG_HANDEDNESS, !!val);
 }
 
 uint32_t nvm_eeconfig_read_keymap_hash(void) {
-    return fs_read_u32(EECONFIG_KEYMAP_HASH);
+    return nvm_eeconfig_cache_get()->keymap_hash;
 }
 void nvm_eeconfig_update_keymap_hash(uint32_t val) {
-    fs_update_u32(EECONFIG_KEYMAP_HASH, val);
+    nvm_eeconfig_cache_update_u32(NVM_EECONFIG_KEYMAP_HASH, val);
 }
 
 #if (EECONFIG_KB_DATA_SIZE) > 0
 static const char EECONFIG_KB_DATABLOCK[] = "ee/kb_datablock";
 
 bool nvm_eeconfig_is_kb_datablock_valid(void) {
-    return fs_read_u32(EECONFIG_KEYBOARD) == (EECONFIG_KB_DATA_VERSION);
+    return nvm_eeconfig_cache_get()->keyboard == (EECONFIG_KB_DATA_VERSION);
 }
 
 uint32_t nvm_eeconfig_read_kb_datablock(void *data, uint32_t offset, uint32_t length) {
@@ -326,7 +515,7 @@ uint32_t nvm_eeconfig_read_kb_datablock(void *data, uint32_t offset, uint32_t le
 }
 
 uint32_t nvm_eeconfig_update_kb_datablock(const void *data, uint32_t offset, uint32_t length) {
-    fs_update_u32(EECONFIG_KEYBOARD, (EECONFIG_KB_DATA_VERSION));
+    nvm_eeconfig_cache_update_u32(NVM_EECONFIG_KEYBOARD, (EECONFIG_KB_DATA_VERSION));
 
     fs_fd_t fd = fs_open(EECONFIG_KB_DATABLOCK, FS_WRITE);
     if (fd == INVALID_FILESYSTEM_FD) {
@@ -342,7 +531,7 @@ uint32_t nvm_eeconfig_update_kb_datablock(const void *data, uint32_t offset, uin
 }
 
 void nvm_eeconfig_init_kb_datablock(void) {
-    fs_update_u32(EECONFIG_KEYBOARD, (EECONFIG_KB_DATA_VERSION));
+    nvm_eeconfig_cache_update_u32(NVM_EECONFIG_KEYBOARD, (EECONFIG_KB_DATA_VERSION));
     fs_delete(EECONFIG_KB_DATABLOCK);
     fs_fd_t fd = fs_open(EECONFIG_KB_DATABLOCK, FS_WRITE);
     if (fd == INVALID_FILESYSTEM_FD) {
@@ -359,7 +548,7 @@ void nvm_eeconfig_init_kb_datablock(void) {
 static const char EECONFIG_USER_DATABLOCK[] = "ee/user_datablock";
 
 bool nvm_eeconfig_is_user_datablock_valid(void) {
-    return fs_read_u32(EECONFIG_USER) == (EECONFIG_USER_DATA_VERSION);
+    return nvm_eeconfig_cache_get()->user == (EECONFIG_USER_DATA_VERSION);
 }
 
 uint32_t nvm_eeconfig_read_user_datablock(void *data, uint32_t offset, uint32_t length) {
@@ -382,7 +571,7 @@ uint32_t nvm_eeconfig_read_user_datablock(void *data, uint32_t offset, uint32_t
 }
 
 uint32_t nvm_eeconfig_update_user_datablock(const void *data, uint32_t offset, uint32_t length) {
-    fs_update_u32(EECONFIG_USER, (EECONFIG_USER_DATA_VERSION));
+    nvm_eeconfig_cache_update_u32(NVM_EECONFIG_USER, (EECONFIG_USER_DATA_VERSION));
 
     fs_fd_t fd = fs_open(EECONFIG_USER_DATABLOCK, FS_WRITE);
     if (fd == INVALID_FILESYSTEM_FD) {
@@ -398,7 +587,7 @@ uint32_t nvm_eeconfig_update_user_datablock(const void *data, uint32_t offset, u
 }
 
 void nvm_eeconfig_init_user_datablock(void) {
-    fs_update_u32(EECONFIG_USER, (EECONFIG_USER_DATA_VERSION));
+    nvm_eeconfig_cache_update_u32(NVM_EECONFIG_USER, (EECONFIG_USER_DATA_VERSION));
     fs_delete(EECONFIG_USER_DATABLOCK);
     fs_fd_t fd = fs_open(EECONFIG_USER_DATABLOCK, FS_WRITE);
     if (fd == INVALID_FILESYSTEM_FD) {
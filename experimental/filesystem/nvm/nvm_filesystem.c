@@ -0,0 +1,445 @@
+// Copyright 2022-2026 Nick Brassel (@tzarc)
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <stddef.h>
+#include <string.h>
+#include "filesystem.h"
+#include "nvm_filesystem.h"
+
+// Journaled block storage, much like classic QMK wear-leveling, as littlefs doesn't like writes mid-way through a file:
+// - The first write puts down a header followed by the full image of the data, unless the data is too large to ever be
+//   journaled, in which case the image is written on its own
+// - Subsequent writes of the same size append (offset+length) records, each followed by the changed bytes
+// - Records may also start at the end of the live image, extending it -- this is how fs_append_block() grows a file
+// - Once the records reach a threshold, the file is rewritten with the live copy of the data instead of playing back the log
+// Files without the journal header are treated as a plain image, so data written by earlier firmware still loads, and
+// fs_append_block() extends them in place. The header carries a 32-bit magic and a check over itself, so a plain image
+// is vanishingly unlikely to be mistaken for one, and files shorter than the header never are.
+
+// Configurable: Largest block which will be journaled, larger blocks are always rewritten in full
+#ifndef FILESYSTEM_JOURNAL_MAX_BLOCK_SIZE
+#    define FILESYSTEM_JOURNAL_MAX_BLOCK_SIZE 256
+#endif
+
+// Configurable: Number of bytes of journal records allowed to accumulate before the file is compacted
+#ifndef FILESYSTEM_JOURNAL_COMPACT_THRESHOLD
+#    define FILESYSTEM_JOURNAL_COMPACT_THRESHOLD 256
+#endif
+
+_Static_assert((FILESYSTEM_JOURNAL_MAX_BLOCK_SIZE) <= UINT16_MAX, "FILESYSTEM_JOURNAL_MAX_BLOCK_SIZE must fit the journal header's image size");
+
+#define FS_JOURNAL_MAGIC 0x4A4C5346 // "FSLJ"
+#define MAX_STACK_BUFFER_SIZE 32
+
+typedef struct __attribute__((packed)) fs_journal_header_t {
+    uint32_t magic;      // FS_JOURNAL_MAGIC
+    uint16_t image_size; // Size of the full image following the header
+    uint16_t check;      // fs_journal_header_check() of the fields above
+} fs_journal_header_t;
+_Static_assert(sizeof(fs_journal_header_t) == 8, "fs_journal_header_t size is not 8 bytes");
+
+typedef struct __attribute__((packed)) fs_journal_record_t {
+    uint16_t offset; // Offset within the image
+    uint16_t length; // Number of changed bytes following this record
+} fs_journal_record_t;
+_Static_assert(sizeof(fs_journal_record_t) == 4, "fs_journal_record_t size is not 4 bytes");
+
+// Live copy of the data, used to work out which byte ranges have changed
+static uint8_t fs_journal_live[FILESYSTEM_JOURNAL_MAX_BLOCK_SIZE];
+
+static uint16_t fs_journal_header_check(const fs_journal_header_t *header) {
+    return (uint16_t)fs_crc32(header, offsetof(fs_journal_header_t, check));
+}
+
+static fs_fd_t fs_journal_open(const char *filename, fs_journal_info_t *info) {
+    fs_fd_t fd = fs_open(filename, FS_READ);
+    if (fd == INVALID_FILESYSTEM_FD) {
+        return INVALID_FILESYSTEM_FD;
+    }
+
+    fs_offset_t file_size = fs_seek(fd, 0, FS_SEEK_END);
+    if (file_size < 0 || fs_seek(fd, 0, FS_SEEK_SET) != 0) {
+        fs_close(fd);
+        return INVALID_FILESYSTEM_FD;
+    }
+
+    fs_journal_header_t header;
+    info->file_size = file_size;
+    if (file_size >= (fs_offset_t)sizeof(header) && fs_read(fd, &header, sizeof(header)) == sizeof(header) && header.magic == FS_JOURNAL_MAGIC && header.check == fs_journal_header_check(&header) && (fs_offset_t)(sizeof(header) + header.image_size) <= file_size) {
+        info->image_start = sizeof(header);
+        info->image_size  = header.image_size;
+    } else {
+        // No journal header, the whole file is the image
+        info->image_start = 0;
+        info->image_size  = file_size;
+    }
+    info->size        = info->image_size;
+    info->journal_end = info->image_start + info->image_size;
+
+    // Walk the journal records to find the size of the live image, and where the valid records end
+    if (info->image_start > 0) {
+        fs_size_t pos = info->journal_end;
+        while (pos + (fs_size_t)sizeof(fs_journal_record_t) <= file_size) {
+            fs_journal_record_t record;
+            if (fs_seek(fd, pos, FS_SEEK_SET) < 0 || fs_read(fd, &record, sizeof(record)) != sizeof(record)) {
+                break;
+            }
+
+            // Stop at a torn or corrupt record, anything after it can't be trusted
+            if (record.length == 0 || record.offset > info->size || record.offset + record.length > UINT16_MAX || pos + (fs_size_t)sizeof(record) + record.length > file_size) {
+                fs_dprintf("ignoring journal from offset %d\n", (int)pos);
+                break;
+            }
+
+            pos += sizeof(record) + record.length;
+            if (record.offset + record.length > info->size) {
+                info->size = record.offset + record.length;
+            }
+        }
+        info->journal_end = pos;
+    }
+    return fd;
+}
+
+static fs_size_t fs_journal_read_window(fs_fd_t fd, const fs_journal_info_t *info, size_t offset, void *data, size_t length) {
+    if (offset >= (size_t)info->size) {
+        return 0;
+    }
+    if (length > (size_t)info->size - offset) {
+        length = info->size - offset;
+    }
+
+    // Start with the base image...
+    if (offset < (size_t)info->image_size) {
+        size_t base_length = (length < (size_t)info->image_size - offset) ? length : ((size_t)info->image_size - offset);
+        if (fs_seek(fd, info->image_start + offset, FS_SEEK_SET) < 0 || fs_read(fd, data, base_length) != (fs_size_t)base_length) {
+            return -1;
+        }
+    }
+
+    // ...then play back any journal records overlapping the requested window, which also covers anything past the base image
+    fs_size_t pos = info->image_start + info->image_size;
+    while (pos < info->journal_end) {
+        fs_journal_record_t record;
+        if (fs_seek(fd, pos, FS_SEEK_SET) < 0 || fs_read(fd, &record, sizeof(record)) != sizeof(record)) {
+            return -1;
+        }
+        pos += sizeof(record);
+
+        size_t start = record.offset > offset ? record.offset : offset;
+        size_t end   = (record.offset + record.length) < (offset + length) ? (record.offset + record.length) : (offset + length);
+        if (start < end) {
+            if (fs_seek(fd, pos + (start - record.offset), FS_SEEK_SET) < 0 || fs_read(fd, (uint8_t *)data + (start - offset), end - start) != (fs_size_t)(end - start)) {
+                return -1;
+            }
+        }
+        pos += record.length;
+    }
+
+    return length;
+}
+
+static bool fs_journal_compare_window(fs_fd_t fd, const fs_journal_info_t *info, size_t offset, const void *data, size_t size) {
+    uint8_t        stack_buffer[MAX_STACK_BUFFER_SIZE];
+    size_t         done     = 0;
+    const uint8_t *data_ptr = (const uint8_t *)data;
+
+    while (done < size) {
+        size_t chunk_size = (size - done) > MAX_STACK_BUFFER_SIZE ? MAX_STACK_BUFFER_SIZE : (size - done);
+        if (fs_journal_read_window(fd, info, offset + done, stack_buffer, chunk_size) != (fs_size_t)chunk_size) {
+            return false; // Read error, assume different
+        }
+        if (memcmp(stack_buffer, data_ptr + done, chunk_size) != 0) {
+            return false; // Data differs
+        }
+        done += chunk_size;
+    }
+    return true; // All chunks match
+}
+
+static bool fs_journal_compare(fs_fd_t fd, const fs_journal_info_t *info, const void *data, size_t size) {
+    if ((size_t)info->size != size) {
+        return false; // Size differs
+    }
+    return fs_journal_compare_window(fd, info, 0, data, size);
+}
+
+static size_t fs_journal_next_range(const uint8_t *live, const uint8_t *data, size_t size, size_t pos, size_t *length) {
+    // Skip over anything unchanged
+    while (pos < size && live[pos] == data[pos]) {
+        ++pos;
+    }
+
+    // Extend the range until the unchanged gap would cost more than starting a new record
+    size_t end  = pos;
+    size_t scan = pos;
+    while (scan < size) {
+        if (live[scan] != data[scan]) {
+            end = ++scan;
+        } else if (scan - end >= sizeof(fs_journal_record_t)) {
+            break;
+        } else {
+            ++scan;
+        }
+    }
+
+    *length = end - pos;
+    return pos;
+}
+
+static bool fs_journal_append(const char *filename, const fs_journal_info_t *info, const uint8_t *live, const uint8_t *data, size_t size) {
+    // Anything after a torn record would be ignored on playback, so compact instead
+    if (info->journal_end != info->file_size) {
+        return false;
+    }
+
+    // Work out how much the journal would grow, and compact instead if it's getting too large
+    size_t journal_size = info->journal_end - (info->image_start + info->image_size);
+    size_t length;
+    for (size_t pos = fs_journal_next_range(live, data, size, 0, &length); pos < size; pos = fs_journal_next_range(live, data, size, pos + length, &length)) {
+        journal_size += sizeof(fs_journal_record_t) + length;
+    }
+    if (journal_size > FILESYSTEM_JOURNAL_COMPACT_THRESHOLD) {
+        fs_dprintf("journal full, compacting\n");
+        return false;
+    }
+
+    fs_fd_t fd = fs_open(filename, FS_WRITE);
+    if (fd == INVALID_FILESYSTEM_FD) {
+        return false;
+    }
+    if (fs_seek(fd, 0, FS_SEEK_END) != info->file_size) {
+        fs_close(fd);
+        return false;
+    }
+
+    bool ok = true;
+    for (size_t pos = fs_journal_next_range(live, data, size, 0, &length); ok && pos < size; pos = fs_journal_next_range(live, data, size, pos + length, &length)) {
+        fs_journal_record_t record = {.offset = pos, .length = length};
+        ok                         = fs_write(fd, &record, sizeof(record)) == sizeof(record) && fs_write(fd, data + pos, length) == (fs_size_t)length;
+    }
+    fs_close(fd);
+
+    if (!ok) {
+        // A partially-written record is discarded on playback, so a full rewrite recovers from here
+        fs_dprintf("did not write correct number of bytes\n");
+    }
+    return ok;
+}
+
+static void fs_journal_write_image(const char *filename, const void *data, size_t size) {
+    fs_fd_t fd = fs_open(filename, FS_WRITE | FS_TRUNCATE);
+    if (fd == INVALID_FILESYSTEM_FD) {
+        fs_dprintf("could not open file\n");
+        return;
+    }
+    // Blocks too large to journal are never appended to as records, so the header would only cost space -- and the
+    // header's image size could not describe them anyway
+    bool ok = true;
+    if (size <= FILESYSTEM_JOURNAL_MAX_BLOCK_SIZE) {
+        fs_journal_header_t header = {.magic = FS_JOURNAL_MAGIC, .image_size = size};
+        header.check               = fs_journal_header_check(&header);
+        ok                         = fs_write(fd, &header, sizeof(header)) == sizeof(header);
+    }
+    if (!ok || fs_write(fd, data, size) != (fs_size_t)size) {
+        fs_dprintf("did not write correct number of bytes\n");
+    }
+    fs_close(fd);
+}
+
+size_t fs_read_block_upto(const char *filename, void *data, size_t max_size) {
+    fs_journal_info_t info;
+    fs_fd_t           fd = fs_journal_open(filename, &info);
+    if (fd == INVALID_FILESYSTEM_FD) {
+        fs_dprintf("could not open file\n");
+        return 0;
+    }
+    fs_size_t read_bytes = fs_journal_read_window(fd, &info, 0, data, max_size);
+    fs_close(fd);
+    if (read_bytes < 0) {
+        fs_dprintf("could not read file\n");
+        return 0;
+    }
+    fs_hexdump("read", filename, data, read_bytes);
+    return read_bytes;
+}
+
+size_t fs_read_block(const char *filename, void *data, size_t size) {
+    fs_journal_info_t info;
+    fs_fd_t           fd = fs_journal_open(filename, &info);
+    if (fd == INVALID_FILESYSTEM_FD) {
+        fs_dprintf("could not open file\n");
+        memset(data, 0, size);
+        return 0;
+    }
+    fs_size_t read_bytes = fs_journal_read_window(fd, &info, 0, data, size);
+    fs_close(fd);
+    if (read_bytes != (fs_size_t)size) {
+        fs_dprintf("did not read correct number of bytes\n");
+        memset(data, 0, size);
+        return read_bytes < 0 ? 0 : read_bytes;
+    }
+    fs_hexdump("read", filename, data, size);
+    return size;
+}
+
+static bool fs_append_block_nolock(const char *filename, const void *data, size_t size) {
+    fs_hexdump("append", filename, data, size);
+
+    // Journaled files are extended with a record, plain images by writing straight after them; anything with a torn
+    // record at the end needs rewriting by the caller
+    fs_journal_info_t info;
+    fs_fd_t           read_fd = fs_journal_open(filename, &info);
+    if (read_fd == INVALID_FILESYSTEM_FD) {
+        return false;
+    }
+    fs_close(read_fd);
+    bool journaled = info.image_start > 0;
+    if (info.journal_end != info.file_size || size == 0 || (journaled && info.size + size > UINT16_MAX)) {
+        return false;
+    }
+
+    fs_fd_t fd = fs_open(filename, FS_WRITE);
+    if (fd == INVALID_FILESYSTEM_FD) {
+        return false;
+    }
+    size_t              offset = info.size;
+    fs_journal_record_t record = {.offset = offset, .length = size};
+    bool                ok     = fs_seek(fd, 0, FS_SEEK_END) == info.file_size && (!journaled || fs_write(fd, &record, sizeof(record)) == sizeof(record)) && fs_write(fd, data, size) == (fs_size_t)size;
+    fs_close(fd);
+    if (!ok) {
+        fs_dprintf("did not write correct number of bytes\n");
+        return false;
+    }
+
+#if defined(FILESYSTEM_VERIFY_WRITES)
+    // Verify write integrity for data safety
+    fs_fd_t verify_fd = fs_journal_open(filename, &info);
+    if (verify_fd != INVALID_FILESYSTEM_FD) {
+        if ((size_t)info.size != offset + size || !fs_journal_compare_window(verify_fd, &info, offset, data, size)) {
+            fs_dprintf("readback mismatch!\n");
+        }
+        fs_close(verify_fd);
+    }
+#endif // FILESYSTEM_VERIFY_WRITES
+    return true;
+}
+
+bool fs_append_block(const char *filename, const void *data, size_t size) {
+    // Hold the lock throughout, so that a writer on another thread can't interleave with the read-modify-write
+    fs_batch_begin();
+    bool ok = fs_append_block_nolock(filename, data, size);
+    fs_batch_commit();
+    return ok;
+}
+
+bool fs_block_reader_open(fs_block_reader_t *reader, const char *filename) {
+    reader->fd = fs_journal_open(filename, &reader->info);
+    return reader->fd != INVALID_FILESYSTEM_FD;
+}
+
+size_t fs_block_reader_size(const fs_block_reader_t *reader) {
+    return reader->info.size;
+}
+
+fs_size_t fs_block_reader_read(fs_block_reader_t *reader, size_t offset, void *data, size_t length) {
+    return fs_journal_read_window(reader->fd, &reader->info, offset, data, length);
+}
+
+fs_size_t fs_block_reader_stream(fs_block_reader_t *reader, size_t offset, size_t record_size, fs_block_record_cb_t callback, void *user_data) {
+    uint8_t stack_buffer[MAX_STACK_BUFFER_SIZE] __attribute__((aligned(4)));
+    if (record_size == 0 || record_size > sizeof(stack_buffer)) {
+        return -1;
+    }
+
+    // Read as many whole records as fit in the buffer at a time, and hand each to the callback in place
+    size_t    chunk_size = (sizeof(stack_buffer) / record_size) * record_size;
+    fs_size_t count      = 0;
+    while (offset + record_size <= (size_t)reader->info.size) {
+        fs_size_t read_bytes = fs_journal_read_window(reader->fd, &reader->info, offset, stack_buffer, chunk_size);
+        if (read_bytes < (fs_size_t)record_size) {
+            return read_bytes < 0 ? -1 : count;
+        }
+        for (size_t pos = 0; pos + record_size <= (size_t)read_bytes; pos += record_size) {
+            ++count;
+            if (!callback(stack_buffer + pos, offset + pos, user_data)) {
+                return count;
+            }
+        }
+        offset += (read_bytes / record_size) * record_size;
+    }
+    return count;
+}
+
+void fs_block_reader_close(fs_block_reader_t *reader) {
+    if (reader->fd != INVALID_FILESYSTEM_FD) {
+        fs_close(reader->fd);
+        reader->fd = INVALID_FILESYSTEM_FD;
+    }
+}
+
+static bool fs_journal_update(const char *filename, const void *data, size_t size) {
+    // Check if data has changed, and if so whether the changes can be appended to the journal
+    fs_journal_info_t info;
+    fs_fd_t           read_fd = fs_journal_open(filename, &info);
+    if (read_fd != INVALID_FILESYSTEM_FD) {
+        bool journaled = info.image_start > 0 && (size_t)info.size == size && size <= sizeof(fs_journal_live);
+        if (journaled) {
+            journaled = fs_journal_read_window(read_fd, &info, 0, fs_journal_live, size) == (fs_size_t)size;
+        }
+        bool unchanged = journaled ? (memcmp(fs_journal_live, data, size) == 0) : fs_journal_compare(read_fd, &info, data, size);
+        fs_close(read_fd);
+
+        if (unchanged) {
+            fs_dprintf("no change, skipping write\n");
+            return false;
+        }
+        if (journaled && fs_journal_append(filename, &info, fs_journal_live, (const uint8_t *)data, size)) {
+            return true;
+        }
+    }
+
+    fs_journal_write_image(filename, data, size);
+    return true;
+}
+
+static void fs_update_block_nolock(const char *filename, const void *data, size_t size) {
+    fs_hexdump("save", filename, data, size);
+
+    if (!fs_journal_update(filename, data, size)) {
+        return;
+    }
+
+#if defined(FILESYSTEM_VERIFY_WRITES)
+    // Verify write integrity for data safety
+    fs_journal_info_t info;
+    fs_fd_t           verify_fd = fs_journal_open(filename, &info);
+    if (verify_fd != INVALID_FILESYSTEM_FD) {
+        if (!fs_journal_compare(verify_fd, &info, data, size)) {
+            fs_dprintf("readback mismatch!\n");
+        }
+        fs_close(verify_fd);
+    }
+#endif // FILESYSTEM_VERIFY_WRITES
+}
+
+void fs_update_block(const char *filename, const void *data, size_t size) {
+    // Hold the lock throughout, as the journal's live copy is shared between all callers
+    fs_batch_begin();
+    fs_update_block_nolock(filename, data, size);
+    fs_batch_commit();
+}
+
+uint32_t fs_crc32(const void *data, size_t size) {
+    // Nibble-wide table, trading a little speed for a lot less flash than the usual 1kB table
+    static const uint32_t crc32_table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C, //
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C, //
+    };
+    const uint8_t *p   = (const uint8_t *)data;
+    uint32_t       crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < size; ++i) {
+        crc = (crc >> 4) ^ crc32_table[(crc ^ p[i]) & 0x0F];
+        crc = (crc >> 4) ^ crc32_table[(crc ^ (p[i] >> 4)) & 0x0F];
+    }
+    return ~crc;
+}
@@ -1,7 +1,71 @@
 // Copyright 2022-2026 Nick Brassel (@tzarc)
 // SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include "filesystem.h"
+
+/**
+ * @brief Location of the live image within a block file written by fs_update_block()
+ */
+typedef struct fs_journal_info_t {
+    fs_size_t file_size;   /**< Total size of the file */
+    fs_size_t image_start; /**< Offset of the base image within the file, 0 if there's no journal header */
+    fs_size_t image_size;  /**< Size of the base image */
+    fs_size_t size;        /**< Size of the live image, including any growth from journal records */
+    fs_size_t journal_end; /**< Offset of the end of the last valid journal record */
+} fs_journal_info_t;
+
+/**
+ * @brief Reader for partial or streamed reads of a block file, without staging the whole image in RAM
+ */
+typedef struct fs_block_reader_t {
+    fs_fd_t           fd;   /**< Open file descriptor */
+    fs_journal_info_t info; /**< Location of the live image */
+} fs_block_reader_t;
+
+/**
+ * @brief Callback invoked for each fixed-size record by fs_block_reader_stream()
+ *
+ * @param record Pointer to the record, aligned to 4 bytes and only valid for the duration of the call
+ * @param offset Offset of the record within the image
+ * @param user_data User data passed to fs_block_reader_stream()
+ * @return true to continue streaming, false to stop
+ */
+typedef bool (*fs_block_record_cb_t)(const void *record, size_t offset, void *user_data);
 
 size_t fs_read_block(const char *filename, void *data, size_t size);
+size_t fs_read_block_upto(const char *filename, void *data, size_t max_size);
 void   fs_update_block(const char *filename, const void *data, size_t size);
+bool   fs_append_block(const char *filename, const void *data, size_t size);
+
+bool      fs_block_reader_open(fs_block_reader_t *reader, const char *filename);
+size_t    fs_block_reader_size(const fs_block_reader_t *reader);
+fs_size_t fs_block_reader_read(fs_block_reader_t *reader, size_t offset, void *data, size_t length);
+fs_size_t fs_block_reader_stream(fs_block_reader_t *reader, size_t offset, size_t record_size, fs_block_record_cb_t callback, void *user_data);
+void      fs_block_reader_close(fs_block_reader_t *reader);
+
+uint32_t fs_crc32(const void *data, size_t size);
+
+void     nvm_save_init(void);
+void     nvm_save_stop(void);
+void     nvm_save_barrier(void);
+void     nvm_save_yield(void);
+uint32_t nvm_save_failure_count(void);
+bool     nvm_save_update(const char *filename, const void *data, size_t size);
+bool     nvm_save_append(const char *filename, const void *data, size_t size);
+bool     nvm_save_delete(const char *filename);
+bool     nvm_save_pre_erase(uint16_t max_blocks);
+
+void nvm_filesystem_mark_dirty(void);
+
+void nvm_eeconfig_flush(void);
+
+void nvm_dynamic_keymap_load(void);
+void nvm_dynamic_keymap_save(void);
+void nvm_dynamic_keymap_macro_load(void);
+void nvm_dynamic_keymap_macro_save(void);
+void nvm_dynamic_encodermap_load(void);
+void nvm_dynamic_encodermap_save(void);
@@ -0,0 +1,155 @@
+// Copyright 2022-2026 Nick Brassel (@tzarc)
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <stdbool.h>
+#include "timer.h"
+#include "keyboard.h"
+#include "filesystem.h"
+#include "fs_profile.h"
+#include "nvm_filesystem.h"
+#include "community_modules.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Write-back
+
+// Saves are debounced, so that a burst of edits -- such as a VIA keymap upload -- is persisted once it's finished
+// rather than repeatedly part-way through.
+
+// Configurable: Time without further edits before pending changes are saved
+#ifndef FILESYSTEM_SAVE_QUIET_MS
+#    define FILESYSTEM_SAVE_QUIET_MS 500
+#endif
+
+// Configurable: Longest time changes may remain unsaved while edits keep arriving; also the interval of the periodic
+// sweep, which picks up anything left dirty by a save which couldn't complete
+#ifndef FILESYSTEM_SAVE_MAX_DELAY_MS
+#    define FILESYSTEM_SAVE_MAX_DELAY_MS 5000
+#endif
+
+static bool     nvm_filesystem_dirty      = false;
+static uint32_t nvm_filesystem_first_edit = 0;
+static uint32_t nvm_filesystem_last_edit  = 0;
+static uint32_t nvm_filesystem_last_flush = 0;
+
+void nvm_filesystem_mark_dirty(void) {
+    uint32_t now = timer_read32();
+    if (!nvm_filesystem_dirty) {
+        nvm_filesystem_dirty      = true;
+        nvm_filesystem_first_edit = now;
+    }
+    nvm_filesystem_last_edit = now;
+}
+
+static void nvm_filesystem_flush(void) {
+    nvm_filesystem_dirty      = false;
+    nvm_filesystem_last_flush = timer_read32();
+#ifndef FILESYSTEM_ASYNC_SAVE
+    // Hold the lock and mount across all the saves, rather than per file
+    fs_batch_begin();
+#endif // FILESYSTEM_ASYNC_SAVE
+#ifdef DYNAMIC_KEYMAP_ENABLE
+    nvm_dynamic_keymap_save();
+    nvm_dynamic_keymap_macro_save();
+#    if defined(ENCODER_ENABLE) && defined(ENCODER_MAP_ENABLE)
+    nvm_dynamic_encodermap_save();
+#    endif // defined(ENCODER_ENABLE) && defined(ENCODER_MAP_ENABLE)
+#endif     // DYNAMIC_KEYMAP_ENABLE
+    nvm_eeconfig_flush();
+#ifndef FILESYSTEM_ASYNC_SAVE
+    fs_batch_commit();
+#endif // FILESYSTEM_ASYNC_SAVE
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Pre-erase
+
+// With FILESYSTEM_PRE_ERASE defined, free blocks are erased a few at a time once saves and input have both gone idle, so
+// that the next save pays program time only rather than waiting on erases. Nothing being dirty doesn't mean nobody is
+// typing, and without FILESYSTEM_ASYNC_SAVE each step stalls the main loop. With it, this runs on the save thread.
+
+#ifdef FILESYSTEM_PRE_ERASE
+// Configurable: Time between pre-erase steps
+#    ifndef FILESYSTEM_PRE_ERASE_INTERVAL_MS
+#        define FILESYSTEM_PRE_ERASE_INTERVAL_MS 1000
+#    endif
+
+// Configurable: Time without any input before pre-erase steps start
+#    ifndef FILESYSTEM_PRE_ERASE_IDLE_MS
+#        define FILESYSTEM_PRE_ERASE_IDLE_MS 5000
+#    endif
+
+// Configurable: Most blocks erased per step; each takes tens of milliseconds, during which a synchronous save would
+// stall the main loop
+#    ifndef FILESYSTEM_PRE_ERASE_BLOCKS
+#        define FILESYSTEM_PRE_ERASE_BLOCKS 1
+#    endif
+
+static uint32_t nvm_filesystem_last_pre_erase = 0;
+
+static void nvm_filesystem_pre_erase(void) {
+    if (nvm_filesystem_dirty || last_input_activity_elapsed() < FILESYSTEM_PRE_ERASE_IDLE_MS || timer_elapsed32(nvm_filesystem_last_pre_erase) < FILESYSTEM_PRE_ERASE_INTERVAL_MS) {
+        return;
+    }
+    if (nvm_save_pre_erase(FILESYSTEM_PRE_ERASE_BLOCKS)) {
+        nvm_filesystem_last_pre_erase = timer_read32();
+    }
+}
+#endif // FILESYSTEM_PRE_ERASE
+
+////////////////////////////////////////////////////////////////////////////////
+// Base hooks
+
+void keyboard_post_init_filesystem() {
+    keyboard_post_init_filesystem_kb();
+    nvm_save_init();
+#ifdef DYNAMIC_KEYMAP_ENABLE
+    // Keep the filesystem mounted across all the loads, rather than per file
+    fs_batch_begin();
+    nvm_dynamic_keymap_load();
+    nvm_dynamic_keymap_macro_load();
+#    if defined(ENCODER_ENABLE) && defined(ENCODER_MAP_ENABLE)
+    nvm_dynamic_encodermap_load();
+#    endif // defined(ENCODER_ENABLE) && defined(ENCODER_MAP_ENABLE)
+    fs_batch_commit();
+#endif // DYNAMIC_KEYMAP_ENABLE
+}
+
+void housekeeping_task_filesystem(void) {
+    FS_PROFILE_SCOPE(FS_PROFILE_HOUSEKEEPING);
+    housekeeping_task_filesystem_kb();
+
+    // Let the save worker run if it has anything queued
+    nvm_save_yield();
+
+    // Save once edits have gone quiet, or have been pending for too long
+    bool due = timer_elapsed32(nvm_filesystem_last_flush) >= FILESYSTEM_SAVE_MAX_DELAY_MS;
+    if (nvm_filesystem_dirty) {
+        due = due || timer_elapsed32(nvm_filesystem_last_edit) >= FILESYSTEM_SAVE_QUIET_MS || timer_elapsed32(nvm_filesystem_first_edit) >= FILESYSTEM_SAVE_MAX_DELAY_MS;
+    }
+    if (due) {
+        nvm_filesystem_flush();
+        return;
+    }
+
+#ifdef FILESYSTEM_PRE_ERASE
+    nvm_filesystem_pre_erase();
+#endif // FILESYSTEM_PRE_ERASE
+}
+
+void suspend_power_down_filesystem(void) {
+    suspend_power_down_filesystem_kb();
+    // Don't wait out the quiet period, power may not come back
+    nvm_filesystem_flush();
+    nvm_save_barrier();
+}
+
+bool shutdown_filesystem(bool jump_to_bootloader) {
+    if (!shutdown_filesystem_kb(jump_to_bootloader)) {
+        return false;
+    }
+    // Drain the save worker and write anything still dirty synchronously, as it won't get another chance
+    nvm_save_stop();
+    nvm_filesystem_flush();
+    fs_flush_wear_stats();
+    fs_set_persistent_mount(false);
+    return true;
+}
@@ -0,0 +1,243 @@
+// Copyright 2025-2026 Nick Brassel (@tzarc)
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <string.h>
+#include "filesystem.h"
+#include "nvm_filesystem.h"
+
+// Deferred persistence. With FILESYSTEM_ASYNC_SAVE defined, saves are snapshotted into a bounded pool of jobs and
+// written by a worker thread, so that flash erase/program time is kept off the keyboard scan loop:
+// - If the pool is full the save is refused, and the caller leaves its dirty state set to retry on the next pass
+// - Jobs are written in the order they were queued, so a later save of a file always lands after an earlier one
+// - Payloads too large to snapshot are written synchronously, once everything queued ahead of them has landed
+// - Appends which fail in the worker bump a failure counter, so the owner can fall back to rewriting its files
+// - Pre-erase steps are only queued while nothing else is, so that erasing ahead of time never delays a save
+// - The flash is driven from the worker while the main loop runs, so anything else on the flash's SPI bus must take
+//   fs_device_bus_lock() around its transfers, or the flash must be alone on its bus
+// Without FILESYSTEM_ASYNC_SAVE, or before the worker is started, everything is written synchronously.
+
+#ifdef FILESYSTEM_ASYNC_SAVE
+#    ifdef FILESYSTEM_HOST
+#        error "FILESYSTEM_ASYNC_SAVE requires ChibiOS"
+#    endif
+#    include <ch.h>
+
+// Configurable: Number of save jobs which may be queued at once
+#    ifndef FILESYSTEM_ASYNC_SAVE_QUEUE_SIZE
+#        define FILESYSTEM_ASYNC_SAVE_QUEUE_SIZE 4
+#    endif
+
+// Configurable: Largest payload which will be snapshotted, larger saves are written synchronously
+#    ifndef FILESYSTEM_ASYNC_SAVE_MAX_PAYLOAD
+#        define FILESYSTEM_ASYNC_SAVE_MAX_PAYLOAD 256
+#    endif
+
+// Configurable: Stack size of the save thread
+#    ifndef FILESYSTEM_ASYNC_SAVE_STACK_SIZE
+#        define FILESYSTEM_ASYNC_SAVE_STACK_SIZE 2048
+#    endif
+
+// Configurable: Priority of the save thread. QMK's main loop never blocks, so a strictly lower priority thread would
+// never run; at the same priority the main loop hands over to it from housekeeping whenever jobs are pending.
+#    ifndef FILESYSTEM_ASYNC_SAVE_THREAD_PRIORITY
+#        define FILESYSTEM_ASYNC_SAVE_THREAD_PRIORITY NORMALPRIO
+#    endif
+
+#    define NVM_SAVE_FILENAME_MAX 32
+
+typedef enum nvm_save_op_t {
+    NVM_SAVE_UPDATE,
+    NVM_SAVE_APPEND,
+    NVM_SAVE_DELETE,
+    NVM_SAVE_PRE_ERASE,
+} nvm_save_op_t;
+
+typedef struct nvm_save_job_t {
+    uint8_t  data[FILESYSTEM_ASYNC_SAVE_MAX_PAYLOAD];
+    char     filename[NVM_SAVE_FILENAME_MAX];
+    uint16_t size; // Block count for NVM_SAVE_PRE_ERASE
+    uint8_t  op;   // nvm_save_op_t
+} nvm_save_job_t;
+
+static nvm_save_job_t nvm_save_jobs[FILESYSTEM_ASYNC_SAVE_QUEUE_SIZE];
+static msg_t          nvm_save_msgs[FILESYSTEM_ASYNC_SAVE_QUEUE_SIZE];
+static objects_fifo_t nvm_save_fifo;
+
+static THD_WORKING_AREA(nvm_save_thread_wa, FILESYSTEM_ASYNC_SAVE_STACK_SIZE);
+
+static bool              nvm_save_running  = false;
+static volatile uint16_t nvm_save_pending  = 0; // Queued or in-progress jobs, modified under chSysLock()
+static volatile uint32_t nvm_save_failures = 0; // Only written by the save thread
+
+static void nvm_save_run(const nvm_save_job_t *job) {
+    switch (job->op) {
+        case NVM_SAVE_UPDATE:
+            fs_update_block(job->filename, job->data, job->size);
+            break;
+        case NVM_SAVE_APPEND:
+            if (!fs_append_block(job->filename, job->data, job->size)) {
+                fs_dprintf("append to %s failed\n", job->filename);
+                ++nvm_save_failures;
+            }
+            break;
+        case NVM_SAVE_DELETE:
+            fs_delete(job->filename);
+            break;
+        case NVM_SAVE_PRE_ERASE:
+            fs_pre_erase(job->size);
+            break;
+    }
+}
+
+static THD_FUNCTION(nvm_save_thread, arg) {
+    (void)arg;
+    chRegSetThreadName("nvm_save");
+    while (true) {
+        nvm_save_job_t *job;
+        chFifoReceiveObjectTimeout(&nvm_save_fifo, (void **)&job, TIME_INFINITE);
+
+        // Keep the filesystem mounted until the queue has drained, without holding the lock between jobs. Pre-erase steps
+        // don't mount it up front, as they only mount if the pool needs topping up.
+        bool mounted = false;
+        do {
+            if (!mounted && job->op != NVM_SAVE_PRE_ERASE) {
+                mounted = fs_mount();
+            }
+            nvm_save_run(job);
+            chFifoReturnObject(&nvm_save_fifo, job);
+            chSysLock();
+            --nvm_save_pending;
+            chSysUnlock();
+        } while (chFifoReceiveObjectTimeout(&nvm_save_fifo, (void **)&job, TIME_IMMEDIATE) == MSG_OK);
+        if (mounted) {
+            fs_unmount();
+        }
+    }
+}
+
+static bool nvm_save_can_queue(const char *filename, size_t size) {
+    return nvm_save_running && size <= FILESYSTEM_ASYNC_SAVE_MAX_PAYLOAD && strlen(filename) < NVM_SAVE_FILENAME_MAX;
+}
+
+static bool nvm_save_enqueue(nvm_save_op_t op, const char *filename, const void *data, size_t size) {
+    nvm_save_job_t *job = chFifoTakeObjectTimeout(&nvm_save_fifo, TIME_IMMEDIATE);
+    if (!job) {
+        fs_dprintf("queue full, deferring %s\n", filename);
+        return false;
+    }
+
+    job->op   = op;
+    job->size = size;
+    strcpy(job->filename, filename);
+    if (data && size > 0) {
+        memcpy(job->data, data, size);
+    }
+
+    chSysLock();
+    ++nvm_save_pending;
+    chSysUnlock();
+    chFifoSendObject(&nvm_save_fifo, job);
+    return true;
+}
+
+void nvm_save_init(void) {
+    if (nvm_save_running) {
+        return;
+    }
+    chFifoObjectInit(&nvm_save_fifo, sizeof(nvm_save_job_t), FILESYSTEM_ASYNC_SAVE_QUEUE_SIZE, nvm_save_jobs, nvm_save_msgs);
+    chThdCreateStatic(nvm_save_thread_wa, sizeof(nvm_save_thread_wa), FILESYSTEM_ASYNC_SAVE_THREAD_PRIORITY, nvm_save_thread, NULL);
+    nvm_save_running = true;
+}
+
+void nvm_save_stop(void) {
+    nvm_save_barrier();
+    nvm_save_running = false;
+}
+
+void nvm_save_barrier(void) {
+    while (nvm_save_pending > 0) {
+        chThdSleepMilliseconds(1);
+    }
+}
+
+void nvm_save_yield(void) {
+    if (nvm_save_pending > 0) {
+        chThdYield();
+    }
+}
+
+uint32_t nvm_save_failure_count(void) {
+    return nvm_save_failures;
+}
+
+bool nvm_save_update(const char *filename, const void *data, size_t size) {
+    if (nvm_save_can_queue(filename, size)) {
+        return nvm_save_enqueue(NVM_SAVE_UPDATE, filename, data, size);
+    }
+    // Written synchronously, so anything already queued must land first
+    nvm_save_barrier();
+    fs_update_block(filename, data, size);
+    return true;
+}
+
+bool nvm_save_append(const char *filename, const void *data, size_t size) {
+    if (nvm_save_can_queue(filename, size)) {
+        return nvm_save_enqueue(NVM_SAVE_APPEND, filename, data, size);
+    }
+    nvm_save_barrier();
+    return fs_append_block(filename, data, size);
+}
+
+bool nvm_save_delete(const char *filename) {
+    if (nvm_save_can_queue(filename, 0)) {
+        return nvm_save_enqueue(NVM_SAVE_DELETE, filename, NULL, 0);
+    }
+    nvm_save_barrier();
+    fs_delete(filename);
+    return true;
+}
+
+bool nvm_save_pre_erase(uint16_t max_blocks) {
+    if (!nvm_save_running) {
+        fs_pre_erase(max_blocks);
+        return true;
+    }
+    if (nvm_save_pending > 0) {
+        return false;
+    }
+    return nvm_save_enqueue(NVM_SAVE_PRE_ERASE, "", NULL, max_blocks);
+}
+
+#else // FILESYSTEM_ASYNC_SAVE
+
+void nvm_save_init(void) {}
+
+void nvm_save_stop(void) {}
+
+void nvm_save_barrier(void) {}
+
+void nvm_save_yield(void) {}
+
+uint32_t nvm_save_failure_count(void) {
+    return 0;
+}
+
+bool nvm_save_update(const char *filename, const void *data, size_t size) {
+    fs_update_block(filename, data, size);
+    return true;
+}
+
+bool nvm_save_append(const char *filename, const void *data, size_t size) {
+    return fs_append_block(filename, data, size);
+}
+
+bool nvm_save_delete(const char *filename) {
+    fs_delete(filename);
+    return true;
+}
+
+bool nvm_save_pre_erase(uint16_t max_blocks) {
+    fs_pre_erase(max_blocks);
+    return true;
+}
+
+#endif // FILESYSTEM_ASYNC_SAVE
@@ -14,6 +14,7 @@ ifneq ($(strip $(FILESYSTEM_DRIVER)),)
         COMMON_VPATH += \
             $(MODULE_PATH_FILESYSTEM)/filesystem
         # SRC += filesystem.c # This is already included in the build by virtue of having the same name as the module -- when promoting to core, need to uncomment this line
+        SRC += fs_profile.c
 
         # If we're using a littlefs driver, set up the common littlefs items
         ifeq ($(strip $(FILESYSTEM_DRIVER:lfs_%=lfs_)),lfs_)
@@ -25,6 +26,12 @@ ifneq ($(strip $(FILESYSTEM_DRIVER)),)
                 lfs_util.c \
                 fs_lfs_common.c
             OPT_DEFS += -DLFS_NO_MALLOC -DLFS_THREADSAFE -DLFS_NAME_MAX=40 -DLFS_NO_ASSERT
+
+            # Read-only asset pack served alongside littlefs, see fs_asset_pack.h
+            FILESYSTEM_ASSETS ?= no
+            ifeq ($(strip $(FILESYSTEM_ASSETS)),yes)
+                OPT_DEFS += -DFILESYSTEM_ASSETS
+            endif
         endif
 
         ifeq ($(strip $(FILESYSTEM_DRIVER)),lfs_flash)
@@ -42,22 +49,34 @@ ifneq ($(strip $(FILESYSTEM_DRIVER)),)
         ifeq ($(strip $(XAP_ENABLE)),yes)
             COMMON_VPATH += $(MODULE_PATH_FILESYSTEM)/nvm
             SRC += \
+                nvm_filesystem.c \
+                nvm_save.c \
+                nvm_hooks.c \
                 nvm_eeconfig.c \
                 nvm_dynamic_keymap.c
         else ifeq ($(strip $(VIA_ENABLE)),yes)
             COMMON_VPATH += $(MODULE_PATH_FILESYSTEM)/nvm
             SRC += \
+                nvm_filesystem.c \
+                nvm_save.c \
+                nvm_hooks.c \
                 nvm_eeconfig.c \
                 nvm_dynamic_keymap.c \
                 nvm_via.c
         else ifeq ($(strip $(DYNAMIC_KEYMAP_ENABLE)),yes)
             COMMON_VPATH += $(MODULE_PATH_FILESYSTEM)/nvm
             SRC += \
+                nvm_filesystem.c \
+                nvm_save.c \
+                nvm_hooks.c \
                 nvm_eeconfig.c \
                 nvm_dynamic_keymap.c
         else
             COMMON_VPATH += $(MODULE_PATH_FILESYSTEM)/nvm
             SRC += \
+                nvm_filesystem.c \
+                nvm_save.c \
+                nvm_hooks.c \
                 nvm_eeconfig.c
         endif
     endif
@@ -0,0 +1,523 @@
+// Copyright 2025-2026 Nick Brassel (@tzarc)
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "filesystem.h"
+#include "fs_profile.h"
+#include "fs_lfs_host.h"
+#include "nvm_filesystem.h"
+#ifdef FILESYSTEM_ASSETS
+#    include "fs_asset_pack.h"
+#endif // FILESYSTEM_ASSETS
+
+// Filesystem micro-benchmarks, run against the simulated flash in fs_lfs_host.c.
+//
+// Each measured call records its wall-clock latency, and the number of device
+// reads/programs/erases it caused. Workloads model the way the nvm_* layers use
+// the filesystem, with a fixed PRNG seed so that runs are repeatable.
+
+#define BENCH_MATRIX_ROWS 6
+#define BENCH_MATRIX_COLS 16
+#define BENCH_LAYER_COUNT 32
+#define BENCH_MACRO_BUFFER_SIZE 1024
+#define BENCH_VIA_CUSTOM_CONFIG_SIZE 64
+#define BENCH_HISTOGRAM_BUCKETS 24
+#define BENCH_IDLE_PRE_ERASE_BLOCKS 4
+#define BENCH_STREAM_FILE_SIZE 4096
+#define BENCH_STREAM_CHUNK_SIZE 16
+#define BENCH_STREAM_BUFFER_SIZE 1024
+#define BENCH_ASSET_COUNT 8
+
+typedef struct bench_stat_t {
+    const char *name;
+    uint64_t   *samples;
+    size_t      count;
+    size_t      capacity;
+    uint64_t    reads;
+    uint64_t    progs;
+    uint64_t    erases;
+    uint64_t    erases_skipped;
+    uint64_t    prog_bytes;
+} bench_stat_t;
+
+enum bench_op {
+    BENCH_OPEN,
+    BENCH_CLOSE,
+    BENCH_READ,
+    BENCH_WRITE,
+    BENCH_SEEK,
+    BENCH_READDIR,
+    BENCH_RMDIR_RECURSIVE,
+    BENCH_READ_BLOCK,
+    BENCH_UPDATE_BLOCK,
+    BENCH_EECONFIG_UPDATE,
+    BENCH_KEYMAP_SAVE,
+    BENCH_MACRO_SAVE,
+    BENCH_VIA_CUSTOM_CONFIG,
+    BENCH_STREAM_READ,
+    BENCH_STREAM_READ_BUFFERED,
+    BENCH_FILE_LOAD,
+    BENCH_ASSET_LOAD,
+    BENCH_ASSET_MAP,
+    BENCH_OP_COUNT,
+};
+
+static bench_stat_t bench_stats[BENCH_OP_COUNT] = {
+    [BENCH_OPEN]                 = {.name = "fs_open"},
+    [BENCH_CLOSE]                = {.name = "fs_close"},
+    [BENCH_READ]                 = {.name = "fs_read"},
+    [BENCH_WRITE]                = {.name = "fs_write"},
+    [BENCH_SEEK]                 = {.name = "fs_seek"},
+    [BENCH_READDIR]              = {.name = "fs_readdir"},
+    [BENCH_RMDIR_RECURSIVE]      = {.name = "fs_rmdir(recursive)"},
+    [BENCH_READ_BLOCK]           = {.name = "fs_read_block"},
+    [BENCH_UPDATE_BLOCK]         = {.name = "fs_update_block"},
+    [BENCH_EECONFIG_UPDATE]      = {.name = "eeconfig word update"},
+    [BENCH_KEYMAP_SAVE]          = {.name = "keymap save (32 layers)"},
+    [BENCH_MACRO_SAVE]           = {.name = "macro buffer save (1kB)"},
+    [BENCH_VIA_CUSTOM_CONFIG]    = {.name = "via custom config sweep"},
+    [BENCH_STREAM_READ]          = {.name = "4kB stream in 16B reads"},
+    [BENCH_STREAM_READ_BUFFERED] = {.name = "4kB stream, 1kB buffer"},
+    [BENCH_FILE_LOAD]            = {.name = "4kB file load"},
+    [BENCH_ASSET_LOAD]           = {.name = "4kB asset load"},
+    [BENCH_ASSET_MAP]            = {.name = "4kB asset map"},
+};
+
+static uint32_t bench_prng_state = 0x12345678;
+
+static bool bench_idle_pre_erase = false;
+
+static uint32_t bench_rand(void) {
+    // xorshift32, deterministic across platforms
+    uint32_t x = bench_prng_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return bench_prng_state = x;
+}
+
+static uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void bench_record(enum bench_op op, uint64_t ns, const fs_host_stats_t *before) {
+    bench_stat_t          *stat  = &bench_stats[op];
+    const fs_host_stats_t *after = fs_host_get_stats();
+    if (stat->count == stat->capacity) {
+        stat->capacity = stat->capacity ? stat->capacity * 2 : 256;
+        stat->samples  = realloc(stat->samples, stat->capacity * sizeof(uint64_t));
+        if (!stat->samples) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+    }
+    stat->samples[stat->count++] = ns;
+    stat->reads += after->read_count - before->read_count;
+    stat->progs += after->prog_count - before->prog_count;
+    stat->erases += after->erase_count - before->erase_count;
+    stat->erases_skipped += after->erase_skipped - before->erase_skipped;
+    stat->prog_bytes += after->prog_bytes - before->prog_bytes;
+}
+
+// Measures a single expression, recording latency and device operations against the given op
+#define BENCH(op, expr)                                            \
+    ({                                                             \
+        fs_host_stats_t __before = *fs_host_get_stats();           \
+        uint64_t        __start  = bench_now_ns();                 \
+        __auto_type     __ret    = (expr);                         \
+        bench_record((op), bench_now_ns() - __start, &__before);   \
+        __ret;                                                     \
+    })
+
+// As per BENCH(), for expressions without a result
+#define BENCH_VOID(op, expr)                                       \
+    do {                                                           \
+        fs_host_stats_t __before = *fs_host_get_stats();           \
+        uint64_t        __start  = bench_now_ns();                 \
+        (expr);                                                    \
+        bench_record((op), bench_now_ns() - __start, &__before);   \
+    } while (0)
+
+static int bench_compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void bench_report(bool show_histograms) {
+    // skipped/op counts littlefs' erases of blocks already erased ahead of time, i.e. hits on the -e or -p pool
+    printf("%-26s %8s %10s %10s %10s %10s %10s %10s %10s %12s\n", "operation", "count", "p50 (us)", "p99 (us)", "max (us)", "reads/op", "progs/op", "erases/op", "skipped/op", "prog B/op");
+    for (int op = 0; op < BENCH_OP_COUNT; ++op) {
+        bench_stat_t *stat = &bench_stats[op];
+        if (stat->count == 0) {
+            continue;
+        }
+        qsort(stat->samples, stat->count, sizeof(uint64_t), bench_compare_u64);
+        double p50 = stat->samples[((stat->count - 1) * 50) / 100] / 1000.0;
+        double p99 = stat->samples[((stat->count - 1) * 99) / 100] / 1000.0;
+        double max = stat->samples[stat->count - 1] / 1000.0;
+        printf("%-26s %8zu %10.2f %10.2f %10.2f %10.2f %10.2f %10.3f %10.3f %12.1f\n", stat->name, stat->count, p50, p99, max, (double)stat->reads / stat->count, (double)stat->progs / stat->count, (double)stat->erases / stat->count, (double)stat->erases_skipped / stat->count, (double)stat->prog_bytes / stat->count);
+
+        if (show_histograms) {
+            // Power-of-two microsecond buckets, only the populated ones are shown
+            size_t buckets[BENCH_HISTOGRAM_BUCKETS] = {0};
+            for (size_t i = 0; i < stat->count; ++i) {
+                uint64_t us     = stat->samples[i] / 1000;
+                int      bucket = 0;
+                while (us > 0 && bucket < BENCH_HISTOGRAM_BUCKETS - 1) {
+                    us >>= 1;
+                    ++bucket;
+                }
+                buckets[bucket]++;
+            }
+            printf("    histogram:");
+            for (int b = 0; b < BENCH_HISTOGRAM_BUCKETS; ++b) {
+                if (buckets[b]) {
+                    printf(" [<%lluus]=%zu", 1ull << b, buckets[b]);
+                }
+            }
+            printf("\n");
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Workloads
+
+// Time between saves, unmeasured; as per housekeeping with FILESYSTEM_PRE_ERASE, tops up the pool of erased blocks
+static void bench_idle(void) {
+    if (bench_idle_pre_erase) {
+        fs_pre_erase(BENCH_IDLE_PRE_ERASE_BLOCKS);
+    }
+}
+
+static void bench_raw_api(int iterations) {
+    uint8_t buf[256];
+    for (size_t i = 0; i < sizeof(buf); ++i) {
+        buf[i] = (uint8_t)i;
+    }
+
+    fs_mkdir("bench");
+    for (int n = 0; n < iterations; ++n) {
+        char filename[32];
+        snprintf(filename, sizeof(filename), "bench/f%03d", n % 16);
+
+        fs_fd_t fd = BENCH(BENCH_OPEN, fs_open(filename, FS_WRITE | FS_TRUNCATE));
+        BENCH(BENCH_WRITE, fs_write(fd, buf, sizeof(buf)));
+        BENCH_VOID(BENCH_CLOSE, fs_close(fd));
+
+        fd = BENCH(BENCH_OPEN, fs_open(filename, FS_READ));
+        BENCH(BENCH_SEEK, fs_seek(fd, bench_rand() % sizeof(buf), FS_SEEK_SET));
+        BENCH(BENCH_READ, fs_read(fd, buf, 32));
+        BENCH(BENCH_SEEK, fs_seek(fd, 0, FS_SEEK_SET));
+        BENCH(BENCH_READ, fs_read(fd, buf, sizeof(buf)));
+        BENCH_VOID(BENCH_CLOSE, fs_close(fd));
+    }
+
+    fs_fd_t dir = fs_opendir("bench");
+    while (BENCH(BENCH_READDIR, fs_readdir(dir)) != NULL) {
+    }
+    fs_closedir(dir);
+
+    BENCH(BENCH_RMDIR_RECURSIVE, fs_rmdir("bench", true));
+}
+
+static void bench_eeconfig(int iterations) {
+    // Single-word updates, as per nvm_eeconfig_update_kb() and friends
+    static const char *const files[] = {"ee/keyboard", "ee/user", "ee/keymap_hash", "ee/debug"};
+    fs_mkdir("ee");
+    for (int n = 0; n < iterations; ++n) {
+        const char *filename = files[n % (sizeof(files) / sizeof(files[0]))];
+        uint32_t    value    = bench_rand();
+        BENCH_VOID(BENCH_EECONFIG_UPDATE, fs_update_block(filename, &value, sizeof(value)));
+        BENCH(BENCH_READ_BLOCK, fs_read_block(filename, &value, sizeof(value)));
+        bench_idle();
+    }
+}
+
+static void bench_keymap(int iterations) {
+    // Full-layer format as written by nvm_dynamic_keymap_save(): a write mode byte followed by the keycodes
+    static struct __attribute__((packed)) {
+        uint8_t  write_mode;
+        uint16_t keycodes[BENCH_MATRIX_ROWS][BENCH_MATRIX_COLS];
+    } layers[BENCH_LAYER_COUNT];
+
+    fs_mkdir("layers");
+    for (int n = 0; n < iterations; ++n) {
+        // First round saves everything, subsequent rounds remap a single key on a random layer, then save all layers
+        if (n > 0) {
+            int layer = bench_rand() % BENCH_LAYER_COUNT;
+            int row   = bench_rand() % BENCH_MATRIX_ROWS;
+            int col   = bench_rand() % BENCH_MATRIX_COLS;
+
+            layers[layer].keycodes[row][col] = bench_rand() & 0xFFFF;
+        }
+        fs_host_stats_t before = *fs_host_get_stats();
+        uint64_t        start  = bench_now_ns();
+        for (int layer = 0; layer < BENCH_LAYER_COUNT; ++layer) {
+            char filename[18];
+            snprintf(filename, sizeof(filename), "layers/key%02d", layer);
+            BENCH_VOID(BENCH_UPDATE_BLOCK, fs_update_block(filename, &layers[layer], sizeof(layers[layer])));
+        }
+        bench_record(BENCH_KEYMAP_SAVE, bench_now_ns() - start, &before);
+        bench_idle();
+    }
+}
+
+static void bench_macros(int iterations) {
+    // The dynamic macro buffer is split on NUL terminators into separate files, as per nvm_dynamic_keymap_macro_save()
+    static char buffer[BENCH_MACRO_BUFFER_SIZE];
+    for (size_t i = 0; i < sizeof(buffer); ++i) {
+        buffer[i] = (i % 64 == 63) ? 0 : 'a' + (i % 26);
+    }
+
+    fs_mkdir("macros");
+    for (int n = 0; n < iterations; ++n) {
+        if (n > 0) {
+            buffer[bench_rand() % sizeof(buffer)] = 'a' + (bench_rand() % 26);
+        }
+        fs_host_stats_t before      = *fs_host_get_stats();
+        uint64_t        start       = bench_now_ns();
+        char           *terminator  = buffer + sizeof(buffer);
+        char           *macro_start = buffer;
+        int             index       = 0;
+        while (macro_start < terminator) {
+            char *macro_end = macro_start;
+            while (macro_end < terminator && *macro_end != 0) {
+                macro_end++;
+            }
+            if (macro_end - macro_start > 0) {
+                char filename[18];
+                snprintf(filename, sizeof(filename), "macros/%02d", index);
+                BENCH_VOID(BENCH_UPDATE_BLOCK, fs_update_block(filename, macro_start, macro_end - macro_start));
+            }
+            ++index;
+            macro_start = macro_end + 1;
+        }
+        bench_record(BENCH_MACRO_SAVE, bench_now_ns() - start, &before);
+        bench_idle();
+    }
+}
+
+static void bench_via_custom_config(int iterations) {
+    // Read-modify-write of each byte in turn, as per nvm_via_update_custom_config()
+    fs_mkdir("via");
+    for (int n = 0; n < iterations; ++n) {
+        for (int offset = 0; offset < BENCH_VIA_CUSTOM_CONFIG_SIZE; ++offset) {
+            uint8_t config[BENCH_VIA_CUSTOM_CONFIG_SIZE];
+            BENCH(BENCH_READ_BLOCK, fs_read_block("via/custom_config", config, sizeof(config)));
+            config[offset] = bench_rand() & 0xFF;
+            BENCH_VOID(BENCH_VIA_CUSTOM_CONFIG, fs_update_block("via/custom_config", config, sizeof(config)));
+            bench_idle();
+        }
+    }
+}
+
+static void bench_stream_once(enum bench_op op, fs_access_t access) {
+    uint8_t         chunk[BENCH_STREAM_CHUNK_SIZE];
+    fs_host_stats_t before = *fs_host_get_stats();
+    uint64_t        start  = bench_now_ns();
+    fs_fd_t         fd     = fs_open_ex("media/stream", FS_READ, access, BENCH_STREAM_BUFFER_SIZE);
+    while (fs_read(fd, chunk, sizeof(chunk)) == sizeof(chunk)) {
+    }
+    fs_close(fd);
+    bench_record(op, bench_now_ns() - start, &before);
+}
+
+static void bench_stream(int iterations) {
+    // Small pieces read front to back, as per an animation or script asset being played back
+    static uint8_t data[BENCH_STREAM_FILE_SIZE];
+    for (size_t i = 0; i < sizeof(data); ++i) {
+        data[i] = bench_rand() & 0xFF;
+    }
+
+    fs_mkdir("media");
+    fs_update_block("media/stream", data, sizeof(data));
+    for (int n = 0; n < iterations; ++n) {
+        bench_stream_once(BENCH_STREAM_READ, FS_ACCESS_DEFAULT);
+        bench_stream_once(BENCH_STREAM_READ_BUFFERED, FS_ACCESS_SEQUENTIAL);
+    }
+}
+
+#ifdef FILESYSTEM_ASSETS
+static bool bench_assets_mapped = false;
+
+// Fills the simulated asset partition with BENCH_ASSET_COUNT assets, before the filesystem is initialised
+static bool bench_assets_prepare(void) {
+    static uint8_t pack[sizeof(fs_asset_pack_header_t) + BENCH_ASSET_COUNT * (sizeof(fs_asset_pack_entry_t) + BENCH_STREAM_FILE_SIZE)];
+    uint32_t       offset = sizeof(fs_asset_pack_header_t) + BENCH_ASSET_COUNT * sizeof(fs_asset_pack_entry_t);
+    for (int i = 0; i < BENCH_ASSET_COUNT; ++i) {
+        // Zero-padded numbering keeps the index sorted
+        fs_asset_pack_entry_t entry = {.offset = offset, .size = BENCH_STREAM_FILE_SIZE};
+        snprintf(entry.name, sizeof(entry.name), "asset%02d", i);
+        memcpy(&pack[sizeof(fs_asset_pack_header_t) + i * sizeof(entry)], &entry, sizeof(entry));
+        for (int j = 0; j < BENCH_STREAM_FILE_SIZE; ++j) {
+            pack[offset + j] = bench_rand() & 0xFF;
+        }
+        offset += BENCH_STREAM_FILE_SIZE;
+    }
+    fs_asset_pack_header_t header = {.magic = FS_ASSET_PACK_MAGIC, .version = FS_ASSET_PACK_VERSION, .count = BENCH_ASSET_COUNT, .size = offset};
+    memcpy(pack, &header, sizeof(header));
+    return fs_host_assets_load(pack, sizeof(pack), bench_assets_mapped);
+}
+
+static void bench_load_once(enum bench_op op, const char *filename) {
+    static uint8_t  data[BENCH_STREAM_FILE_SIZE];
+    fs_host_stats_t before = *fs_host_get_stats();
+    uint64_t        start  = bench_now_ns();
+    fs_fd_t         fd     = fs_open(filename, FS_READ);
+    fs_read(fd, data, sizeof(data));
+    fs_close(fd);
+    bench_record(op, bench_now_ns() - start, &before);
+}
+
+static void bench_assets(int iterations) {
+    // Whole assets loaded at once, as per an effect or script being started, against the same load through littlefs
+    char filename[32];
+    for (int n = 0; n < iterations; ++n) {
+        snprintf(filename, sizeof(filename), FS_ASSETS_PREFIX "/asset%02d", n % BENCH_ASSET_COUNT);
+        bench_load_once(BENCH_ASSET_LOAD, filename);
+        bench_load_once(BENCH_FILE_LOAD, "media/stream");
+        if (bench_assets_mapped) {
+            fs_size_t size;
+            BENCH(BENCH_ASSET_MAP, fs_asset_map(filename, &size));
+        }
+    }
+}
+#endif // FILESYSTEM_ASSETS
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void usage(const char *argv0) {
+    fprintf(stderr, "Usage: %s [-i iterations] [-s seed] [-l] [-m] [-e] [-p] [-x] [-H] [-f image] [-F]\n", argv0);
+    fprintf(stderr, "  -i  Iterations per workload (default 100)\n");
+    fprintf(stderr, "  -s  PRNG seed (default 0x12345678)\n");
+    fprintf(stderr, "  -l  Inject typical SPI NOR flash latency\n");
+    fprintf(stderr, "  -m  Keep the filesystem mounted between operations\n");
+    fprintf(stderr, "  -e  Erase free space before running, so workloads pay program time only\n");
+    fprintf(stderr, "  -p  Pre-erase free blocks between saves, as per FILESYSTEM_PRE_ERASE while idle\n");
+    fprintf(stderr, "  -x  Treat the asset partition as memory-mapped (FILESYSTEM_ASSETS builds only)\n");
+    fprintf(stderr, "  -H  Show latency histograms\n");
+    fprintf(stderr, "  -f  Back the simulated flash with an image file, keeping any filesystem already on it\n");
+    fprintf(stderr, "  -F  Format the filesystem before running\n");
+}
+
+int main(int argc, char *argv[]) {
+    int         iterations      = 100;
+    bool        show_histograms = false;
+    bool        stay_mounted    = false;
+    bool        pre_erase       = false;
+    bool        format          = false;
+    const char *image           = NULL;
+    int         opt;
+    while ((opt = getopt(argc, argv, "i:s:lmepxHf:F")) != -1) {
+        switch (opt) {
+            case 'i':
+                iterations = atoi(optarg);
+                break;
+            case 's':
+                bench_prng_state = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'l': {
+                // Roughly a W25Q-series part on a 20MHz SPI clock
+                fs_host_latency_t latency = {
+                    .read_ns      = 2000,
+                    .read_byte_ns = 400,
+                    .prog_ns      = 400000,
+                    .prog_byte_ns = 400,
+                    .erase_ns     = 45000000,
+                    .erase_64k_ns = 150000000,
+                };
+                fs_host_set_latency(&latency);
+            } break;
+            case 'm':
+                stay_mounted = true;
+                break;
+            case 'e':
+                pre_erase = true;
+                break;
+            case 'p':
+                bench_idle_pre_erase = true;
+                break;
+            case 'x':
+#ifdef FILESYSTEM_ASSETS
+                bench_assets_mapped = true;
+#endif // FILESYSTEM_ASSETS
+                break;
+            case 'H':
+                show_histograms = true;
+                break;
+            case 'f':
+                image = optarg;
+                break;
+            case 'F':
+                format = true;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (image && !fs_host_image_attach(image)) {
+        fprintf(stderr, "could not open image %s\n", image);
+        return 1;
+    }
+#ifdef FILESYSTEM_ASSETS
+    if (!bench_assets_prepare()) {
+        fprintf(stderr, "could not load asset pack\n");
+        return 1;
+    }
+#endif // FILESYSTEM_ASSETS
+    // fs_init() only formats if there's no filesystem to mount, so an existing or aged image is benchmarked as-is
+    if (!fs_init() || (format && !fs_format())) {
+        fprintf(stderr, "could not initialise filesystem\n");
+        return 1;
+    }
+    fs_set_persistent_mount(stay_mounted);
+    if (pre_erase && !fs_erase_free_space()) {
+        fprintf(stderr, "could not erase free space\n");
+        return 1;
+    }
+    fs_host_reset_stats();
+    fs_profile_reset();
+
+    fs_mount_stats_t mounts_before;
+    fs_get_mount_stats(&mounts_before);
+
+    bench_raw_api(iterations);
+    bench_eeconfig(iterations);
+    bench_keymap(iterations);
+    bench_macros(iterations);
+    bench_via_custom_config(iterations > 4 ? iterations / 4 : 1);
+    bench_stream(iterations);
+#ifdef FILESYSTEM_ASSETS
+    bench_assets(iterations);
+#endif // FILESYSTEM_ASSETS
+
+    bench_report(show_histograms);
+
+    const fs_host_stats_t *stats = fs_host_get_stats();
+    printf("\ntotal: %u reads (%llu bytes), %u programs (%llu bytes), %u erases (%u skipped), %u unerased programs\n", stats->read_count, (unsigned long long)stats->read_bytes, stats->prog_count, (unsigned long long)stats->prog_bytes, stats->erase_count, stats->erase_skipped, stats->prog_unerased);
+
+    fs_mount_stats_t mounts_after;
+    fs_get_mount_stats(&mounts_after);
+    printf("mounts: %lu, unmounts: %lu\n", (unsigned long)(mounts_after.mounts - mounts_before.mounts), (unsigned long)(mounts_after.unmounts - mounts_before.unmounts));
+
+    fs_wear_stats_t wear;
+    fs_get_wear_stats(&wear);
+    printf("lifetime wear: %lu erases, %llu bytes programmed\n", (unsigned long)wear.erases, (unsigned long long)wear.prog_bytes);
+
+#if defined(FILESYSTEM_PROFILE)
+    printf("\n");
+    fs_profile_dump();
+#endif // defined(FILESYSTEM_PROFILE)
+
+    fs_host_image_detach();
+    return 0;
+}
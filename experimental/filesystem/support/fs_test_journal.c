@@ -0,0 +1,292 @@
+// Copyright 2025-2026 Nick Brassel (@tzarc)
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "filesystem.h"
+#include "fs_lfs_host.h"
+#include "nvm_filesystem.h"
+
+// Tests for the journaled block files written by fs_update_block() and fs_append_block(), run against the simulated
+// flash in fs_lfs_host.c. The on-flash layout is checked directly, so these need updating alongside nvm_filesystem.c.
+
+// Mirrors the layout in nvm_filesystem.c, with the default FILESYSTEM_JOURNAL_MAX_BLOCK_SIZE and
+// FILESYSTEM_JOURNAL_COMPACT_THRESHOLD
+#define TEST_HEADER_SIZE 8
+#define TEST_RECORD_SIZE 4
+#define TEST_MAX_BLOCK_SIZE 256
+#define TEST_COMPACT_THRESHOLD 256
+
+static int test_failures = 0;
+
+#define CHECK(cond)                                                                      \
+    do {                                                                                 \
+        if (!(cond)) {                                                                   \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __func__, __LINE__, #cond);    \
+            ++test_failures;                                                             \
+        }                                                                                \
+    } while (0)
+
+static fs_offset_t test_file_size(const char *filename) {
+    fs_fd_t fd = fs_open(filename, FS_READ);
+    if (fd == INVALID_FILESYSTEM_FD) {
+        return -1;
+    }
+    fs_offset_t size = fs_seek(fd, 0, FS_SEEK_END);
+    fs_close(fd);
+    return size;
+}
+
+// Writes raw bytes, bypassing the journal, as per earlier firmware or a write torn part-way through
+static void test_write_raw(const char *filename, const void *data, size_t size, bool append) {
+    fs_fd_t fd = fs_open(filename, append ? FS_WRITE : (FS_WRITE | FS_TRUNCATE));
+    if (append) {
+        fs_seek(fd, 0, FS_SEEK_END);
+    }
+    CHECK(fs_write(fd, data, size) == (fs_size_t)size);
+    fs_close(fd);
+}
+
+static bool test_matches(const char *filename, const void *expected, size_t size) {
+    uint8_t actual[512];
+    return size <= sizeof(actual) && fs_read_block(filename, actual, size) == size && memcmp(actual, expected, size) == 0;
+}
+
+static void test_round_trip(void) {
+    uint8_t data[16];
+    for (size_t i = 0; i < sizeof(data); ++i) {
+        data[i] = (uint8_t)(i * 7);
+    }
+    fs_update_block("round_trip", data, sizeof(data));
+    CHECK(test_matches("round_trip", data, sizeof(data)));
+    CHECK(test_file_size("round_trip") == TEST_HEADER_SIZE + sizeof(data));
+
+    // Unchanged data isn't written again
+    fs_update_block("round_trip", data, sizeof(data));
+    CHECK(test_file_size("round_trip") == TEST_HEADER_SIZE + sizeof(data));
+
+    // Partial reads see the start of the image, and missing files read as zeroes
+    uint8_t part[4];
+    CHECK(fs_read_block_upto("round_trip", part, sizeof(part)) == sizeof(part) && memcmp(part, data, sizeof(part)) == 0);
+    memset(part, 0xAA, sizeof(part));
+    CHECK(fs_read_block("missing", part, sizeof(part)) == 0 && part[0] == 0 && part[3] == 0);
+
+    // A different size is a new image rather than a journal record
+    fs_update_block("round_trip", data, 8);
+    CHECK(test_matches("round_trip", data, 8));
+    CHECK(test_file_size("round_trip") == TEST_HEADER_SIZE + 8);
+}
+
+static void test_plain_images(void) {
+    // Files written without the journal header load as-is, including ones which start like its magic used to
+    uint32_t value = 0x00004AF5;
+    test_write_raw("plain_short", &value, sizeof(value), false);
+    CHECK(test_matches("plain_short", &value, sizeof(value)));
+
+    // The magic alone isn't enough, the header's check must match too
+    static const uint8_t lookalike[] = {0x46, 0x53, 0x4C, 0x4A, 0x04, 0x00, 0x12, 0x34, 1, 2, 3, 4};
+    test_write_raw("plain_lookalike", lookalike, sizeof(lookalike), false);
+    CHECK(test_matches("plain_lookalike", lookalike, sizeof(lookalike)));
+
+    // Appending to a plain image extends it in place
+    uint32_t values[2] = {value, 0x9ABCDEF0};
+    CHECK(fs_append_block("plain_short", &values[1], sizeof(values[1])));
+    CHECK(test_matches("plain_short", values, sizeof(values)));
+    CHECK(test_file_size("plain_short") == sizeof(values));
+
+    // Updating a plain image rewrites it with a header, and appends are journaled from then on
+    value = 0x12345678;
+    fs_update_block("plain_short", &value, sizeof(value));
+    CHECK(test_matches("plain_short", &value, sizeof(value)));
+    CHECK(test_file_size("plain_short") == TEST_HEADER_SIZE + sizeof(value));
+    CHECK(fs_append_block("plain_short", &value, sizeof(value)));
+    CHECK(test_file_size("plain_short") == TEST_HEADER_SIZE + sizeof(value) + TEST_RECORD_SIZE + sizeof(value));
+}
+
+static void test_large_blocks(void) {
+    // Blocks too large to journal are written without the header, and rewritten in full on change
+    uint8_t data[TEST_MAX_BLOCK_SIZE + 44];
+    for (size_t i = 0; i < sizeof(data); ++i) {
+        data[i] = (uint8_t)(i * 3);
+    }
+    fs_update_block("large", data, sizeof(data));
+    CHECK(test_matches("large", data, sizeof(data)));
+    CHECK(test_file_size("large") == sizeof(data));
+    data[100] ^= 0xFF;
+    fs_update_block("large", data, sizeof(data));
+    CHECK(test_matches("large", data, sizeof(data)));
+    CHECK(test_file_size("large") == sizeof(data));
+
+    // The largest journaled block still gets its header
+    fs_update_block("largest", data, TEST_MAX_BLOCK_SIZE);
+    CHECK(test_file_size("largest") == TEST_HEADER_SIZE + TEST_MAX_BLOCK_SIZE);
+
+    // Blocks larger than the header's 16-bit image size could describe round trip intact, rather than having their
+    // tail replayed as journal records
+    size_t   huge_size = 70000;
+    uint8_t *huge      = malloc(huge_size);
+    uint8_t *readback  = malloc(huge_size);
+    for (size_t i = 0; i < huge_size; ++i) {
+        huge[i] = (uint8_t)(i ^ (i >> 8));
+    }
+    fs_update_block("huge", huge, huge_size);
+    CHECK(test_file_size("huge") == (fs_offset_t)huge_size);
+    CHECK(fs_read_block("huge", readback, huge_size) == huge_size && memcmp(readback, huge, huge_size) == 0);
+    free(readback);
+    free(huge);
+}
+
+static void test_journal_growth_and_compaction(void) {
+    uint8_t data[64] = {0};
+    fs_update_block("journal", data, sizeof(data));
+    fs_offset_t image_size = TEST_HEADER_SIZE + sizeof(data);
+    CHECK(test_file_size("journal") == image_size);
+
+    // Single-byte changes are appended as records rather than rewriting the image
+    data[10] = 1;
+    fs_update_block("journal", data, sizeof(data));
+    CHECK(test_matches("journal", data, sizeof(data)));
+    CHECK(test_file_size("journal") == image_size + TEST_RECORD_SIZE + 1);
+
+    // Nearby changes share a record, distant ones get their own
+    data[11] = 2;
+    data[13] = 3;
+    data[60] = 4;
+    fs_update_block("journal", data, sizeof(data));
+    CHECK(test_matches("journal", data, sizeof(data)));
+    CHECK(test_file_size("journal") == image_size + (TEST_RECORD_SIZE + 1) + (TEST_RECORD_SIZE + 3) + (TEST_RECORD_SIZE + 1));
+
+    // Keep going until the journal passes the threshold, and the file is compacted back down to the image
+    bool compacted = false;
+    for (int n = 0; n < 100 && !compacted; ++n) {
+        data[(n * 13) % sizeof(data)] ^= 0x5A;
+        fs_offset_t before = test_file_size("journal");
+        fs_update_block("journal", data, sizeof(data));
+        CHECK(test_matches("journal", data, sizeof(data)));
+        fs_offset_t after = test_file_size("journal");
+        CHECK(after <= image_size + TEST_COMPACT_THRESHOLD);
+        compacted = after < before;
+    }
+    CHECK(compacted);
+    CHECK(test_file_size("journal") == image_size);
+    CHECK(test_matches("journal", data, sizeof(data)));
+}
+
+typedef struct test_stream_state_t {
+    size_t count;
+    size_t stop_after;
+    bool   ok;
+} test_stream_state_t;
+
+static bool test_stream_cb(const void *record, size_t offset, void *user_data) {
+    test_stream_state_t *state = (test_stream_state_t *)user_data;
+    uint32_t             value;
+    memcpy(&value, record, sizeof(value));
+    // Each record holds its own index
+    state->ok = state->ok && value == offset / sizeof(value);
+    return ++state->count != state->stop_after;
+}
+
+static void test_append_and_stream(void) {
+    uint32_t values[12];
+    for (uint32_t i = 0; i < 12; ++i) {
+        values[i] = i;
+    }
+
+    // Appending needs a journaled file to extend
+    CHECK(!fs_append_block("records", &values[0], sizeof(values[0])));
+    fs_update_block("records", values, 4 * sizeof(values[0]));
+    for (int i = 4; i < 12; i += 2) {
+        CHECK(fs_append_block("records", &values[i], 2 * sizeof(values[0])));
+    }
+    CHECK(test_matches("records", values, sizeof(values)));
+
+    fs_block_reader_t reader;
+    CHECK(fs_block_reader_open(&reader, "records"));
+    CHECK(fs_block_reader_size(&reader) == sizeof(values));
+
+    // Windows spanning the base image and the appended records
+    uint32_t window[3];
+    CHECK(fs_block_reader_read(&reader, 3 * sizeof(uint32_t), window, sizeof(window)) == sizeof(window));
+    CHECK(memcmp(window, &values[3], sizeof(window)) == 0);
+    CHECK(fs_block_reader_read(&reader, sizeof(values), window, sizeof(window)) == 0);
+
+    // Every record, in order, then from part-way through, then stopping early
+    test_stream_state_t state = {.ok = true};
+    CHECK(fs_block_reader_stream(&reader, 0, sizeof(uint32_t), test_stream_cb, &state) == 12);
+    CHECK(state.ok && state.count == 12);
+    state = (test_stream_state_t){.ok = true};
+    CHECK(fs_block_reader_stream(&reader, 5 * sizeof(uint32_t), sizeof(uint32_t), test_stream_cb, &state) == 7);
+    CHECK(state.ok && state.count == 7);
+    state = (test_stream_state_t){.stop_after = 3, .ok = true};
+    CHECK(fs_block_reader_stream(&reader, 0, sizeof(uint32_t), test_stream_cb, &state) == 3);
+    CHECK(state.ok && state.count == 3);
+
+    // Records larger than the stream's buffer are refused
+    CHECK(fs_block_reader_stream(&reader, 0, 64, test_stream_cb, &state) == -1);
+    fs_block_reader_close(&reader);
+
+    // Updating the whole image over the appended records
+    values[7] = 0xFFFFFFFF;
+    fs_update_block("records", values, sizeof(values));
+    CHECK(test_matches("records", values, sizeof(values)));
+}
+
+static void test_torn_records(void) {
+    uint8_t data[32] = {0};
+    fs_update_block("torn", data, sizeof(data));
+    data[4] = 0x11;
+    fs_update_block("torn", data, sizeof(data));
+
+    // A record whose data was cut short is ignored, along with anything after it
+    static const uint8_t torn[] = {0x08, 0x00, 0x04, 0x00, 0x22, 0x22};
+    test_write_raw("torn", torn, sizeof(torn), true);
+    CHECK(test_matches("torn", data, sizeof(data)));
+
+    // The next update can't append after the torn record, so it rewrites the file instead
+    data[8] = 0x33;
+    fs_update_block("torn", data, sizeof(data));
+    CHECK(test_matches("torn", data, sizeof(data)));
+    CHECK(test_file_size("torn") == TEST_HEADER_SIZE + sizeof(data));
+
+    // Likewise a record header cut short, which also stops anything being appended until the file is rewritten
+    data[0] = 0x44;
+    fs_update_block("torn", data, sizeof(data));
+    static const uint8_t short_header[] = {0x00, 0x00};
+    test_write_raw("torn", short_header, sizeof(short_header), true);
+    CHECK(test_matches("torn", data, sizeof(data)));
+    CHECK(!fs_append_block("torn", data, 1));
+
+    // Records which are empty, or start past the end of the image, are ignored as corrupt
+    static const uint8_t empty_record[]    = {0x04, 0x00, 0x00, 0x00};
+    static const uint8_t past_end_record[] = {0x40, 0x00, 0x01, 0x00, 0x55};
+    fs_update_block("corrupt_empty", data, sizeof(data));
+    test_write_raw("corrupt_empty", empty_record, sizeof(empty_record), true);
+    CHECK(test_matches("corrupt_empty", data, sizeof(data)));
+    fs_update_block("corrupt_past_end", data, sizeof(data));
+    test_write_raw("corrupt_past_end", past_end_record, sizeof(past_end_record), true);
+    CHECK(test_matches("corrupt_past_end", data, sizeof(data)));
+}
+
+int main(void) {
+    fs_host_image_erase();
+    if (!fs_init() || !fs_format()) {
+        fprintf(stderr, "could not initialise filesystem\n");
+        return 1;
+    }
+
+    test_round_trip();
+    test_plain_images();
+    test_large_blocks();
+    test_journal_growth_and_compaction();
+    test_append_and_stream();
+    test_torn_records();
+
+    fs_host_image_detach();
+    if (test_failures) {
+        printf("%d checks failed\n", test_failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,32 @@
+// Copyright 2025-2026 Nick Brassel (@tzarc)
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+// Stand-in for QMK_KEYBOARD_H, and the handful of QMK facilities used by the filesystem module, for host-side builds.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// QMK's dprintf() goes to the console, glibc's writes to a file descriptor
+#define dprintf printf
+
+#if defined(__GLIBC__) && (__GLIBC__ == 2) && (__GLIBC_MINOR__ < 38)
+size_t strlcpy(char *dst, const char *src, size_t size);
+size_t strlcat(char *dst, const char *src, size_t size);
+#endif
+
+typedef struct keyevent_t {
+    bool pressed;
+} keyevent_t;
+
+typedef struct keyrecord_t {
+    keyevent_t event;
+} keyrecord_t;
+
+enum host_keycodes {
+    FS_DUMP = 0x7E00,
+};
+
+bool process_record_filesystem_kb(uint16_t keycode, keyrecord_t *record);
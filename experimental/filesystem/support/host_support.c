@@ -0,0 +1,27 @@
+// Copyright 2025-2026 Nick Brassel (@tzarc)
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "host_keyboard.h"
+
+#if defined(__GLIBC__) && (__GLIBC__ == 2) && (__GLIBC_MINOR__ < 38)
+size_t strlcpy(char *dst, const char *src, size_t size) {
+    size_t len = strlen(src);
+    if (size > 0) {
+        size_t n = len >= size ? size - 1 : len;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return len;
+}
+
+size_t strlcat(char *dst, const char *src, size_t size) {
+    size_t len = strnlen(dst, size);
+    if (len == size) {
+        return len + strlen(src);
+    }
+    return len + strlcpy(dst + len, src, size - len);
+}
+#endif
+
+bool process_record_filesystem_kb(uint16_t keycode, keyrecord_t *record) {
+    return true;
+}
@@ -0,0 +1,85 @@
+#!/usr/bin/env python3
+# Copyright 2025-2026 Nick Brassel (@tzarc)
+# SPDX-License-Identifier: GPL-2.0-or-later
+
+# Builds a read-only asset pack for FILESYSTEM_ASSETS, as laid out in ../fs_asset_pack.h. Files given directly are
+# named after their basename, and files within directories after their path relative to that directory. The output is
+# flashed to the asset partition as-is.
+
+import argparse
+import struct
+import sys
+from pathlib import Path
+
+FS_ASSET_PACK_MAGIC = 0x50414651
+FS_ASSET_PACK_VERSION = 1
+FS_ASSET_NAME_MAX = 23
+FS_ASSET_PACK_ALIGN = 4
+
+HEADER = struct.Struct("<IHHII")
+ENTRY = struct.Struct(f"<{FS_ASSET_NAME_MAX + 1}sII")
+
+
+def collect(inputs: list[Path]) -> dict[bytes, Path]:
+    assets = {}
+    for item in inputs:
+        if item.is_dir():
+            files = [(f.relative_to(item).as_posix(), f) for f in sorted(item.rglob("*")) if f.is_file()]
+        else:
+            files = [(item.name, item)]
+        for name, path in files:
+            encoded = name.encode("utf-8")
+            if not encoded or len(encoded) > FS_ASSET_NAME_MAX:
+                raise ValueError(f"{path}: name '{name}' must be 1-{FS_ASSET_NAME_MAX} bytes")
+            if encoded in assets:
+                raise ValueError(f"{path}: duplicate name '{name}', also {assets[encoded]}")
+            assets[encoded] = path
+    return assets
+
+
+def align(offset: int) -> int:
+    return (offset + FS_ASSET_PACK_ALIGN - 1) & ~(FS_ASSET_PACK_ALIGN - 1)
+
+
+def build(assets: dict[bytes, Path]) -> bytes:
+    # Sorted bytewise, matching strcmp() in the firmware's binary search
+    names = sorted(assets)
+    if len(names) > 0xFFFF:
+        raise ValueError("too many assets")
+
+    base = HEADER.size + ENTRY.size * len(names)
+    index = bytearray()
+    payloads = bytearray()
+    for name in names:
+        data = assets[name].read_bytes()
+        payloads += bytes(align(base + len(payloads)) - base - len(payloads))
+        index += ENTRY.pack(name, base + len(payloads), len(data))
+        payloads += data
+
+    header = HEADER.pack(FS_ASSET_PACK_MAGIC, FS_ASSET_PACK_VERSION, len(names), base + len(payloads), 0)
+    return header + bytes(index) + bytes(payloads)
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description="Build a read-only asset pack for the filesystem module")
+    parser.add_argument("-o", "--output", type=Path, required=True, help="pack to write")
+    parser.add_argument("--max-size", type=int, default=0, help="fail if the pack exceeds this many bytes, e.g. FS_ASSETS_FLASH_SIZE")
+    parser.add_argument("inputs", type=Path, nargs="+", help="files, or directories of files, to include")
+    args = parser.parse_args()
+
+    try:
+        pack = build(collect(args.inputs))
+    except (OSError, ValueError) as e:
+        print(f"error: {e}", file=sys.stderr)
+        return 1
+    if args.max_size and len(pack) > args.max_size:
+        print(f"error: pack is {len(pack)} bytes, limit is {args.max_size}", file=sys.stderr)
+        return 1
+
+    args.output.write_bytes(pack)
+    print(f"{args.output}: {len(pack)} bytes")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
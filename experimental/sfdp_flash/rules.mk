@@ -0,0 +1,5 @@
+# Copyright 2025-2026 Nick Brassel (@tzarc)
+# SPDX-License-Identifier: GPL-2.0-or-later
+
+# Lets other modules detect this one, e.g. the filesystem's lfs_flash driver uses its flash routines when present
+OPT_DEFS += -DSFDP_FLASH_ENABLE
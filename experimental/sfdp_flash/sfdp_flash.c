@@ -6,10 +6,19 @@
 
 #    include <stdbool.h>
 #    include <stdint.h>
+#    include <string.h>
 #    include "spi_master.h"
+#    include "timer.h"
+#    include "wait.h"
+#    ifdef PROTOCOL_CHIBIOS
+#        include <ch.h>
+#    endif
 #    include "flash_spi.h"
 #    include "sfdp_flash.h"
 #    include "sfdp_flash_params.h"
+#    ifdef FILESYSTEM_ENABLE
+#        include "filesystem.h"
+#    endif
 
 #    ifndef CMD_GET_JEDEC_ID
 #        define CMD_GET_JEDEC_ID 0x9F
@@ -19,27 +28,164 @@
 #        define CMD_ENTER_SFDP_MODE 0x5A
 #    endif
 
+#    ifndef CMD_READ_STATUS
+#        define CMD_READ_STATUS 0x05
+#    endif
+
+#    ifndef CMD_WRITE_ENABLE
+#        define CMD_WRITE_ENABLE 0x06
+#    endif
+
+#    ifndef CMD_PAGE_PROGRAM
+#        define CMD_PAGE_PROGRAM 0x02
+#    endif
+
+#    ifndef CMD_PAGE_PROGRAM_4BYTE
+#        define CMD_PAGE_PROGRAM_4BYTE 0x12
+#    endif
+
 #    ifndef DUMMY_DATA
 #        define DUMMY_DATA 0xFF
 #    endif
 
+#    define SR_WIP 0x01
+
+// Configurable: Widest address/data path the SPI controller can drive, anything above 1 requires sfdp_bus_read() to be
+// overridden
+#    ifndef SFDP_FLASH_BUS_LANES
+#        define SFDP_FLASH_BUS_LANES 1
+#    endif
+
+// Configurable: Longest time to wait for an erase to complete, in milliseconds -- 64kB erases can take seconds
+#    ifndef SFDP_FLASH_ERASE_TIMEOUT
+#        define SFDP_FLASH_ERASE_TIMEOUT 3000
+#    endif
+
+// Configurable: Time slept between status polls while an erase is in progress, in milliseconds -- sleeping lets other
+// threads run instead of spinning for the tens of milliseconds a sector erase takes, 0 spins
+#    ifndef SFDP_FLASH_BUSY_POLL_INTERVAL
+#        define SFDP_FLASH_BUSY_POLL_INTERVAL 1
+#    endif
+
+// Configurable: Single-lane read command, set to 0x0B and 8 wait states if the SPI clock exceeds the device's limit
+// for normal reads
+#    ifndef SFDP_FLASH_1_1_1_READ_OPCODE
+#        define SFDP_FLASH_1_1_1_READ_OPCODE 0x03
+#    endif
+#    ifndef SFDP_FLASH_1_1_1_WAIT_STATES
+#        define SFDP_FLASH_1_1_1_WAIT_STATES 0
+#    endif
+
+// Configurable: Parameter headers fetched along with the SFDP header, any beyond this are ignored
+#    ifndef SFDP_FLASH_MAX_PARAMETER_HEADERS
+#        define SFDP_FLASH_MAX_PARAMETER_HEADERS 8
+#    endif
+
+// Configurable: DWORDs fetched from each parameter table, JESD216F defines 23 for the basic flash parameter table
+#    ifndef SFDP_FLASH_MAX_TABLE_DWORDS
+#        define SFDP_FLASH_MAX_TABLE_DWORDS 23
+#    endif
+
+_Static_assert(SFDP_FLASH_BUS_LANES == 1 || SFDP_FLASH_BUS_LANES == 2 || SFDP_FLASH_BUS_LANES == 4, "SFDP_FLASH_BUS_LANES must be 1, 2 or 4");
+
 typedef struct sfdp_runtime_t {
-    bool was_checked;
-    bool is_supported;
-    bool supports_1_1_2_fastread;
-    bool supports_1_2_2_fastread;
-    bool supports_1_4_4_fastread;
-    bool supports_1_1_4_fastread;
-    bool supports_2_2_2_fastread;
-    bool supports_4_4_4_fastread;
+    bool              was_checked;
+    bool              is_supported;
+    bool              supports_1_1_2_fastread;
+    bool              supports_1_2_2_fastread;
+    bool              supports_1_4_4_fastread;
+    bool              supports_1_1_4_fastread;
+    bool              supports_2_2_2_fastread;
+    bool              supports_4_4_4_fastread;
+    uint8_t           read_mode;       // sfdp_read_mode_id_t
+    uint8_t           read_mode_4byte; // sfdp_read_mode_id_t, SFDP_READ_NUM_MODES if none is usable
+    sfdp_descriptor_t desc;
 } sfdp_runtime_t;
 
 sfdp_runtime_t sfdp;
 
+static const sfdp_read_mode_t sfdp_default_read_modes[SFDP_READ_NUM_MODES] = {
+    [SFDP_READ_1_1_1] = {.supported = true, .opcode = SFDP_FLASH_1_1_1_READ_OPCODE, .addr_bytes = EXTERNAL_FLASH_ADDRESS_SIZE, .cmd_lanes = 1, .addr_lanes = 1, .data_lanes = 1, .wait_states = SFDP_FLASH_1_1_1_WAIT_STATES},
+    [SFDP_READ_1_1_2] = {.addr_bytes = EXTERNAL_FLASH_ADDRESS_SIZE, .cmd_lanes = 1, .addr_lanes = 1, .data_lanes = 2},
+    [SFDP_READ_1_2_2] = {.addr_bytes = EXTERNAL_FLASH_ADDRESS_SIZE, .cmd_lanes = 1, .addr_lanes = 2, .data_lanes = 2},
+    [SFDP_READ_2_2_2] = {.addr_bytes = EXTERNAL_FLASH_ADDRESS_SIZE, .cmd_lanes = 2, .addr_lanes = 2, .data_lanes = 2},
+    [SFDP_READ_1_1_4] = {.addr_bytes = EXTERNAL_FLASH_ADDRESS_SIZE, .cmd_lanes = 1, .addr_lanes = 1, .data_lanes = 4},
+    [SFDP_READ_1_4_4] = {.addr_bytes = EXTERNAL_FLASH_ADDRESS_SIZE, .cmd_lanes = 1, .addr_lanes = 4, .data_lanes = 4},
+    [SFDP_READ_4_4_4] = {.addr_bytes = EXTERNAL_FLASH_ADDRESS_SIZE, .cmd_lanes = 4, .addr_lanes = 4, .data_lanes = 4},
+};
+
+// Native 4-byte address forms of the read commands, fixed by JESD216B rather than described by the table
+static const struct {
+    uint32_t insn;
+    uint8_t  opcode;
+} sfdp_read_modes_4byte[SFDP_READ_NUM_MODES] = {
+    [SFDP_READ_1_1_2] = {SFDP_4BYTE_READ_1_1_2, 0x3C},
+    [SFDP_READ_1_2_2] = {SFDP_4BYTE_READ_1_2_2, 0xBC},
+    [SFDP_READ_1_1_4] = {SFDP_4BYTE_READ_1_1_4, 0x6C},
+    [SFDP_READ_1_4_4] = {SFDP_4BYTE_READ_1_4_4, 0xEC},
+};
+
+// Whether an access of `length` bytes at `addr` reaches beyond what `addr_bytes` of address can express
+static bool sfdp_beyond_address_size(uint8_t addr_bytes, uint32_t addr, size_t length) {
+    return addr_bytes < 4 && (uint64_t)addr + length > (1ULL << (addr_bytes * 8));
+}
+
+static void sfdp_set_read_mode(sfdp_read_mode_id_t id, bool supported, uint8_t opcode, uint8_t mode_clocks, uint8_t wait_states) {
+    sfdp_read_mode_t *mode = &sfdp.desc.read_modes[id];
+    mode->supported        = supported;
+    mode->opcode           = opcode;
+    mode->mode_clocks      = mode_clocks;
+    mode->wait_states      = wait_states;
+}
+
 static bool spi_flash_start(void) {
     return spi_start(EXTERNAL_FLASH_SPI_SLAVE_SELECT_PIN, EXTERNAL_FLASH_SPI_LSBFIRST, EXTERNAL_FLASH_SPI_MODE, EXTERNAL_FLASH_SPI_CLOCK_DIVISOR);
 }
 
+static void sfdp_set_erase_type(int n, uint8_t size_shift, uint8_t opcode) {
+    // A size of zero marks the type as unused, the 4-byte opcode comes from a later table
+    sfdp.desc.erase_types[n].size_shift   = size_shift;
+    sfdp.desc.erase_types[n].opcode       = size_shift ? opcode : 0;
+    sfdp.desc.erase_types[n].opcode_4byte = 0;
+}
+
+__attribute__((weak)) void sfdp_flash_busy_yield(bool erasing) {
+#    if (SFDP_FLASH_BUSY_POLL_INTERVAL) > 0
+    if (erasing) {
+        wait_ms(SFDP_FLASH_BUSY_POLL_INTERVAL);
+        return;
+    }
+#    endif
+#    ifdef PROTOCOL_CHIBIOS
+    // Page programs finish in about a millisecond, so sleeping for one would only slow writes down, but other threads
+    // of the same priority can still run in the meantime
+    chThdYield();
+#    endif
+}
+
+static bool spi_flash_wait_while_busy(uint32_t timeout, bool erasing) {
+    uint32_t deadline = timer_read32() + timeout;
+    while (true) {
+        if (!spi_flash_start()) {
+            return false;
+        }
+        spi_write(CMD_READ_STATUS);
+        spi_status_t status = spi_read();
+        spi_stop();
+        if (status < 0) {
+            return false;
+        }
+        if (!(status & SR_WIP)) {
+            return true;
+        }
+        if (timer_expired32(timer_read32(), deadline)) {
+            sfdp_dprintf("timed out waiting for flash\n");
+            return false;
+        }
+        sfdp_flash_busy_yield(erasing);
+    }
+}
+
 static bool read_jedec_id(uint32_t *id) {
     if (!spi_flash_start()) {
         return false;
@@ -89,27 +235,24 @@ static bool read_sfdp_data(uint32_t addr, void *data, size_t length) {
     return true;
 }
 
-bool sfdp_parse_parameter_table(uint32_t table_pointer, size_t length) {
+static void sfdp_parse_basic_table(const sfdp_dword_t *table, size_t length) {
     for (size_t n = 1; n <= length; ++n) {
         union {
-            sfdp_dword_t              d;
-            sfdp_flashparam_dword_1_t p1;
-            sfdp_flashparam_dword_2_t p2;
-            sfdp_flashparam_dword_3_t p3;
-            sfdp_flashparam_dword_4_t p4;
-            sfdp_flashparam_dword_5_t p5;
-            sfdp_flashparam_dword_6_t p6;
-            sfdp_flashparam_dword_7_t p7;
-            sfdp_flashparam_dword_8_t p8;
-            sfdp_flashparam_dword_9_t p9;
+            sfdp_dword_t               d;
+            sfdp_flashparam_dword_1_t  p1;
+            sfdp_flashparam_dword_2_t  p2;
+            sfdp_flashparam_dword_3_t  p3;
+            sfdp_flashparam_dword_4_t  p4;
+            sfdp_flashparam_dword_5_t  p5;
+            sfdp_flashparam_dword_6_t  p6;
+            sfdp_flashparam_dword_7_t  p7;
+            sfdp_flashparam_dword_8_t  p8;
+            sfdp_flashparam_dword_9_t  p9;
+            sfdp_flashparam_dword_11_t p11;
         } param;
         _Static_assert(sizeof(param) == 4, "param size is not 4 bytes");
 
-        bool ok = read_sfdp_data(table_pointer + ((n - 1) * sizeof(sfdp_dword_t)), (void *)&param, sizeof(param));
-        if (!ok) {
-            sfdp_dprintf("flash parameter %d unavailable\n", (int)n);
-            return false;
-        }
+        param.d = table[n - 1];
         sfdp_dprintf("Flash Parameter %d: 0x%08lX\n", (int)n, param.d.u32);
         switch (n) {
             case 1: {
@@ -125,22 +268,27 @@ bool sfdp_parse_parameter_table(uint32_t table_pointer, size_t length) {
                 sfdp.supports_1_2_2_fastread = param.p1.support_1_2_2_fastread;
                 sfdp.supports_1_4_4_fastread = param.p1.support_1_4_4_fastread;
                 sfdp.supports_1_1_4_fastread = param.p1.support_1_1_4_fastread;
+                // Tables predating JESD216A have no page size, so assume the minimum implied by the write granularity
+                sfdp.desc.page_size = param.p1.write_granularity ? 64 : 0;
             } break;
             case 2: {
-                uint32_t bits   = ((param.p2.is_high_density) ? (1 << (param.p2.density)) : (param.p2.density + 1));
-                uint32_t bytes  = bits / 8;
+                uint64_t bits   = ((param.p2.is_high_density) ? ((param.p2.density < 64) ? (1ULL << (param.p2.density)) : 0) : ((uint64_t)param.p2.density + 1));
+                uint64_t bytes  = bits / 8;
                 uint32_t kbytes = bytes / 1024;
                 (void)kbytes;
-                sfdp_dprintf("- Memory density: %d bits (%d bytes, %d kB)\n", (int)bits, (int)bytes, (int)kbytes);
+                sfdp_dprintf("- Memory density: %d kB\n", (int)kbytes);
+                sfdp.desc.density = bytes > UINT32_MAX ? 0 : (uint32_t)bytes; // Beyond 32-bit addressing, treated as unknown
             } break;
             case 3: {
                 if (sfdp.supports_1_1_4_fastread) {
                     sfdp_dprintf("- 1-1-4 fastread wait states: %d, mode bits: %d, read opcode: 0x%02X\n", (int)param.p3.wait_states_1_1_4_fastread, (int)param.p3.num_mode_bits_1_1_4_fastread, (int)param.p3.read_opcode_1_1_4_fastread);
+                    sfdp_set_read_mode(SFDP_READ_1_1_4, true, param.p3.read_opcode_1_1_4_fastread, param.p3.num_mode_bits_1_1_4_fastread, param.p3.wait_states_1_1_4_fastread);
                 } else {
                     sfdp_dprintf("- 1-1-4 fastread not supported\n");
                 }
                 if (sfdp.supports_1_4_4_fastread) {
                     sfdp_dprintf("- 1-4-4 fastread wait states: %d, mode bits: %d, read opcode: 0x%02X\n", (int)param.p3.wait_states_1_4_4_fastread, (int)param.p3.num_mode_bits_1_4_4_fastread, (int)param.p3.read_opcode_1_4_4_fastread);
+                    sfdp_set_read_mode(SFDP_READ_1_4_4, true, param.p3.read_opcode_1_4_4_fastread, param.p3.num_mode_bits_1_4_4_fastread, param.p3.wait_states_1_4_4_fastread);
                 } else {
                     sfdp_dprintf("- 1-4-4 fastread not supported\n");
                 }
@@ -148,11 +296,13 @@ bool sfdp_parse_parameter_table(uint32_t table_pointer, size_t length) {
             case 4: {
                 if (sfdp.supports_1_1_2_fastread) {
                     sfdp_dprintf("- 1-1-2 fastread wait states: %d, mode bits: %d, read opcode: 0x%02X\n", (int)param.p4.wait_states_1_1_2_fastread, (int)param.p4.num_mode_bits_1_1_2_fastread, (int)param.p4.read_opcode_1_1_2_fastread);
+                    sfdp_set_read_mode(SFDP_READ_1_1_2, true, param.p4.read_opcode_1_1_2_fastread, param.p4.num_mode_bits_1_1_2_fastread, param.p4.wait_states_1_1_2_fastread);
                 } else {
                     sfdp_dprintf("- 1-1-2 fastread not supported\n");
                 }
                 if (sfdp.supports_1_2_2_fastread) {
                     sfdp_dprintf("- 1-2-2 fastread wait states: %d, mode bits: %d, read opcode: 0x%02X\n", (int)param.p4.wait_states_1_2_2_fastread, (int)param.p4.num_mode_bits_1_2_2_fastread, (int)param.p4.read_opcode_1_2_2_fastread);
+                    sfdp_set_read_mode(SFDP_READ_1_2_2, true, param.p4.read_opcode_1_2_2_fastread, param.p4.num_mode_bits_1_2_2_fastread, param.p4.wait_states_1_2_2_fastread);
                 } else {
                     sfdp_dprintf("- 1-2-2 fastread not supported\n");
                 }
@@ -166,6 +316,7 @@ bool sfdp_parse_parameter_table(uint32_t table_pointer, size_t length) {
             case 6: {
                 if (sfdp.supports_2_2_2_fastread) {
                     sfdp_dprintf("- 2-2-2 fastread wait states: %d, mode bits: %d, read opcode: 0x%02X\n", (int)param.p6.wait_states_2_2_2_fastread, (int)param.p6.num_mode_bits_2_2_2_fastread, (int)param.p6.read_opcode_2_2_2_fastread);
+                    sfdp_set_read_mode(SFDP_READ_2_2_2, true, param.p6.read_opcode_2_2_2_fastread, param.p6.num_mode_bits_2_2_2_fastread, param.p6.wait_states_2_2_2_fastread);
                 } else {
                     sfdp_dprintf("- 2-2-2 fastread not supported\n");
                 }
@@ -173,6 +324,7 @@ bool sfdp_parse_parameter_table(uint32_t table_pointer, size_t length) {
             case 7: {
                 if (sfdp.supports_4_4_4_fastread) {
                     sfdp_dprintf("- 4-4-4 fastread wait states: %d, mode bits: %d, read opcode: 0x%02X\n", (int)param.p7.wait_states_4_4_4_fastread, (int)param.p7.num_mode_bits_4_4_4_fastread, (int)param.p7.read_opcode_4_4_4_fastread);
+                    sfdp_set_read_mode(SFDP_READ_4_4_4, true, param.p7.read_opcode_4_4_4_fastread, param.p7.num_mode_bits_4_4_4_fastread, param.p7.wait_states_4_4_4_fastread);
                 } else {
                     sfdp_dprintf("- 4-4-4 fastread not supported\n");
                 }
@@ -180,63 +332,561 @@ bool sfdp_parse_parameter_table(uint32_t table_pointer, size_t length) {
             case 8: {
                 sfdp_dprintf("- Sector type 1 size: %d, erase opcode: 0x%02X\n", (int)(1 << param.p8.sector_type_1_size), (int)param.p8.sector_type_1_erase_opcode);
                 sfdp_dprintf("- Sector type 2 size: %d, erase opcode: 0x%02X\n", (int)(1 << param.p8.sector_type_2_size), (int)param.p8.sector_type_2_erase_opcode);
+                sfdp_set_erase_type(0, param.p8.sector_type_1_size, param.p8.sector_type_1_erase_opcode);
+                sfdp_set_erase_type(1, param.p8.sector_type_2_size, param.p8.sector_type_2_erase_opcode);
             } break;
             case 9: {
                 sfdp_dprintf("- Sector type 3 size: %d, erase opcode: 0x%02X\n", (int)(1 << param.p9.sector_type_3_size), (int)param.p9.sector_type_3_erase_opcode);
                 sfdp_dprintf("- Sector type 4 size: %d, erase opcode: 0x%02X\n", (int)(1 << param.p9.sector_type_4_size), (int)param.p9.sector_type_4_erase_opcode);
+                sfdp_set_erase_type(2, param.p9.sector_type_3_size, param.p9.sector_type_3_erase_opcode);
+                sfdp_set_erase_type(3, param.p9.sector_type_4_size, param.p9.sector_type_4_erase_opcode);
             } break;
+            case 11: {
+                sfdp_dprintf("- Page size: %d\n", (int)(1 << param.p11.page_size));
+                sfdp.desc.page_size = 1 << param.p11.page_size;
+            } break;
+        }
+    }
+}
+
+static void sfdp_parse_4byte_table(const sfdp_dword_t *table, size_t length) {
+    if (length < 2) {
+        sfdp_dprintf("4-byte address table truncated\n");
+        return;
+    }
+    sfdp_4byte_dword_2_t opcodes = {.dword = table[1]};
+    sfdp.desc.insns_4byte        = table[0].u32;
+    sfdp_dprintf("4-byte address instructions: 0x%08lX, erase opcodes: 0x%08lX\n", table[0].u32, table[1].u32);
+
+    const uint8_t erase_opcodes[SFDP_NUM_ERASE_TYPES] = {opcodes.erase_type_1_opcode, opcodes.erase_type_2_opcode, opcodes.erase_type_3_opcode, opcodes.erase_type_4_opcode};
+    for (int n = 0; n < SFDP_NUM_ERASE_TYPES; ++n) {
+        // DWORD 1 bits 9-12 flag erase types 1-4
+        if (sfdp.desc.erase_types[n].size_shift && (table[0].u32 & (1UL << (9 + n)))) {
+            sfdp.desc.erase_types[n].opcode_4byte = erase_opcodes[n];
+        }
+    }
+}
+
+// Issues a sector map configuration detection command, returning whether the masked bit was set
+static bool sfdp_detect_config_bit(const sfdp_sector_map_command_t *command, uint32_t addr, bool *bit) {
+    // spi_master can only clock out whole bytes of dummy cycles, and variable latency can't be known up front
+    static const uint8_t addr_bytes[] = {0, 3, 4, EXTERNAL_FLASH_ADDRESS_SIZE};
+    if (command->read_latency == 0xF || command->read_latency % 8 != 0) {
+        return false;
+    }
+
+    uint8_t cmd[1 + 4 + 1];
+    size_t  n = 0;
+    cmd[n++]  = command->opcode;
+    for (int i = addr_bytes[command->address_length] - 1; i >= 0; --i) {
+        cmd[n++] = (addr >> (i * 8)) & 0xFF;
+    }
+    if (command->read_latency) {
+        cmd[n++] = DUMMY_DATA;
+    }
+
+    if (!spi_flash_start()) {
+        return false;
+    }
+    uint8_t value = 0;
+    bool    ok    = spi_transmit(cmd, n) >= 0 && spi_receive(&value, 1) >= 0;
+    spi_stop();
+    *bit = (value & command->read_data_mask) != 0;
+    return ok;
+}
+
+static void sfdp_parse_sector_map(const sfdp_dword_t *table, size_t length) {
+    // Detection commands come first, each supplying one bit of the configuration ID, most significant first
+    uint8_t config_id = 0;
+    bool    detected  = true;
+    size_t  n         = 0;
+    bool    commands  = false;
+    while (n + 1 < length) {
+        sfdp_sector_map_command_t command = {.dword = table[n]};
+        if (command.is_map) {
+            break;
+        }
+        bool bit;
+        detected = detected && sfdp_detect_config_bit(&command, table[n + 1].u32, &bit);
+        config_id = (config_id << 1) | (detected && bit);
+        commands  = true;
+        n += 2;
+    }
+    sfdp_dprintf("Sector map configuration: %d%s\n", (int)config_id, detected ? "" : " (detection failed)");
+
+    // Then one map per configuration
+    uint8_t common   = 0x0F; // Erase types usable in every region of every map
+    bool    selected = false;
+    while (n < length) {
+        sfdp_sector_map_header_t header = {.dword = table[n]};
+        size_t                   count  = header.region_count + 1;
+        if (!header.is_map || n + 1 + count > length) {
+            sfdp_dprintf("sector map truncated\n");
+            break;
+        }
+        // Without detection commands there is a single map
+        bool use = detected && !selected && (!commands || header.config_id == config_id) && count <= SFDP_MAX_SECTOR_REGIONS;
+        for (size_t r = 0; r < count; ++r) {
+            sfdp_sector_map_region_t region = {.dword = table[n + 1 + r]};
+            sfdp_dprintf("- Configuration %d region %d: %lu bytes, erase types 0x%X\n", (int)header.config_id, (int)r, (uint32_t)(region.size + 1) * 256, (int)region.erase_types);
+            common &= region.erase_types;
+            if (use) {
+                sfdp.desc.sector_regions[r].size        = (uint32_t)(region.size + 1) * 256;
+                sfdp.desc.sector_regions[r].erase_types = region.erase_types;
+            }
+        }
+        if (use) {
+            sfdp.desc.num_sector_regions = count;
+            selected                     = true;
+        }
+        n += 1 + count;
+        if (header.end_of_sequence) {
+            break;
+        }
+    }
+
+    if (!selected) {
+        // The map in use is unknown, so only erase types which are usable everywhere are safe
+        sfdp_dprintf("sector map unusable, limiting erase types to 0x%X\n", (int)common);
+        sfdp.desc.num_sector_regions = 0;
+        for (int t = 0; t < SFDP_NUM_ERASE_TYPES; ++t) {
+            if (!(common & (1 << t))) {
+                memset(&sfdp.desc.erase_types[t], 0, sizeof(sfdp.desc.erase_types[t]));
+            }
+        }
+    }
+}
+
+// Reads the SFDP header and parameter headers in one transaction, then each parameter table of interest in another
+static bool sfdp_discover(void) {
+    struct __attribute__((packed)) {
+        sfdp_header_t           header;
+        sfdp_parameter_header_t params[SFDP_FLASH_MAX_PARAMETER_HEADERS];
+    } headers;
+    bool ok = read_sfdp_data(0, (void *)&headers, sizeof(headers));
+    if (!ok || headers.header.reserved_0xFF != 0xFF) {
+        sfdp_dprintf("header unavailable\n");
+        return false;
+    }
+    sfdp_dprintf("Signature: 0x%08lX, SFDP rev %d.%d, header count: %d\n", headers.header.signature, (int)headers.header.sfdp_major, (int)headers.header.sfdp_minor, (int)(headers.header.header_count + 1));
+
+    if (headers.header.signature != 0x50444653) { // "SFDP"
+        sfdp_dprintf("not supported\n");
+        return false;
+    }
+
+    size_t header_count = headers.header.header_count + 1;
+    if (header_count > SFDP_FLASH_MAX_PARAMETER_HEADERS) {
+        sfdp_dprintf("ignoring %d parameter headers\n", (int)(header_count - SFDP_FLASH_MAX_PARAMETER_HEADERS));
+        header_count = SFDP_FLASH_MAX_PARAMETER_HEADERS;
+    }
+
+    bool sector_map = false;
+    for (size_t n = 0; n < header_count; ++n) {
+        const sfdp_parameter_header_t *param = &headers.params[n];
+        uint16_t                       id    = ((uint16_t)param->id_msb << 8) | param->jedec_id;
+        sfdp_dprintf("Parameter header %d A: 0x%08lX, B: 0x%08lX\n", (int)n, param->a.u32, param->b.u32);
+        sfdp_dprintf("- Parameter ID: 0x%04X, param rev %d.%d, parameter length: %d\n", (int)id, (int)param->major, (int)param->minor, (int)param->length);
+        sfdp_dprintf("- Parameter table pointer: 0x%08lX\n", (uint32_t)(param->table_pointer));
+
+        // The first header is always the basic flash parameter table, later revisions of it and vendor tables are skipped
+        if (n == 0 ? param->id_msb != 0xFF : (id != SFDP_PARAMETER_ID_4BYTE_ADDRESS && id != SFDP_PARAMETER_ID_SECTOR_MAP)) {
+            if (n == 0) {
+                sfdp_dprintf("SFDP parameter header %d unavailable\n", (int)n);
+                return false;
+            }
+            continue;
+        }
+
+        sfdp_dword_t table[SFDP_FLASH_MAX_TABLE_DWORDS];
+        size_t       length = param->length < SFDP_FLASH_MAX_TABLE_DWORDS ? param->length : SFDP_FLASH_MAX_TABLE_DWORDS;
+        if (!read_sfdp_data(param->table_pointer, (void *)table, length * sizeof(sfdp_dword_t))) {
+            sfdp_dprintf("flash parameters unavailable\n");
+            return false;
+        }
+        if (n == 0) {
+            sfdp_parse_basic_table(table, length);
+        } else if (id == SFDP_PARAMETER_ID_4BYTE_ADDRESS) {
+            sfdp_parse_4byte_table(table, length);
+        } else if (!sector_map) {
+            sfdp_parse_sector_map(table, length);
+            sector_map = true;
         }
     }
     return true;
 }
 
+static void sfdp_reset_descriptor(uint32_t jedec_id) {
+    memset(&sfdp.desc, 0, sizeof(sfdp.desc));
+    sfdp.desc.version  = SFDP_DESCRIPTOR_VERSION;
+    sfdp.desc.jedec_id = jedec_id;
+    memcpy(sfdp.desc.read_modes, sfdp_default_read_modes, sizeof(sfdp.desc.read_modes));
+}
+
+__attribute__((weak)) bool sfdp_descriptor_load(uint32_t jedec_id, sfdp_descriptor_t *descriptor) {
+    return false;
+}
+
+__attribute__((weak)) void sfdp_descriptor_store(const sfdp_descriptor_t *descriptor) {}
+
 bool sfdp_init(void) {
     if (!sfdp.was_checked) {
-        // sfdp.was_checked = true;
         spi_init();
+        sfdp.is_supported    = false;
+        sfdp.read_mode       = SFDP_READ_1_1_1;
+        sfdp.read_mode_4byte = SFDP_READ_NUM_MODES;
+        sfdp_reset_descriptor(0);
 
         uint32_t jedec_id;
         bool     ok = read_jedec_id(&jedec_id);
-        if (!ok) {
+        if (!ok || jedec_id == 0 || jedec_id == 0xFFFFFF) {
+            // Not cached, the device may not have been ready
             sfdp_dprintf("JEDEC ID unavailable\n");
             return false;
         }
         sfdp_dprintf("JEDEC ID: 0x%06lX\n", jedec_id);
+        sfdp.was_checked = true;
 
-        sfdp_header_t sfdp_header;
-        ok = read_sfdp_data(0, (void *)&sfdp_header, sizeof(sfdp_header));
-        if (!ok || sfdp_header.reserved_0xFF != 0xFF) {
-            sfdp_dprintf("header unavailable\n");
-            return false;
+        if (sfdp_descriptor_load(jedec_id, &sfdp.desc) && sfdp.desc.version == SFDP_DESCRIPTOR_VERSION && sfdp.desc.jedec_id == jedec_id) {
+            sfdp_dprintf("using stored parameters\n");
+            // Comes from configuration rather than the device, so may have changed since it was stored
+            sfdp.desc.read_modes[SFDP_READ_1_1_1] = sfdp_default_read_modes[SFDP_READ_1_1_1];
+        } else {
+            sfdp_reset_descriptor(jedec_id);
+            if (!sfdp_discover()) {
+                return false;
+            }
+            sfdp_descriptor_store(&sfdp.desc);
         }
-        sfdp_dprintf("Signature: 0x%08lX, SFDP rev %d.%d, header count: %d\n", sfdp_header.signature, (int)sfdp_header.sfdp_major, (int)sfdp_header.sfdp_minor, (int)(sfdp_header.header_count + 1));
 
-        if (sfdp_header.signature != 0x50444653) { // "SFDP"
-            sfdp_dprintf("not supported\n");
-            return false;
+        sfdp.is_supported = true;
+        sfdp_select_read_mode(SFDP_FLASH_BUS_LANES);
+    }
+
+    return sfdp.is_supported;
+}
+
+void sfdp_reset(void) {
+    sfdp.was_checked  = false;
+    sfdp.is_supported = false;
+}
+
+const sfdp_descriptor_t *sfdp_get_descriptor(void) {
+    return sfdp.is_supported ? &sfdp.desc : NULL;
+}
+
+const sfdp_read_mode_t *sfdp_get_read_mode(sfdp_read_mode_id_t id) {
+    return &sfdp.desc.read_modes[id];
+}
+
+// Clocks taken by a read of `length` bytes, from the start of the opcode to the end of the data
+static uint32_t sfdp_read_mode_clocks(const sfdp_read_mode_t *mode, uint32_t length) {
+    return (8 / mode->cmd_lanes) + (mode->addr_bytes * 8 / mode->addr_lanes) + mode->mode_clocks + mode->wait_states + (length * 8 / mode->data_lanes);
+}
+
+// Native 4-byte address form of a read command, false if the device has none
+static bool sfdp_get_read_mode_4byte(sfdp_read_mode_id_t id, sfdp_read_mode_t *mode) {
+    *mode = sfdp.desc.read_modes[id];
+    if (!mode->supported) {
+        return false;
+    }
+    uint32_t insn   = sfdp_read_modes_4byte[id].insn;
+    uint8_t  opcode = sfdp_read_modes_4byte[id].opcode;
+    if (id == SFDP_READ_1_1_1) {
+        // Depends on whether the configured single-lane read is the normal or the fast read
+        insn   = mode->opcode == 0x03 ? SFDP_4BYTE_READ_1_1_1 : mode->opcode == 0x0B ? SFDP_4BYTE_FAST_READ_1_1_1 : 0;
+        opcode = mode->opcode == 0x03 ? 0x13 : 0x0C;
+    }
+    if (!insn || !(sfdp.desc.insns_4byte & insn)) {
+        return false;
+    }
+    mode->opcode     = opcode;
+    mode->addr_bytes = 4;
+    return true;
+}
+
+// Fastest usable read command, in its native 4-byte address form if requested; SFDP_READ_NUM_MODES if none
+static sfdp_read_mode_id_t sfdp_pick_read_mode(uint8_t max_lanes, bool native_4byte, uint32_t *best_clocks) {
+    sfdp_read_mode_id_t best = SFDP_READ_NUM_MODES;
+    for (sfdp_read_mode_id_t id = SFDP_READ_1_1_1; id < SFDP_READ_NUM_MODES; ++id) {
+        sfdp_read_mode_t mode = sfdp.desc.read_modes[id];
+        if (native_4byte && !sfdp_get_read_mode_4byte(id, &mode)) {
+            continue;
         }
+        if (!mode.supported || mode.cmd_lanes != 1 || mode.data_lanes > max_lanes) {
+            continue;
+        }
+        uint32_t clocks = sfdp_read_mode_clocks(&mode, EXTERNAL_FLASH_PAGE_SIZE);
+        if (best == SFDP_READ_NUM_MODES || clocks < *best_clocks) {
+            best         = id;
+            *best_clocks = clocks;
+        }
+    }
+    return best;
+}
 
-        for (size_t n = 0; n < (size_t)(sfdp_header.header_count + 1); ++n) {
-            sfdp_parameter_header_t param;
-            ok = read_sfdp_data(sizeof(sfdp_header) + (n * sizeof(sfdp_parameter_header_t)), (void *)&param, sizeof(param));
-            if (!ok || param.reserved_0xFF != 0xFF) {
-                sfdp_dprintf("SFDP parameter header %d unavailable\n", (int)n);
-                return false;
+sfdp_read_mode_id_t sfdp_select_read_mode(uint8_t max_lanes) {
+    uint32_t            best_clocks = 0;
+    sfdp_read_mode_id_t best        = sfdp_pick_read_mode(max_lanes, false, &best_clocks); // 1-1-1 is always usable
+    sfdp_dprintf("Selected read opcode 0x%02X, %d clocks per page\n", (int)sfdp.desc.read_modes[best].opcode, (int)best_clocks);
+    sfdp.read_mode       = best;
+    sfdp.read_mode_4byte = SFDP_READ_NUM_MODES;
+    if (sfdp_beyond_address_size(EXTERNAL_FLASH_ADDRESS_SIZE, 0, sfdp.desc.density)) {
+        sfdp.read_mode_4byte = sfdp_pick_read_mode(max_lanes, true, &best_clocks);
+        if (sfdp.read_mode_4byte != SFDP_READ_NUM_MODES) {
+            sfdp_dprintf("Selected 4-byte address read for %s, %d clocks per page\n", sfdp.read_mode_4byte == best ? "the same command" : "another command", (int)best_clocks);
+        }
+    }
+    return best;
+}
+
+__attribute__((weak)) bool sfdp_bus_read(const sfdp_read_mode_t *mode, uint32_t addr, void *data, size_t length) {
+    // spi_master only drives a single lane, and can only clock out whole bytes of dummy cycles
+    uint8_t dummy_clocks = mode->mode_clocks + mode->wait_states;
+    if (mode->cmd_lanes != 1 || mode->addr_lanes != 1 || mode->data_lanes != 1 || dummy_clocks % 8 != 0 || mode->addr_bytes > 4) {
+        return false;
+    }
+
+    uint8_t cmd[1 + 4 + 32 / 8];
+    size_t  n = 0;
+    cmd[n++]  = mode->opcode;
+    for (int i = mode->addr_bytes - 1; i >= 0; --i) {
+        cmd[n++] = (addr >> (i * 8)) & 0xFF;
+    }
+    for (uint8_t i = 0; i < dummy_clocks / 8 && n < sizeof(cmd); ++i) {
+        cmd[n++] = DUMMY_DATA;
+    }
+
+    if (!spi_flash_start()) {
+        return false;
+    }
+    bool ok = spi_transmit(cmd, n) >= 0;
+    for (uint8_t *p = data; ok && length > 0;) {
+        uint16_t chunk = length > UINT16_MAX ? UINT16_MAX : length;
+        ok             = spi_receive(p, chunk) >= 0;
+        p += chunk;
+        length -= chunk;
+    }
+    spi_stop();
+    return ok;
+}
+
+flash_status_t sfdp_flash_read_range(uint32_t addr, void *data, size_t length) {
+    if (sfdp.is_supported && spi_flash_wait_while_busy(EXTERNAL_FLASH_SPI_TIMEOUT, false)) {
+        sfdp_read_mode_t mode = sfdp.desc.read_modes[sfdp.read_mode];
+        bool             ok   = true;
+        if (sfdp_beyond_address_size(mode.addr_bytes, addr, length)) {
+            ok = sfdp.read_mode_4byte != SFDP_READ_NUM_MODES && sfdp_get_read_mode_4byte(sfdp.read_mode_4byte, &mode);
+        }
+        if (ok && sfdp_bus_read(&mode, addr, data, length)) {
+            return FLASH_STATUS_SUCCESS;
+        }
+    }
+    return flash_read_range(addr, data, length);
+}
+
+flash_status_t sfdp_flash_write_range(uint32_t addr, const void *data, size_t length) {
+    if (!sfdp.is_supported) {
+        return flash_write_range(addr, data, length);
+    }
+
+    uint32_t       page_size = sfdp.desc.page_size ? sfdp.desc.page_size : EXTERNAL_FLASH_PAGE_SIZE;
+    const uint8_t *p         = data;
+    while (length > 0) {
+        // Programs wrap within a page, so each command must stop at the page boundary
+        size_t chunk = page_size - addr % page_size;
+        if (chunk > length) {
+            chunk = length;
+        }
+        bool native_4byte = sfdp_beyond_address_size(EXTERNAL_FLASH_ADDRESS_SIZE, addr, chunk);
+        if (native_4byte && !(sfdp.desc.insns_4byte & SFDP_4BYTE_PROGRAM_1_1_1)) {
+            return FLASH_STATUS_BAD_ADDRESS;
+        }
+
+        int     addr_bytes = native_4byte ? 4 : EXTERNAL_FLASH_ADDRESS_SIZE;
+        uint8_t cmd[1 + 4];
+        size_t  n = 0;
+        cmd[n++]  = native_4byte ? CMD_PAGE_PROGRAM_4BYTE : CMD_PAGE_PROGRAM;
+        for (int i = addr_bytes - 1; i >= 0; --i) {
+            cmd[n++] = (addr >> (i * 8)) & 0xFF;
+        }
+
+        if (!spi_flash_wait_while_busy(EXTERNAL_FLASH_SPI_TIMEOUT, false) || !spi_flash_start()) {
+            return FLASH_STATUS_BUSY;
+        }
+        spi_write(CMD_WRITE_ENABLE);
+        spi_stop();
+        if (!spi_flash_start()) {
+            return FLASH_STATUS_BUSY;
+        }
+        bool ok = spi_transmit(cmd, n) >= 0 && spi_transmit(p, chunk) >= 0;
+        spi_stop();
+        if (!ok) {
+            return FLASH_STATUS_ERROR;
+        }
+
+        addr += chunk;
+        p += chunk;
+        length -= chunk;
+    }
+    return spi_flash_wait_while_busy(EXTERNAL_FLASH_SPI_TIMEOUT, false) ? FLASH_STATUS_SUCCESS : FLASH_STATUS_TIMEOUT;
+}
+
+uint32_t sfdp_get_density(void) {
+    return sfdp.is_supported ? sfdp.desc.density : 0;
+}
+
+uint16_t sfdp_get_page_size(void) {
+    return sfdp.is_supported ? sfdp.desc.page_size : 0;
+}
+
+// Smallest of the erase types in the mask, zero if none
+static uint32_t sfdp_min_erase_size(uint8_t erase_types) {
+    uint32_t size = 0;
+    for (int n = 0; n < SFDP_NUM_ERASE_TYPES; ++n) {
+        uint8_t shift = sfdp.desc.erase_types[n].size_shift;
+        if ((erase_types & (1 << n)) && shift && shift < 32 && (size == 0 || (1UL << shift) < size)) {
+            size = 1UL << shift;
+        }
+    }
+    return size;
+}
+
+uint32_t sfdp_get_min_erase_size(void) {
+    if (!sfdp.is_supported) {
+        return 0;
+    }
+    if (sfdp.desc.num_sector_regions == 0) {
+        return sfdp_min_erase_size(0x0F);
+    }
+    // Erase sizes are powers of two, so the largest of the regions' smallest sizes is a multiple of the others
+    uint32_t size = 0;
+    for (uint8_t r = 0; r < sfdp.desc.num_sector_regions; ++r) {
+        uint32_t region_size = sfdp_min_erase_size(sfdp.desc.sector_regions[r].erase_types);
+        if (region_size == 0) {
+            return 0;
+        }
+        if (region_size > size) {
+            size = region_size;
+        }
+    }
+    return size;
+}
+
+const sfdp_erase_type_t *sfdp_get_erase_type(int n) {
+    return &sfdp.desc.erase_types[n];
+}
+
+// Erase types usable at `addr` according to the sector map, and the bytes left in its region
+static uint8_t sfdp_erase_types_at(uint32_t addr, uint32_t *region_left) {
+    *region_left = UINT32_MAX;
+    if (sfdp.desc.num_sector_regions == 0) {
+        return 0x0F;
+    }
+    uint32_t start = 0;
+    for (uint8_t r = 0; r < sfdp.desc.num_sector_regions; ++r) {
+        const sfdp_sector_region_t *region = &sfdp.desc.sector_regions[r];
+        if (addr - start < region->size) {
+            *region_left = region->size - (addr - start);
+            return region->erase_types;
+        }
+        start += region->size;
+    }
+    return 0;
+}
+
+static flash_status_t sfdp_erase(const sfdp_erase_type_t *type, uint32_t addr) {
+    if (!spi_flash_wait_while_busy(EXTERNAL_FLASH_SPI_TIMEOUT, false) || !spi_flash_start()) {
+        return FLASH_STATUS_BUSY;
+    }
+    spi_write(CMD_WRITE_ENABLE);
+    spi_stop();
+
+    bool    native_4byte = sfdp_beyond_address_size(EXTERNAL_FLASH_ADDRESS_SIZE, addr, 1UL << type->size_shift);
+    int     addr_bytes   = native_4byte ? 4 : EXTERNAL_FLASH_ADDRESS_SIZE;
+    uint8_t cmd[1 + 4];
+    size_t  n = 0;
+    cmd[n++]  = native_4byte ? type->opcode_4byte : type->opcode;
+    for (int i = addr_bytes - 1; i >= 0; --i) {
+        cmd[n++] = (addr >> (i * 8)) & 0xFF;
+    }
+    if (!spi_flash_start()) {
+        return FLASH_STATUS_BUSY;
+    }
+    spi_status_t status = spi_transmit(cmd, n);
+    spi_stop();
+    if (status < 0) {
+        return FLASH_STATUS_ERROR;
+    }
+    return spi_flash_wait_while_busy(SFDP_FLASH_ERASE_TIMEOUT, true) ? FLASH_STATUS_SUCCESS : FLASH_STATUS_TIMEOUT;
+}
+
+flash_status_t sfdp_flash_erase_range(uint32_t addr, size_t length) {
+    if (!sfdp.is_supported) {
+        if (addr % EXTERNAL_FLASH_SECTOR_SIZE != 0 || length % EXTERNAL_FLASH_SECTOR_SIZE != 0) {
+            return FLASH_STATUS_BAD_ADDRESS;
+        }
+        for (; length > 0; addr += EXTERNAL_FLASH_SECTOR_SIZE, length -= EXTERNAL_FLASH_SECTOR_SIZE) {
+            flash_status_t status = flash_erase_sector(addr);
+            if (status != FLASH_STATUS_SUCCESS) {
+                return status;
             }
-            sfdp_dprintf("Parameter header %d A: 0x%08lX, B: 0x%08lX\n", (int)n, param.a.u32, param.b.u32);
-            sfdp_dprintf("- JEDEC ID: 0x%02X, param rev %d.%d, parameter length: %d\n", (int)param.jedec_id, (int)param.major, (int)param.minor, (int)param.length);
-            sfdp_dprintf("- Parameter table pointer: 0x%08lX\n", (uint32_t)(param.table_pointer));
+        }
+        return FLASH_STATUS_SUCCESS;
+    }
 
-            if (n == 0) { // Limited to base JEDEC standard parameters
-                if (!sfdp_parse_parameter_table(param.table_pointer, param.length)) {
-                    return false;
-                }
+    while (length > 0) {
+        // Largest erase allowed in this region which is aligned to the current address and doesn't overrun the range
+        // or the region; beyond the configured address size, only erases with a 4-byte address opcode can be used
+        uint32_t                 region_left;
+        uint8_t                  allowed = sfdp_erase_types_at(addr, &region_left);
+        const sfdp_erase_type_t *best    = NULL;
+        for (int n = 0; n < SFDP_NUM_ERASE_TYPES; ++n) {
+            const sfdp_erase_type_t *type = &sfdp.desc.erase_types[n];
+            uint32_t                 size = 1UL << type->size_shift;
+            if (!type->size_shift || !(allowed & (1 << n)) || size > length || size > region_left || addr % size != 0) {
+                continue;
+            }
+            if (!type->opcode_4byte && sfdp_beyond_address_size(EXTERNAL_FLASH_ADDRESS_SIZE, addr, size)) {
+                continue;
+            }
+            if (!best || type->size_shift > best->size_shift) {
+                best = type;
             }
         }
-        sfdp.is_supported = true;
+        if (!best) {
+            return FLASH_STATUS_BAD_ADDRESS;
+        }
+
+        flash_status_t status = sfdp_erase(best, addr);
+        if (status != FLASH_STATUS_SUCCESS) {
+            return status;
+        }
+        addr += 1UL << best->size_shift;
+        length -= 1UL << best->size_shift;
     }
+    return FLASH_STATUS_SUCCESS;
+}
 
-    return sfdp.is_supported;
+// The filesystem module may be using the flash from its save thread, so it's held off while the device is (re)probed
+static void sfdp_probe(bool reset) {
+#    ifdef FILESYSTEM_ENABLE
+    fs_batch_begin();
+    fs_device_bus_lock();
+#    endif
+    if (reset) {
+        sfdp_reset();
+    }
+    sfdp_init();
+#    ifdef FILESYSTEM_ENABLE
+    fs_device_bus_unlock();
+    fs_batch_commit();
+#    endif
+}
+
+void keyboard_post_init_sfdp_flash(void) {
+    keyboard_post_init_sfdp_flash_kb();
+    sfdp_probe(false);
 }
 
 bool process_record_sfdp_flash(uint16_t keycode, keyrecord_t *record) {
@@ -246,7 +896,8 @@ bool process_record_sfdp_flash(uint16_t keycode, keyrecord_t *record) {
     switch (keycode) {
         case KC_SFDP: {
             if (record->event.pressed) {
-                sfdp_init();
+                // Probe again, e.g. to dump the parameters with SFDP_DEBUG_OUTPUT
+                sfdp_probe(true);
             }
             break;
         }
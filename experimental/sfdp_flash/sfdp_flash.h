@@ -2,6 +2,11 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "flash_spi.h"
+
 #ifdef SFDP_DEBUG_OUTPUT
 #    include <debug.h>
 #    define sfdp_dprintf(...)     \
@@ -15,4 +20,235 @@
         } while (0)
 #endif // SFDP_DEBUG_OUTPUT
 
+/** @brief Read commands described by the SFDP basic flash parameter table, named command-address-data lanes */
+typedef enum sfdp_read_mode_id_t {
+    SFDP_READ_1_1_1, /**< Single-lane read, always available */
+    SFDP_READ_1_1_2, /**< Dual output fast read */
+    SFDP_READ_1_2_2, /**< Dual I/O fast read */
+    SFDP_READ_2_2_2, /**< DPI fast read, requires the device to be in DPI mode */
+    SFDP_READ_1_1_4, /**< Quad output fast read */
+    SFDP_READ_1_4_4, /**< Quad I/O fast read */
+    SFDP_READ_4_4_4, /**< QPI fast read, requires the device to be in QPI mode */
+    SFDP_READ_NUM_MODES
+} sfdp_read_mode_id_t;
+
+/** @brief Read command parameters */
+typedef struct sfdp_read_mode_t {
+    bool    supported;   /**< Device advertises this command */
+    uint8_t opcode;      /**< Command opcode */
+    uint8_t addr_bytes;  /**< Address bytes following the opcode */
+    uint8_t cmd_lanes;   /**< Lanes used to send the opcode */
+    uint8_t addr_lanes;  /**< Lanes used to send the address and mode bits */
+    uint8_t data_lanes;  /**< Lanes used to receive data */
+    uint8_t mode_clocks; /**< Clocks of mode bits following the address, driven high by the host */
+    uint8_t wait_states; /**< Dummy clocks following the mode bits */
+} sfdp_read_mode_t;
+
+/** @brief Number of erase types described by the SFDP basic flash parameter table */
+#define SFDP_NUM_ERASE_TYPES 4
+
+/** @brief Erase command parameters */
+typedef struct sfdp_erase_type_t {
+    uint8_t size_shift;   /**< Erase size is 2^size_shift bytes, zero if unused */
+    uint8_t opcode;       /**< Command opcode */
+    uint8_t opcode_4byte; /**< Command opcode taking a 4-byte address, zero if unsupported */
+} sfdp_erase_type_t;
+
+/** @name Instructions accepted with a native 4-byte address, from DWORD 1 of the 4-byte address instruction table
+ * @{
+ */
+#define SFDP_4BYTE_READ_1_1_1 (1UL << 0)      /**< Read, 13h */
+#define SFDP_4BYTE_FAST_READ_1_1_1 (1UL << 1) /**< Fast read, 0Ch */
+#define SFDP_4BYTE_READ_1_1_2 (1UL << 2)      /**< Dual output fast read, 3Ch */
+#define SFDP_4BYTE_READ_1_2_2 (1UL << 3)      /**< Dual I/O fast read, BCh */
+#define SFDP_4BYTE_READ_1_1_4 (1UL << 4)      /**< Quad output fast read, 6Ch */
+#define SFDP_4BYTE_READ_1_4_4 (1UL << 5)      /**< Quad I/O fast read, ECh */
+#define SFDP_4BYTE_PROGRAM_1_1_1 (1UL << 6)   /**< Page program, 12h */
+/** @} */
+
+/** @brief Most sector map regions kept in the descriptor, maps with more fall back to the erase types usable everywhere */
+#ifndef SFDP_MAX_SECTOR_REGIONS
+#    define SFDP_MAX_SECTOR_REGIONS 4
+#endif // SFDP_MAX_SECTOR_REGIONS
+
+/** @brief Region of the sector map, regions are contiguous from address zero */
+typedef struct sfdp_sector_region_t {
+    uint32_t size;        /**< Region size in bytes */
+    uint8_t  erase_types; /**< Bit n set if erase type n can be used within the region */
+} sfdp_sector_region_t;
+
+/** @brief Version of sfdp_descriptor_t, changed whenever its layout or meaning changes */
+#define SFDP_DESCRIPTOR_VERSION 2
+
+/** @brief Parsed SFDP parameters, self-contained so that it can be persisted between boots */
+typedef struct sfdp_descriptor_t {
+    uint8_t              version;                                 /**< SFDP_DESCRIPTOR_VERSION */
+    uint32_t             jedec_id;                                /**< Device the parameters were read from */
+    uint32_t             density;                                 /**< Device size in bytes, zero if unknown */
+    uint16_t             page_size;                               /**< Program page size in bytes, zero if unknown */
+    sfdp_read_mode_t     read_modes[SFDP_READ_NUM_MODES];         /**< Read commands */
+    sfdp_erase_type_t    erase_types[SFDP_NUM_ERASE_TYPES];       /**< Erase commands */
+    uint32_t             insns_4byte;                             /**< SFDP_4BYTE_* instructions, zero without a 4-byte address table */
+    uint8_t              num_sector_regions;                      /**< Regions in the sector map, zero if every erase type works everywhere */
+    sfdp_sector_region_t sector_regions[SFDP_MAX_SECTOR_REGIONS]; /**< Sector map of the detected configuration */
+} sfdp_descriptor_t;
+
+/**
+ * @brief Probe the attached flash for SFDP support and parse its parameters
+ *
+ * Discovery runs once, later calls return the cached result. The JEDEC ID is always read, and used to look up a stored
+ * descriptor through sfdp_descriptor_load() before falling back to reading the SFDP tables. Besides the basic flash
+ * parameter table, the 4-byte address instruction and sector map tables are parsed when present; other tables are
+ * skipped. Selects the fastest read command usable with SFDP_FLASH_BUS_LANES.
+ *
+ * @return true if the device supports SFDP
+ */
 bool sfdp_init(void);
+
+/** @brief Discard the cached discovery result, so that the next sfdp_init() probes the device again */
+void sfdp_reset(void);
+
+/**
+ * @brief Get the parsed SFDP parameters
+ *
+ * @return Descriptor of the attached device, or NULL if SFDP is unavailable
+ */
+const sfdp_descriptor_t *sfdp_get_descriptor(void);
+
+/**
+ * @brief Load a previously stored descriptor
+ *
+ * The default implementation stores nothing. Boards can override this and sfdp_descriptor_store() to keep the
+ * descriptor in EEPROM or similar, so that later boots skip SFDP discovery. Descriptors with a different version or
+ * JEDEC ID are ignored.
+ *
+ * @param jedec_id JEDEC ID of the attached device
+ * @param descriptor Destination for the stored descriptor
+ * @return true if a descriptor was loaded
+ */
+bool sfdp_descriptor_load(uint32_t jedec_id, sfdp_descriptor_t *descriptor);
+
+/**
+ * @brief Store a newly discovered descriptor
+ *
+ * @param descriptor Descriptor to store, keyed by its jedec_id
+ */
+void sfdp_descriptor_store(const sfdp_descriptor_t *descriptor);
+
+/**
+ * @brief Get the parameters of a read command
+ *
+ * @param id Read command
+ * @return Read command parameters, `supported` is false if the device did not advertise it
+ */
+const sfdp_read_mode_t *sfdp_get_read_mode(sfdp_read_mode_id_t id);
+
+/**
+ * @brief Select the read command used by sfdp_flash_read_range()
+ *
+ * Picks the supported command needing the fewest clocks to read a page. Commands which need the device switched into
+ * DPI/QPI mode are never selected. On devices larger than the configured address size can reach, the fastest command
+ * with a native 4-byte address form is also selected, for reads beyond that boundary.
+ *
+ * @param max_lanes Widest address/data path the SPI controller can drive (1, 2 or 4)
+ * @return The selected read command
+ */
+sfdp_read_mode_id_t sfdp_select_read_mode(uint8_t max_lanes);
+
+/**
+ * @brief Perform a read transfer on the SPI bus
+ *
+ * The default implementation uses QMK's spi_master and so only handles single-lane commands with whole-byte dummy
+ * cycles. `mode->addr_bytes` gives the address width, which is 4 for native 4-byte address commands. Boards with a dual/quad capable controller should override this and set SFDP_FLASH_BUS_LANES accordingly.
+ *
+ * @param mode Read command to issue
+ * @param addr Flash address to read from
+ * @param data Destination buffer
+ * @param length Number of bytes to read
+ * @return true on success, false if the command could not be issued
+ */
+bool sfdp_bus_read(const sfdp_read_mode_t *mode, uint32_t addr, void *data, size_t length);
+
+/**
+ * @brief Read from flash using the command chosen by sfdp_select_read_mode()
+ *
+ * Drop-in replacement for flash_read_range(), which is used as the fallback if SFDP is unavailable or the bus cannot
+ * issue the selected command. Reads reaching beyond the configured address size use a native 4-byte address command,
+ * so large devices never need switching into 4-byte address mode. The filesystem module's lfs_flash driver uses it by
+ * default.
+ */
+flash_status_t sfdp_flash_read_range(uint32_t addr, void *data, size_t length);
+
+/**
+ * @brief Program flash, using the native 4-byte address page program where needed
+ *
+ * Drop-in replacement for flash_write_range(), which is used as the fallback if SFDP is unavailable. Writes are split
+ * into pages, and those beyond the configured address size are issued with the 4-byte address page program. The
+ * filesystem module's lfs_flash driver uses it by default.
+ *
+ * @return FLASH_STATUS_SUCCESS, or FLASH_STATUS_BAD_ADDRESS if the device cannot be programmed at that address
+ */
+flash_status_t sfdp_flash_write_range(uint32_t addr, const void *data, size_t length);
+
+/**
+ * @brief Get the device density described by SFDP
+ *
+ * @return Size of the device in bytes, zero if SFDP is unavailable or the device exceeds 32-bit addressing
+ */
+uint32_t sfdp_get_density(void);
+
+/**
+ * @brief Get the program page size described by SFDP
+ *
+ * Taken from DWORD 11 when present, otherwise 64 bytes for devices reporting 64-byte write granularity.
+ *
+ * @return Page size in bytes, zero if unknown
+ */
+uint16_t sfdp_get_page_size(void);
+
+/**
+ * @brief Get the smallest erase size described by SFDP
+ *
+ * With a sector map, this is the smallest size every region can erase in whole commands, e.g. 64kB if one region
+ * only supports 64kB erases.
+ *
+ * @return Smallest erase size in bytes, zero if SFDP is unavailable
+ */
+uint32_t sfdp_get_min_erase_size(void);
+
+/**
+ * @brief Get the parameters of an erase type
+ *
+ * @param n Erase type, 0 to SFDP_NUM_ERASE_TYPES-1
+ * @return Erase command parameters, `size_shift` is zero if the device did not advertise it
+ */
+const sfdp_erase_type_t *sfdp_get_erase_type(int n);
+
+/**
+ * @brief Erase a range of flash using the largest erase commands which fit
+ *
+ * Each step uses the largest erase type aligned to the current address which does not overrun the range, so a 64kB
+ * aligned span is erased with one command rather than sixteen sector erases. Only erase types the sector map allows
+ * within the current region are used, and beyond the configured address size only those with a 4-byte address
+ * opcode. While each erase is in progress sfdp_flash_busy_yield() is called between status polls, so other threads can
+ * run. Falls back to flash_erase_sector() if SFDP is unavailable. The filesystem module's lfs_flash driver uses it by
+ * default.
+ *
+ * @param addr Start of the range, aligned to the smallest erase size
+ * @param length Length of the range, a multiple of the smallest erase size
+ * @return FLASH_STATUS_SUCCESS, or FLASH_STATUS_BAD_ADDRESS if the range cannot be covered exactly
+ */
+flash_status_t sfdp_flash_erase_range(uint32_t addr, size_t length);
+
+/**
+ * @brief Called between status polls while the flash is busy
+ *
+ * The default implementation sleeps for SFDP_FLASH_BUSY_POLL_INTERVAL milliseconds with wait_ms() while erasing, which
+ * on ChibiOS lets other threads run for the tens to hundreds of milliseconds an erase takes. Otherwise it calls
+ * chThdYield() on ChibiOS, so threads of the same priority run during page programs, and spins elsewhere. SPI transfers
+ * themselves already block the calling thread rather than spinning. Boards can override this, e.g. to sleep during
+ * page programs too.
+ *
+ * @param erasing true while waiting for an erase, false for page programs and the check before each command
+ */
+void sfdp_flash_busy_yield(bool erasing);
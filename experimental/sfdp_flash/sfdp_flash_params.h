@@ -33,12 +33,17 @@ typedef struct __attribute__((packed)) sfdp_parameter_header_t {
         sfdp_dword_t b;
         struct __attribute__((packed)) {
             uint32_t table_pointer : 24;
-            uint8_t  reserved_0xFF;
+            uint8_t  id_msb; // 0xFF for JEDEC-defined tables, reserved as 0xFF before JESD216B
         };
     };
 } sfdp_parameter_header_t;
 _Static_assert(sizeof(sfdp_parameter_header_t) == 8, "sfdp_parameter_header_t size is not 8 bytes");
 
+// Parameter IDs, ID MSB in the high byte and ID LSB in the low byte
+#define SFDP_PARAMETER_ID_BASIC 0xFF00
+#define SFDP_PARAMETER_ID_SECTOR_MAP 0xFF81
+#define SFDP_PARAMETER_ID_4BYTE_ADDRESS 0xFF84
+
 typedef union sfdp_flashparam_dword_1_t {
     sfdp_dword_t dword;
     struct __attribute__((packed)) {
@@ -119,9 +124,10 @@ _Static_assert(sizeof(sfdp_flashparam_dword_6_t) == 4, "sfdp_flashparam_dword_6_
 typedef union sfdp_flashparam_dword_7_t {
     sfdp_dword_t dword;
     struct __attribute__((packed)) {
-        uint8_t wait_states_4_4_4_fastread : 5;
-        uint8_t num_mode_bits_4_4_4_fastread : 3;
-        uint8_t read_opcode_4_4_4_fastread;
+        uint32_t reserved_0 : 16;
+        uint8_t  wait_states_4_4_4_fastread : 5;
+        uint8_t  num_mode_bits_4_4_4_fastread : 3;
+        uint8_t  read_opcode_4_4_4_fastread;
     };
 } sfdp_flashparam_dword_7_t;
 _Static_assert(sizeof(sfdp_flashparam_dword_7_t) == 4, "sfdp_flashparam_dword_7_t size is not 4 bytes");
@@ -147,3 +153,64 @@ typedef union sfdp_flashparam_dword_9_t {
     };
 } sfdp_flashparam_dword_9_t;
 _Static_assert(sizeof(sfdp_flashparam_dword_9_t) == 4, "sfdp_flashparam_dword_9_t size is not 4 bytes");
+
+typedef union sfdp_flashparam_dword_11_t {
+    sfdp_dword_t dword;
+    struct __attribute__((packed)) {
+        uint8_t  program_max_time_multiplier : 4;
+        uint8_t  page_size : 4;
+        uint32_t reserved_0 : 24;
+    };
+} sfdp_flashparam_dword_11_t;
+_Static_assert(sizeof(sfdp_flashparam_dword_11_t) == 4, "sfdp_flashparam_dword_11_t size is not 4 bytes");
+
+// 4-byte address instruction table, DWORD 1 is a bitmask of SFDP_4BYTE_* instructions
+typedef union sfdp_4byte_dword_2_t {
+    sfdp_dword_t dword;
+    struct __attribute__((packed)) {
+        uint8_t erase_type_1_opcode;
+        uint8_t erase_type_2_opcode;
+        uint8_t erase_type_3_opcode;
+        uint8_t erase_type_4_opcode;
+    };
+} sfdp_4byte_dword_2_t;
+_Static_assert(sizeof(sfdp_4byte_dword_2_t) == 4, "sfdp_4byte_dword_2_t size is not 4 bytes");
+
+// Sector map table, a sequence of configuration detection commands followed by a sequence of maps
+typedef union sfdp_sector_map_command_t {
+    sfdp_dword_t dword;
+    struct __attribute__((packed)) {
+        uint8_t end_of_sequence : 1;
+        uint8_t is_map : 1; // 0 for a command descriptor, whose second DWORD is the address
+        uint8_t reserved_0 : 6;
+        uint8_t opcode;
+        uint8_t read_latency : 4; // Dummy clocks, 0xF if variable
+        uint8_t reserved_1 : 2;
+        uint8_t address_length : 2; // 0: none, 1: 3 bytes, 2: 4 bytes, 3: current address mode
+        uint8_t read_data_mask;
+    };
+} sfdp_sector_map_command_t;
+_Static_assert(sizeof(sfdp_sector_map_command_t) == 4, "sfdp_sector_map_command_t size is not 4 bytes");
+
+typedef union sfdp_sector_map_header_t {
+    sfdp_dword_t dword;
+    struct __attribute__((packed)) {
+        uint8_t end_of_sequence : 1;
+        uint8_t is_map : 1; // 1 for a map descriptor, followed by one DWORD per region
+        uint8_t reserved_0 : 6;
+        uint8_t config_id;
+        uint8_t region_count; // Minus one
+        uint8_t reserved_1;
+    };
+} sfdp_sector_map_header_t;
+_Static_assert(sizeof(sfdp_sector_map_header_t) == 4, "sfdp_sector_map_header_t size is not 4 bytes");
+
+typedef union sfdp_sector_map_region_t {
+    sfdp_dword_t dword;
+    struct __attribute__((packed)) {
+        uint8_t  erase_types : 4; // Bit 0 set if erase type 1 is usable in the region, and so on
+        uint8_t  reserved_0 : 4;
+        uint32_t size : 24; // In units of 256 bytes, minus one
+    };
+} sfdp_sector_map_region_t;
+_Static_assert(sizeof(sfdp_sector_map_region_t) == 4, "sfdp_sector_map_region_t size is not 4 bytes");
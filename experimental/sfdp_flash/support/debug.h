@@ -0,0 +1,6 @@
+// Copyright 2025-2026 Nick Brassel (@tzarc)
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+// Stand-in for QMK's debug.h, dprintf() is provided by host_keyboard.h
+#include "host_keyboard.h"
@@ -0,0 +1,31 @@
+// Copyright 2025-2026 Nick Brassel (@tzarc)
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+// Stand-in for QMK's flash_spi.h, the functions used by the SFDP module are implemented by spi_flash_sim.c
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define EXTERNAL_FLASH_SPI_SLAVE_SELECT_PIN 0
+#define EXTERNAL_FLASH_SPI_LSBFIRST false
+#define EXTERNAL_FLASH_SPI_MODE 0
+#define EXTERNAL_FLASH_SPI_CLOCK_DIVISOR 8
+#define EXTERNAL_FLASH_SPI_TIMEOUT 1000
+#define EXTERNAL_FLASH_PAGE_SIZE 256
+#define EXTERNAL_FLASH_SECTOR_SIZE (4 * 1024)
+#define EXTERNAL_FLASH_BLOCK_SIZE (64 * 1024)
+#define EXTERNAL_FLASH_SIZE (1024 * 1024)
+#define EXTERNAL_FLASH_ADDRESS_SIZE 3
+
+typedef int16_t flash_status_t;
+
+#define FLASH_STATUS_SUCCESS (0)
+#define FLASH_STATUS_ERROR (-1)
+#define FLASH_STATUS_TIMEOUT (-2)
+#define FLASH_STATUS_BAD_ADDRESS (-3)
+#define FLASH_STATUS_BUSY (-4)
+
+flash_status_t flash_read_range(uint32_t addr, void *buf, size_t len);
+flash_status_t flash_write_range(uint32_t addr, const void *buf, size_t len);
+flash_status_t flash_erase_sector(uint32_t addr);
@@ -0,0 +1,27 @@
+// Copyright 2025-2026 Nick Brassel (@tzarc)
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+// Stand-in for QMK_KEYBOARD_H, and the handful of QMK facilities used by the SFDP flash module, for host-side builds.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// QMK's dprintf() goes to the console, glibc's writes to a file descriptor
+#define dprintf printf
+
+typedef struct keyevent_t {
+    bool pressed;
+} keyevent_t;
+
+typedef struct keyrecord_t {
+    keyevent_t event;
+} keyrecord_t;
+
+enum host_keycodes {
+    KC_SFDP = 0x7E00,
+};
+
+bool process_record_sfdp_flash_kb(uint16_t keycode, keyrecord_t *record);
+void keyboard_post_init_sfdp_flash_kb(void);
@@ -0,0 +1,392 @@
+// Copyright 2025-2026 Nick Brassel (@tzarc)
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sfdp_flash.h"
+#include "spi_flash_sim.h"
+#include "timer.h"
+
+// Runs sfdp_init() against a set of simulated parts, checks that the parsed read commands match what each part
+// advertises, that the expected command is selected for each bus width, and that reads return the right data without
+// upsetting the simulated device, that range erases use the largest aligned erase commands, and that the geometry used
+// to size littlefs is decoded, and that discovery is cached and can be skipped using a stored descriptor. Parts with a
+// 4-byte address table are checked to use native 4-byte commands beyond 16MB, and parts with a sector map to respect
+// it when erasing. Waits for erases are checked to sleep between status polls rather than spin. Also reports bus clocks
+// for bulk reads relative to plain flash_read_range().
+
+bool process_record_sfdp_flash_kb(uint16_t keycode, keyrecord_t *record) {
+    return true;
+}
+
+void keyboard_post_init_sfdp_flash_kb(void) {}
+
+// Descriptor persistence, standing in for EEPROM
+static bool              stored_valid = false;
+static sfdp_descriptor_t stored;
+
+bool sfdp_descriptor_load(uint32_t jedec_id, sfdp_descriptor_t *descriptor) {
+    if (!stored_valid) {
+        return false;
+    }
+    memcpy(descriptor, &stored, sizeof(stored));
+    return true;
+}
+
+void sfdp_descriptor_store(const sfdp_descriptor_t *descriptor) {
+    memcpy(&stored, descriptor, sizeof(stored));
+    stored_valid = true;
+}
+
+typedef struct sim_test_case_t {
+    spi_flash_sim_part_t part;
+    sfdp_read_mode_id_t  expected[3]; // Selected read command for 1, 2 and 4 lane buses
+} sim_test_case_t;
+
+static const sim_test_case_t test_cases[] = {
+    {
+        .part     = {.name = "single", .jedec_id = 0x1F8501},
+        .expected = {SFDP_READ_1_1_1, SFDP_READ_1_1_1, SFDP_READ_1_1_1},
+    },
+    {
+        .part =
+            {
+                .name       = "dual",
+                .jedec_id   = 0xC22815,
+                .page_shift = 8,
+                .read_1_1_2 = {.opcode = 0x3B, .wait_states = 8},
+                .read_1_2_2 = {.opcode = 0xBB, .mode_clocks = 4},
+            },
+        .expected = {SFDP_READ_1_1_1, SFDP_READ_1_2_2, SFDP_READ_1_2_2},
+    },
+    {
+        .part =
+            {
+                .name       = "quad-output",
+                .jedec_id   = 0x9D6015,
+                .read_1_1_4 = {.opcode = 0x6B, .wait_states = 8},
+            },
+        .expected = {SFDP_READ_1_1_1, SFDP_READ_1_1_1, SFDP_READ_1_1_4},
+    },
+    {
+        .part =
+            {
+                .name       = "quad",
+                .jedec_id   = 0xEF4018,
+                .page_shift = 8,
+                .read_1_1_2 = {.opcode = 0x3B, .wait_states = 8},
+                .read_1_2_2 = {.opcode = 0xBB, .mode_clocks = 4},
+                .read_1_1_4 = {.opcode = 0x6B, .wait_states = 8},
+                .read_1_4_4 = {.opcode = 0xEB, .mode_clocks = 2, .wait_states = 4},
+            },
+        .expected = {SFDP_READ_1_1_1, SFDP_READ_1_2_2, SFDP_READ_1_4_4},
+    },
+    {
+        // DPI/QPI commands are parsed, but never selected as the device would need switching modes first
+        .part =
+            {
+                .name       = "qpi",
+                .jedec_id   = 0xC22539,
+                .page_shift = 9,
+                .read_1_1_2 = {.opcode = 0x3B, .wait_states = 8},
+                .read_1_2_2 = {.opcode = 0xBB, .mode_clocks = 4},
+                .read_2_2_2 = {.opcode = 0xBB, .mode_clocks = 4, .wait_states = 2},
+                .read_1_1_4 = {.opcode = 0x6B, .wait_states = 8},
+                .read_1_4_4 = {.opcode = 0xEB, .mode_clocks = 2, .wait_states = 4},
+                .read_4_4_4 = {.opcode = 0xEB, .mode_clocks = 2, .wait_states = 6},
+            },
+        .expected = {SFDP_READ_1_1_1, SFDP_READ_1_2_2, SFDP_READ_1_4_4},
+    },
+    {
+        // Beyond 16MB, so needs 4-byte addresses for the upper half
+        .part =
+            {
+                .name       = "large",
+                .jedec_id   = 0xEF4019,
+                .page_shift = 8,
+                .density    = 32 * 1024 * 1024,
+                .addr_4byte = true,
+                .read_1_1_2 = {.opcode = 0x3B, .wait_states = 8},
+                .read_1_2_2 = {.opcode = 0xBB, .mode_clocks = 4},
+                .read_1_1_4 = {.opcode = 0x6B, .wait_states = 8},
+                .read_1_4_4 = {.opcode = 0xEB, .mode_clocks = 2, .wait_states = 4},
+            },
+        .expected = {SFDP_READ_1_1_1, SFDP_READ_1_2_2, SFDP_READ_1_4_4},
+    },
+    {
+        // Sector map with 4kB-only boot sectors, configured to sit at the top of the device
+        .part =
+            {
+                .name            = "boot-sectors",
+                .jedec_id        = 0x010219,
+                .page_shift      = 8,
+                .boot_sectors    = true,
+                .config_register = 0x04,
+                .read_1_1_2      = {.opcode = 0x3B, .wait_states = 8},
+            },
+        .expected = {SFDP_READ_1_1_1, SFDP_READ_1_1_2, SFDP_READ_1_1_2},
+    },
+};
+
+static const char *const read_mode_names[SFDP_READ_NUM_MODES] = {
+    [SFDP_READ_1_1_1] = "1-1-1", [SFDP_READ_1_1_2] = "1-1-2", [SFDP_READ_1_2_2] = "1-2-2", [SFDP_READ_2_2_2] = "2-2-2", [SFDP_READ_1_1_4] = "1-1-4", [SFDP_READ_1_4_4] = "1-4-4", [SFDP_READ_4_4_4] = "4-4-4",
+};
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                    \
+    do {                                    \
+        if (!(cond)) {                      \
+            printf("  FAIL: " __VA_ARGS__); \
+            printf("\n");                   \
+            ++failures;                     \
+        }                                   \
+    } while (0)
+
+static void check_parsed_mode(const sim_test_case_t *tc, sfdp_read_mode_id_t id, const spi_flash_sim_read_t *expected) {
+    const sfdp_read_mode_t *mode = sfdp_get_read_mode(id);
+    CHECK(mode->supported == (expected->opcode != 0), "%s %s supported: %d", tc->part.name, read_mode_names[id], (int)mode->supported);
+    if (mode->supported && expected->opcode) {
+        CHECK(mode->opcode == expected->opcode && mode->mode_clocks == expected->mode_clocks && mode->wait_states == expected->wait_states, "%s %s parsed as opcode 0x%02X, mode %d, wait %d", tc->part.name, read_mode_names[id], (int)mode->opcode, (int)mode->mode_clocks, (int)mode->wait_states);
+    }
+}
+
+static void check_reads(const sim_test_case_t *tc, const char *label) {
+    static uint8_t buf[4096];
+    const uint8_t *memory = spi_flash_sim_memory();
+    srand(tc->part.jedec_id);
+    for (int i = 0; i < 256; ++i) {
+        size_t   length = 1 + rand() % sizeof(buf);
+        uint32_t addr   = rand() % (EXTERNAL_FLASH_SIZE - length);
+        memset(buf, 0, length);
+        CHECK(sfdp_flash_read_range(addr, buf, length) == FLASH_STATUS_SUCCESS, "%s %s read failed", tc->part.name, label);
+        if (memcmp(buf, &memory[addr], length) != 0) {
+            CHECK(false, "%s %s read of %d bytes at 0x%06X mismatched", tc->part.name, label, (int)length, (unsigned)addr);
+            break;
+        }
+    }
+    CHECK(spi_flash_sim_errors() == 0, "%s %s caused %u protocol errors", tc->part.name, label, (unsigned)spi_flash_sim_errors());
+}
+
+// Erases an unaligned span, which should be covered by the largest aligned erases: 4kB up to the 32kB boundary, 32kB up
+// to the 64kB boundary, 64kB, then 4kB for the tail
+static void check_erase(const sim_test_case_t *tc) {
+    static const struct {
+        uint32_t size;
+        uint32_t expected;
+    } erases[] = {{4 * 1024, 2}, {32 * 1024, 1}, {64 * 1024, 1}};
+    const uint32_t addr   = 0x7000;
+    const uint32_t length = 0x1A000;
+
+    const uint8_t *memory = spi_flash_sim_memory();
+    uint8_t        before = memory[addr - 1];
+    uint8_t        after  = memory[addr + length];
+    spi_flash_sim_reset_counters();
+    CHECK(sfdp_flash_erase_range(addr, length) == FLASH_STATUS_SUCCESS, "%s erase failed", tc->part.name);
+    CHECK(spi_flash_sim_errors() == 0, "%s erase caused %u protocol errors", tc->part.name, (unsigned)spi_flash_sim_errors());
+    for (size_t n = 0; n < sizeof(erases) / sizeof(erases[0]); ++n) {
+        CHECK(spi_flash_sim_erases(erases[n].size) == erases[n].expected, "%s issued %u %ukB erases, expected %u", tc->part.name, (unsigned)spi_flash_sim_erases(erases[n].size), (unsigned)(erases[n].size / 1024), (unsigned)erases[n].expected);
+    }
+    for (uint32_t i = 0; i < length; ++i) {
+        if (memory[addr + i] != 0xFF) {
+            CHECK(false, "%s byte at 0x%06X not erased", tc->part.name, (unsigned)(addr + i));
+            break;
+        }
+    }
+    CHECK(memory[addr - 1] == before && memory[addr + length] == after, "%s erase overran its range", tc->part.name);
+    CHECK(sfdp_flash_erase_range(addr + 1, 4096) == FLASH_STATUS_BAD_ADDRESS, "%s misaligned erase accepted", tc->part.name);
+}
+
+// Discovery should take three transactions (JEDEC ID, headers, basic parameter table) plus one per optional table and
+// sector map detection command, and be cached, and a stored descriptor for the same part should leave only the JEDEC ID
+// read
+static void check_discovery(const sim_test_case_t *tc) {
+    uint32_t expected = 3 + (tc->part.addr_4byte ? 1 : 0) + (tc->part.boot_sectors ? 2 : 0);
+    stored_valid      = false;
+    sfdp_reset();
+    spi_flash_sim_reset_counters();
+    CHECK(sfdp_init(), "%s rediscovery failed", tc->part.name);
+    CHECK(spi_flash_sim_transactions() == expected, "%s discovery took %u transactions", tc->part.name, (unsigned)spi_flash_sim_transactions());
+    CHECK(stored_valid && stored.jedec_id == tc->part.jedec_id, "%s descriptor not stored", tc->part.name);
+
+    sfdp_descriptor_t discovered = *sfdp_get_descriptor();
+    spi_flash_sim_reset_counters();
+    CHECK(sfdp_init(), "%s cached sfdp_init() failed", tc->part.name);
+    CHECK(spi_flash_sim_transactions() == 0, "%s cached sfdp_init() took %u transactions", tc->part.name, (unsigned)spi_flash_sim_transactions());
+
+    sfdp_reset();
+    spi_flash_sim_reset_counters();
+    CHECK(sfdp_init(), "%s sfdp_init() from stored descriptor failed", tc->part.name);
+    CHECK(spi_flash_sim_transactions() == 1, "%s sfdp_init() from stored descriptor took %u transactions", tc->part.name, (unsigned)spi_flash_sim_transactions());
+    CHECK(memcmp(sfdp_get_descriptor(), &discovered, sizeof(discovered)) == 0, "%s stored descriptor differs", tc->part.name);
+
+    // A descriptor from another part must not be used
+    stored.jedec_id ^= 1;
+    sfdp_reset();
+    spi_flash_sim_reset_counters();
+    CHECK(sfdp_init() && spi_flash_sim_transactions() == expected, "%s used a stored descriptor for another part", tc->part.name);
+    stored_valid = false;
+}
+
+// Reads, erases and programs beyond 16MB, which should all use native 4-byte address commands, while accesses below it
+// keep using 3-byte addresses. Simulated memory aliases every EXTERNAL_FLASH_SIZE bytes.
+static void check_4byte(const sim_test_case_t *tc) {
+    static uint8_t buf[4096];
+    static uint8_t pattern[600];
+    const uint8_t *memory = spi_flash_sim_memory();
+    const uint32_t high   = 16 * 1024 * 1024;
+
+    const sfdp_descriptor_t *desc = sfdp_get_descriptor();
+    CHECK(desc->insns_4byte & SFDP_4BYTE_PROGRAM_1_1_1, "%s 4-byte page program not parsed", tc->part.name);
+    CHECK(sfdp_get_erase_type(0)->opcode_4byte == 0x21 && sfdp_get_erase_type(2)->opcode_4byte == 0xDC, "%s 4-byte erase opcodes parsed as 0x%02X/0x%02X", tc->part.name, (int)sfdp_get_erase_type(0)->opcode_4byte, (int)sfdp_get_erase_type(2)->opcode_4byte);
+
+    spi_flash_sim_reset_counters();
+    CHECK(sfdp_flash_read_range(0x1000, buf, sizeof(buf)) == FLASH_STATUS_SUCCESS && spi_flash_sim_4byte_commands() == 0, "%s low read used 4-byte addressing", tc->part.name);
+
+    // Straddling the 16MB boundary
+    uint32_t addr = high - 128;
+    CHECK(sfdp_flash_read_range(addr, buf, sizeof(buf)) == FLASH_STATUS_SUCCESS, "%s high read failed", tc->part.name);
+    for (size_t i = 0; i < sizeof(buf); ++i) {
+        if (buf[i] != memory[(addr + i) % EXTERNAL_FLASH_SIZE]) {
+            CHECK(false, "%s high read mismatched at 0x%08X", tc->part.name, (unsigned)(addr + i));
+            break;
+        }
+    }
+    CHECK(spi_flash_sim_4byte_commands() == 1, "%s high read issued %u 4-byte commands", tc->part.name, (unsigned)spi_flash_sim_4byte_commands());
+
+    addr = high + 0x10000;
+    spi_flash_sim_reset_counters();
+    CHECK(sfdp_flash_erase_range(addr, 0x10000) == FLASH_STATUS_SUCCESS, "%s high erase failed", tc->part.name);
+    CHECK(spi_flash_sim_erases(64 * 1024) == 1 && spi_flash_sim_4byte_commands() == 1, "%s high erase issued %u 64kB erases, %u 4-byte commands", tc->part.name, (unsigned)spi_flash_sim_erases(64 * 1024), (unsigned)spi_flash_sim_4byte_commands());
+
+    for (size_t i = 0; i < sizeof(pattern); ++i) {
+        pattern[i] = (uint8_t)(i * 7 + 1);
+    }
+    addr += 5; // Unaligned, so spans three pages
+    spi_flash_sim_reset_counters();
+    CHECK(sfdp_flash_write_range(addr, pattern, sizeof(pattern)) == FLASH_STATUS_SUCCESS, "%s high write failed", tc->part.name);
+    CHECK(memcmp(pattern, &memory[addr % EXTERNAL_FLASH_SIZE], sizeof(pattern)) == 0, "%s high write mismatched", tc->part.name);
+    CHECK(spi_flash_sim_4byte_commands() == 3, "%s high write issued %u 4-byte commands", tc->part.name, (unsigned)spi_flash_sim_4byte_commands());
+    CHECK(spi_flash_sim_errors() == 0, "%s 4-byte commands caused %u protocol errors", tc->part.name, (unsigned)spi_flash_sim_errors());
+}
+
+// The detected map puts the boot sectors in the top 64kB, which must be erased in 4kB units
+static void check_sector_map(const sim_test_case_t *tc) {
+    const sfdp_descriptor_t *desc = sfdp_get_descriptor();
+    CHECK(desc->num_sector_regions == 2 && desc->sector_regions[0].erase_types == 0x7 && desc->sector_regions[1].size == 64 * 1024 && desc->sector_regions[1].erase_types == 0x1, "%s sector map parsed as %d regions", tc->part.name, (int)desc->num_sector_regions);
+
+    spi_flash_sim_reset_counters();
+    CHECK(sfdp_flash_erase_range(EXTERNAL_FLASH_SIZE - 0x20000, 0x20000) == FLASH_STATUS_SUCCESS, "%s boot sector erase failed", tc->part.name);
+    CHECK(spi_flash_sim_erases(64 * 1024) == 1 && spi_flash_sim_erases(4 * 1024) == 16, "%s boot sector erase issued %u 64kB and %u 4kB erases", tc->part.name, (unsigned)spi_flash_sim_erases(64 * 1024), (unsigned)spi_flash_sim_erases(4 * 1024));
+    CHECK(spi_flash_sim_errors() == 0, "%s boot sector erase caused %u protocol errors", tc->part.name, (unsigned)spi_flash_sim_errors());
+}
+
+// A 4kB erase keeps the simulated part busy for 45ms, which should be waited out sleeping between status polls, while
+// page programs are polled without sleeping
+static void check_busy(const sim_test_case_t *tc) {
+    static uint8_t pattern[1024];
+    const uint8_t *memory = spi_flash_sim_memory();
+    const uint32_t addr   = 0x40000;
+
+    spi_flash_sim_reset_counters();
+    uint32_t start = timer_read32();
+    CHECK(sfdp_flash_erase_range(addr, 4096) == FLASH_STATUS_SUCCESS, "%s erase failed", tc->part.name);
+    uint32_t elapsed = timer_read32() - start;
+    CHECK(elapsed >= 45 && elapsed <= 47, "%s erase took %ums", tc->part.name, (unsigned)elapsed);
+    CHECK(spi_flash_sim_sleeps() >= 44 && spi_flash_sim_busy_polls() <= spi_flash_sim_sleeps() + 1, "%s erase polled %u times with %u sleeps", tc->part.name, (unsigned)spi_flash_sim_busy_polls(), (unsigned)spi_flash_sim_sleeps());
+
+    for (size_t i = 0; i < sizeof(pattern); ++i) {
+        pattern[i] = (uint8_t)(i * 13 + 3);
+    }
+    spi_flash_sim_reset_counters();
+    CHECK(sfdp_flash_write_range(addr, pattern, sizeof(pattern)) == FLASH_STATUS_SUCCESS, "%s write failed", tc->part.name);
+    CHECK(memcmp(pattern, &memory[addr], sizeof(pattern)) == 0, "%s write mismatched", tc->part.name);
+    CHECK(spi_flash_sim_sleeps() == 0 && spi_flash_sim_busy_polls() > 0, "%s write polled %u times with %u sleeps", tc->part.name, (unsigned)spi_flash_sim_busy_polls(), (unsigned)spi_flash_sim_sleeps());
+    CHECK(spi_flash_sim_errors() == 0, "%s busy waits caused %u protocol errors", tc->part.name, (unsigned)spi_flash_sim_errors());
+}
+
+// Bus clocks to read 64kB in page-sized chunks, as littlefs would
+static uint64_t bulk_read_clocks(flash_status_t (*read)(uint32_t, void *, size_t)) {
+    static uint8_t buf[EXTERNAL_FLASH_PAGE_SIZE];
+    spi_flash_sim_reset_counters();
+    for (uint32_t addr = 0; addr < 64 * 1024; addr += sizeof(buf)) {
+        read(addr, buf, sizeof(buf));
+    }
+    return spi_flash_sim_clocks();
+}
+
+int main(void) {
+#ifdef SPI_FLASH_SIM_QSPI
+    static const uint8_t bus_lanes[] = {1, 2, 4};
+#else
+    static const uint8_t bus_lanes[] = {1};
+#endif
+
+    for (size_t t = 0; t < sizeof(test_cases) / sizeof(test_cases[0]); ++t) {
+        const sim_test_case_t *tc = &test_cases[t];
+        printf("%s (JEDEC 0x%06X):\n", tc->part.name, (unsigned)tc->part.jedec_id);
+        for (size_t b = 0; b < sizeof(bus_lanes); ++b) {
+            uint8_t lanes = bus_lanes[b];
+            spi_flash_sim_attach(&tc->part, lanes);
+            sfdp_reset();
+            if (!sfdp_init()) {
+                CHECK(false, "%s sfdp_init() failed", tc->part.name);
+                continue;
+            }
+            CHECK(spi_flash_sim_errors() == 0, "%s probe caused %u protocol errors", tc->part.name, (unsigned)spi_flash_sim_errors());
+
+            check_parsed_mode(tc, SFDP_READ_1_1_2, &tc->part.read_1_1_2);
+            check_parsed_mode(tc, SFDP_READ_1_2_2, &tc->part.read_1_2_2);
+            check_parsed_mode(tc, SFDP_READ_2_2_2, &tc->part.read_2_2_2);
+            check_parsed_mode(tc, SFDP_READ_1_1_4, &tc->part.read_1_1_4);
+            check_parsed_mode(tc, SFDP_READ_1_4_4, &tc->part.read_1_4_4);
+            check_parsed_mode(tc, SFDP_READ_4_4_4, &tc->part.read_4_4_4);
+
+            sfdp_read_mode_id_t selected = sfdp_select_read_mode(lanes);
+            sfdp_read_mode_id_t expected = tc->expected[lanes == 4 ? 2 : lanes - 1];
+            CHECK(selected == expected, "%s %d-lane bus selected %s, expected %s", tc->part.name, (int)lanes, read_mode_names[selected], read_mode_names[expected]);
+
+            char label[16];
+            snprintf(label, sizeof(label), "%d-lane", (int)lanes);
+            spi_flash_sim_reset_counters();
+            check_reads(tc, label);
+
+            if (b == 0) {
+                for (int n = 0; n < SFDP_NUM_ERASE_TYPES; ++n) {
+                    const sfdp_erase_type_t *type = sfdp_get_erase_type(n);
+                    static const uint8_t     expected_shift[SFDP_NUM_ERASE_TYPES]  = {12, 15, 16, 0};
+                    static const uint8_t     expected_opcode[SFDP_NUM_ERASE_TYPES] = {0x20, 0x52, 0xD8, 0};
+                    CHECK(type->size_shift == expected_shift[n] && type->opcode == expected_opcode[n], "%s erase type %d parsed as 2^%d/0x%02X", tc->part.name, n + 1, (int)type->size_shift, (int)type->opcode);
+                }
+                check_erase(tc);
+                check_busy(tc);
+
+                // Parts without DWORD 11 fall back to the 64-byte write granularity
+                uint16_t expected_page_size = tc->part.page_shift ? (1 << tc->part.page_shift) : 64;
+                uint32_t expected_density   = tc->part.density ? tc->part.density : EXTERNAL_FLASH_SIZE;
+                CHECK(sfdp_get_density() == expected_density, "%s density parsed as %u", tc->part.name, (unsigned)sfdp_get_density());
+                CHECK(sfdp_get_page_size() == expected_page_size, "%s page size parsed as %u", tc->part.name, (unsigned)sfdp_get_page_size());
+                CHECK(sfdp_get_min_erase_size() == 4096, "%s smallest erase parsed as %u", tc->part.name, (unsigned)sfdp_get_min_erase_size());
+
+                if (tc->part.addr_4byte) {
+                    check_4byte(tc);
+                }
+                if (tc->part.boot_sectors) {
+                    check_sector_map(tc);
+                }
+                check_discovery(tc);
+            }
+
+            uint64_t baseline = bulk_read_clocks(flash_read_range);
+            uint64_t clocks   = bulk_read_clocks(sfdp_flash_read_range);
+            printf("  %d-lane bus: %s (opcode 0x%02X), 64kB in %llu clocks, %.2fx flash_read_range()\n", (int)lanes, read_mode_names[selected], (int)sfdp_get_read_mode(selected)->opcode, (unsigned long long)clocks, (double)baseline / (double)clocks);
+        }
+    }
+
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("All tests passed\n");
+    return 0;
+}
@@ -0,0 +1,572 @@
+// Copyright 2025-2026 Nick Brassel (@tzarc)
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <string.h>
+#include "spi_master.h"
+#include "flash_spi.h"
+#include "timer.h"
+#include "wait.h"
+#include "spi_flash_sim.h"
+
+#define SIM_SFDP_TABLE_OFFSET 0x30
+#define SIM_SFDP_TABLE_DWORDS 11
+#define SIM_SFDP_4BYTE_OFFSET 0x60
+#define SIM_SFDP_SECTOR_MAP_OFFSET 0x70
+#define SIM_SFDP_SECTOR_MAP_DWORDS 8
+#define SIM_BOOT_SECTORS_SIZE (64 * 1024)
+#define SIM_NS_PER_CLOCK 125 // 8MHz bus
+#define SIM_PROGRAM_NS 500000
+#define SIM_SR_WIP 0x01
+
+static uint8_t sim_memory[EXTERNAL_FLASH_SIZE];
+static uint8_t sim_sfdp[256];
+
+static struct {
+    const spi_flash_sim_part_t *part;
+    uint8_t                     bus_lanes;
+    bool                        selected;
+    bool                        ignoring; // Unknown command, the device ignores the rest of the transaction
+    bool                        data_phase;
+    bool                        write_enabled;
+    uint32_t                    density;
+    uint8_t                     header[8];
+    uint8_t                     header_len;
+    uint8_t                     header_need;
+    uint8_t                     addr_bytes;
+    uint32_t                    addr;
+    uint64_t                    clocks;
+    uint32_t                    transactions;
+    uint32_t                    errors;
+    uint32_t                    erases[3]; // 4kB, 32kB, 64kB
+    uint32_t                    commands_4byte;
+    uint32_t                    busy_polls;
+    uint32_t                    sleeps;
+    uint64_t                    now_ns;  // Simulated time, advanced by bus clocks and wait_ms()
+    uint64_t                    busy_ns; // Time at which the program or erase in progress completes
+} sim;
+
+static const struct {
+    uint8_t  opcode;
+    uint8_t  opcode_4byte;
+    uint32_t size;
+    uint32_t latency_ms; // Typical erase times
+} sim_erase_types[] = {{0x20, 0x21, 4 * 1024, 45}, {0x52, 0x5C, 32 * 1024, 120}, {0xD8, 0xDC, 64 * 1024, 150}};
+
+static void sim_tick(uint64_t clocks) {
+    sim.clocks += clocks;
+    sim.now_ns += clocks * SIM_NS_PER_CLOCK;
+}
+
+static bool sim_busy(void) {
+    return sim.now_ns < sim.busy_ns;
+}
+
+static void sim_put32(uint8_t *p, uint32_t v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+}
+
+// Fast read parameter field as laid out by JESD216: wait states in bits 4:0, mode clocks in bits 7:5, then the opcode
+static uint16_t sim_read_field(const spi_flash_sim_read_t *r) {
+    if (!r->opcode) {
+        return 0;
+    }
+    return (uint16_t)((r->wait_states & 0x1F) | ((r->mode_clocks & 0x07) << 5)) | ((uint16_t)r->opcode << 8);
+}
+
+// Parameter header: ID LSB, rev 1.6, length in dwords, 24-bit table pointer, ID MSB
+static void sim_put_parameter_header(uint8_t *p, uint16_t id, uint8_t dwords, uint32_t table) {
+    p[0] = id & 0xFF;
+    p[1] = 6;
+    p[2] = 1;
+    p[3] = dwords;
+    p[4] = table & 0xFF;
+    p[5] = (table >> 8) & 0xFF;
+    p[6] = (table >> 16) & 0xFF;
+    p[7] = id >> 8;
+}
+
+// Whether the 4kB-only boot sectors cover `addr`
+static bool sim_in_boot_sectors(uint32_t addr) {
+    if (!sim.part->boot_sectors) {
+        return false;
+    }
+    uint32_t start = (sim.part->config_register & 0x04) ? sim.density - SIM_BOOT_SECTORS_SIZE : 0;
+    return addr >= start && addr - start < SIM_BOOT_SECTORS_SIZE;
+}
+
+static void sim_build_sfdp(const spi_flash_sim_part_t *part) {
+    memset(sim_sfdp, 0xFF, sizeof(sim_sfdp));
+
+    // SFDP header, rev 1.6, followed by the basic flash parameter header and any optional table headers
+    uint8_t headers = 1;
+    memcpy(&sim_sfdp[0], "SFDP", 4);
+    sim_sfdp[4] = 6;
+    sim_sfdp[5] = 1;
+    sim_sfdp[7] = 0xFF;
+    sim_put_parameter_header(&sim_sfdp[8], 0xFF00, part->page_shift ? SIM_SFDP_TABLE_DWORDS : 9, SIM_SFDP_TABLE_OFFSET); // JESD216 tables end after the sector types
+    if (part->addr_4byte) {
+        sim_put_parameter_header(&sim_sfdp[8 + 8 * headers++], 0xFF84, 2, SIM_SFDP_4BYTE_OFFSET);
+    }
+    if (part->boot_sectors) {
+        sim_put_parameter_header(&sim_sfdp[8 + 8 * headers++], 0xFF81, SIM_SFDP_SECTOR_MAP_DWORDS, SIM_SFDP_SECTOR_MAP_OFFSET);
+    }
+    sim_sfdp[6] = headers - 1;
+
+    uint32_t dw[SIM_SFDP_TABLE_DWORDS + 1];
+    // 4kB erase with opcode 0x20, 64-byte write granularity, 3-byte or 3/4-byte addressing, unused bits set
+    dw[1] = 0x01 | (1 << 2) | (0x7 << 5) | (0x20 << 8) | (1UL << 23) | (0xFFUL << 24);
+    dw[1] |= (part->addr_4byte ? 1UL : 0) << 17;
+    dw[1] |= (part->read_1_1_2.opcode ? 1UL : 0) << 16;
+    dw[1] |= (part->read_1_2_2.opcode ? 1UL : 0) << 20;
+    dw[1] |= (part->read_1_4_4.opcode ? 1UL : 0) << 21;
+    dw[1] |= (part->read_1_1_4.opcode ? 1UL : 0) << 22;
+    dw[2] = sim.density * 8 - 1;
+    dw[3] = sim_read_field(&part->read_1_4_4) | ((uint32_t)sim_read_field(&part->read_1_1_4) << 16);
+    dw[4] = sim_read_field(&part->read_1_1_2) | ((uint32_t)sim_read_field(&part->read_1_2_2) << 16);
+    dw[5] = 0xFFFFFFEE | (part->read_2_2_2.opcode ? 0x01 : 0) | (part->read_4_4_4.opcode ? 0x10 : 0);
+    dw[6] = 0xFFFF | ((uint32_t)sim_read_field(&part->read_2_2_2) << 16);
+    dw[7] = 0xFFFF | ((uint32_t)sim_read_field(&part->read_4_4_4) << 16);
+    // Sector types: 4kB/0x20, 32kB/0x52, 64kB/0xD8, unused
+    dw[8] = 12 | (0x20 << 8) | (15UL << 16) | (0x52UL << 24);
+    dw[9] = 16 | (0xD8 << 8);
+    // Erase and program times are not modelled, only the page size
+    dw[10] = 0;
+    dw[11] = (uint32_t)(part->page_shift & 0x0F) << 4;
+    for (int n = 1; n <= SIM_SFDP_TABLE_DWORDS; ++n) {
+        sim_put32(&sim_sfdp[SIM_SFDP_TABLE_OFFSET + (n - 1) * 4], dw[n]);
+    }
+
+    // 4-byte address instructions: reads matching the part's fast reads, page program, erase types 1-3
+    uint32_t insns = 0x03 | (1UL << 6) | (0x7UL << 9);
+    insns |= (part->read_1_1_2.opcode ? 1UL : 0) << 2;
+    insns |= (part->read_1_2_2.opcode ? 1UL : 0) << 3;
+    insns |= (part->read_1_1_4.opcode ? 1UL : 0) << 4;
+    insns |= (part->read_1_4_4.opcode ? 1UL : 0) << 5;
+    sim_put32(&sim_sfdp[SIM_SFDP_4BYTE_OFFSET], insns);
+    sim_put32(&sim_sfdp[SIM_SFDP_4BYTE_OFFSET + 4], 0x21 | (0x5C << 8) | (0xDCUL << 16) | (0xFFUL << 24));
+
+    // Sector map: one detection command reading bit 2 of the configuration register, then a map for boot sectors at
+    // the bottom (configuration 0) and at the top (configuration 1). Region sizes are in 256-byte units, minus one.
+    uint32_t boot = SIM_BOOT_SECTORS_SIZE / 256 - 1;
+    uint32_t main = (sim.density - SIM_BOOT_SECTORS_SIZE) / 256 - 1;
+    uint32_t map[SIM_SFDP_SECTOR_MAP_DWORDS] = {
+        0x35 << 8 | (0x04UL << 24), 0, // 35h, no address, no latency, mask 0x04
+        0x02 | (0 << 8) | (1UL << 16), 0x1 | (boot << 8), 0x7 | (main << 8),
+        0x03 | (1 << 8) | (1UL << 16), 0x7 | (main << 8), 0x1 | (boot << 8),
+    };
+    for (int n = 0; n < SIM_SFDP_SECTOR_MAP_DWORDS; ++n) {
+        sim_put32(&sim_sfdp[SIM_SFDP_SECTOR_MAP_OFFSET + n * 4], map[n]);
+    }
+}
+
+void spi_flash_sim_attach(const spi_flash_sim_part_t *part, uint8_t bus_lanes) {
+    memset(&sim, 0, sizeof(sim));
+    sim.part      = part;
+    sim.bus_lanes = bus_lanes;
+    sim.density   = part->density ? part->density : EXTERNAL_FLASH_SIZE;
+    uint32_t x    = part->jedec_id;
+    for (size_t i = 0; i < sizeof(sim_memory); ++i) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        sim_memory[i] = x & 0xFF;
+    }
+    sim_build_sfdp(part);
+}
+
+const uint8_t *spi_flash_sim_memory(void) {
+    return sim_memory;
+}
+
+uint64_t spi_flash_sim_clocks(void) {
+    return sim.clocks;
+}
+
+uint32_t spi_flash_sim_errors(void) {
+    return sim.errors;
+}
+
+uint32_t spi_flash_sim_erases(uint32_t size) {
+    for (size_t n = 0; n < sizeof(sim_erase_types) / sizeof(sim_erase_types[0]); ++n) {
+        if (sim_erase_types[n].size == size) {
+            return sim.erases[n];
+        }
+    }
+    return 0;
+}
+
+uint32_t spi_flash_sim_transactions(void) {
+    return sim.transactions;
+}
+
+uint32_t spi_flash_sim_4byte_commands(void) {
+    return sim.commands_4byte;
+}
+
+uint32_t spi_flash_sim_busy_polls(void) {
+    return sim.busy_polls;
+}
+
+uint32_t spi_flash_sim_sleeps(void) {
+    return sim.sleeps;
+}
+
+void spi_flash_sim_reset_counters(void) {
+    sim.clocks         = 0;
+    sim.transactions   = 0;
+    sim.errors         = 0;
+    sim.commands_4byte = 0;
+    sim.busy_polls     = 0;
+    sim.sleeps         = 0;
+    memset(sim.erases, 0, sizeof(sim.erases));
+}
+
+static uint8_t *sim_cell(uint32_t addr) {
+    return &sim_memory[addr % sizeof(sim_memory)];
+}
+
+static void sim_write_byte(uint8_t b) {
+    sim_tick(8);
+    if (!sim.selected) {
+        ++sim.errors;
+        return;
+    }
+    if (sim.ignoring) {
+        return;
+    }
+    if (sim.data_phase) {
+        if (sim.header[0] != 0x02 && sim.header[0] != 0x12) {
+            ++sim.errors;
+            return;
+        }
+        // Programming only clears bits, and wraps within the page
+        uint32_t page_size = sim.part->page_shift ? 1UL << sim.part->page_shift : EXTERNAL_FLASH_PAGE_SIZE;
+        uint32_t page      = sim.addr - sim.addr % page_size;
+        *sim_cell(sim.addr) &= b;
+        sim.addr = page + (sim.addr + 1) % page_size;
+        return;
+    }
+
+    sim.header[sim.header_len++] = b;
+    if (sim.header_len == 1) {
+        bool native_4byte = false;
+        switch (b) {
+            case 0x9F: // JEDEC ID
+            case 0x05: // Read status
+            case 0x06: // Write enable, latched on deselect
+                sim.addr_bytes  = 0;
+                sim.header_need = 1;
+                break;
+            case 0x35: // Read configuration register
+                sim.addr_bytes  = 0;
+                sim.header_need = sim.part->boot_sectors ? 1 : 0;
+                break;
+            case 0x03: // Read
+            case 0x02: // Page program
+            case 0x20: // Erase types, executed on deselect
+            case 0x52:
+            case 0xD8:
+                sim.addr_bytes  = 3;
+                sim.header_need = 4;
+                break;
+            case 0x0B: // Fast read, 8 dummy clocks
+            case 0x5A: // Read SFDP, 8 dummy clocks
+                sim.addr_bytes  = 3;
+                sim.header_need = 5;
+                break;
+            case 0x13: // 4-byte address forms of the above
+            case 0x12:
+            case 0x21:
+            case 0x5C:
+            case 0xDC:
+                native_4byte    = true;
+                sim.addr_bytes  = 4;
+                sim.header_need = 5;
+                break;
+            case 0x0C:
+                native_4byte    = true;
+                sim.addr_bytes  = 4;
+                sim.header_need = 6;
+                break;
+            default:
+                sim.header_need = 0;
+                break;
+        }
+        // Only status reads are accepted while a program or erase is in progress
+        if (sim.header_need == 0 || (native_4byte && !sim.part->addr_4byte) || (b != 0x05 && sim_busy())) {
+            ++sim.errors;
+            sim.ignoring = true;
+            return;
+        }
+        if (native_4byte) {
+            ++sim.commands_4byte;
+        }
+        if ((b == 0x02 || b == 0x12) && !sim.write_enabled) {
+            ++sim.errors;
+        }
+    }
+    if (sim.header_len == sim.header_need) {
+        sim.data_phase = true;
+        sim.addr       = 0;
+        for (uint8_t i = 1; i <= sim.addr_bytes; ++i) {
+            sim.addr = (sim.addr << 8) | sim.header[i];
+        }
+    }
+}
+
+static uint8_t sim_read_byte(void) {
+    sim_tick(8);
+    if (!sim.selected || !sim.data_phase) {
+        ++sim.errors;
+        return 0xFF;
+    }
+    switch (sim.header[0]) {
+        case 0x9F:
+            // Repeats every three bytes, as real parts tend to
+            return (sim.part->jedec_id >> (8 * (2 - (sim.addr++ % 3)))) & 0xFF;
+        case 0x05:
+            if (sim_busy()) {
+                ++sim.busy_polls;
+                return SIM_SR_WIP;
+            }
+            return 0x00;
+        case 0x35:
+            return sim.part->config_register;
+        case 0x03:
+        case 0x0B:
+        case 0x13:
+        case 0x0C:
+            return *sim_cell(sim.addr++);
+        case 0x5A:
+            return sim.addr < sizeof(sim_sfdp) ? sim_sfdp[sim.addr++] : 0xFF;
+    }
+    return 0xFF;
+}
+
+void spi_init(void) {}
+
+bool spi_start(pin_t slavePin, bool lsbFirst, uint8_t mode, uint16_t divisor) {
+    if (sim.selected) {
+        ++sim.errors;
+        return false;
+    }
+    ++sim.transactions;
+    sim.selected    = true;
+    sim.ignoring    = false;
+    sim.data_phase  = false;
+    sim.header_len  = 0;
+    sim.header_need = 0;
+    sim.addr        = 0;
+    return true;
+}
+
+spi_status_t spi_write(uint8_t data) {
+    sim_write_byte(data);
+    return data;
+}
+
+spi_status_t spi_read(void) {
+    return sim_read_byte();
+}
+
+spi_status_t spi_transmit(const uint8_t *data, uint16_t length) {
+    for (uint16_t i = 0; i < length; ++i) {
+        sim_write_byte(data[i]);
+    }
+    return SPI_STATUS_SUCCESS;
+}
+
+spi_status_t spi_receive(uint8_t *data, uint16_t length) {
+    for (uint16_t i = 0; i < length; ++i) {
+        data[i] = sim_read_byte();
+    }
+    return SPI_STATUS_SUCCESS;
+}
+
+static void sim_execute(void) {
+    if (!sim.data_phase) {
+        return;
+    }
+    if (sim.header[0] == 0x06) {
+        sim.write_enabled = true;
+        return;
+    }
+    if (sim.header[0] == 0x02 || sim.header[0] == 0x12) {
+        sim.write_enabled = false;
+        sim.busy_ns       = sim.now_ns + SIM_PROGRAM_NS;
+        return;
+    }
+    for (size_t n = 0; n < sizeof(sim_erase_types) / sizeof(sim_erase_types[0]); ++n) {
+        if (sim.header[0] != sim_erase_types[n].opcode && sim.header[0] != sim_erase_types[n].opcode_4byte) {
+            continue;
+        }
+        // Real parts erase the containing region, any misalignment or erase type the sector map disallows here is a
+        // driver bug
+        if (!sim.write_enabled || sim.addr % sim_erase_types[n].size != 0 || sim.addr >= sim.density || (n != 0 && sim_in_boot_sectors(sim.addr))) {
+            ++sim.errors;
+        } else {
+            memset(sim_cell(sim.addr), 0xFF, sim_erase_types[n].size);
+            ++sim.erases[n];
+            sim.busy_ns = sim.now_ns + (uint64_t)sim_erase_types[n].latency_ms * 1000000;
+        }
+        sim.write_enabled = false;
+    }
+}
+
+void spi_stop(void) {
+    sim_execute();
+    sim.selected = false;
+}
+
+// QMK's flash driver spins on the status register before each command
+static void sim_wait_ready(void) {
+    uint8_t status;
+    do {
+        spi_start(EXTERNAL_FLASH_SPI_SLAVE_SELECT_PIN, EXTERNAL_FLASH_SPI_LSBFIRST, EXTERNAL_FLASH_SPI_MODE, EXTERNAL_FLASH_SPI_CLOCK_DIVISOR);
+        spi_write(0x05);
+        status = spi_read();
+        spi_stop();
+    } while (status & SIM_SR_WIP);
+}
+
+flash_status_t flash_read_range(uint32_t addr, void *buf, size_t len) {
+    uint8_t cmd[] = {0x03, (addr >> 16) & 0xFF, (addr >> 8) & 0xFF, addr & 0xFF};
+    sim_wait_ready();
+    spi_start(EXTERNAL_FLASH_SPI_SLAVE_SELECT_PIN, EXTERNAL_FLASH_SPI_LSBFIRST, EXTERNAL_FLASH_SPI_MODE, EXTERNAL_FLASH_SPI_CLOCK_DIVISOR);
+    spi_transmit(cmd, sizeof(cmd));
+    spi_receive(buf, len);
+    spi_stop();
+    return FLASH_STATUS_SUCCESS;
+}
+
+flash_status_t flash_write_range(uint32_t addr, const void *buf, size_t len) {
+    const uint8_t *p = buf;
+    while (len > 0) {
+        size_t  chunk = EXTERNAL_FLASH_PAGE_SIZE - addr % EXTERNAL_FLASH_PAGE_SIZE;
+        uint8_t cmd[] = {0x02, (addr >> 16) & 0xFF, (addr >> 8) & 0xFF, addr & 0xFF};
+        if (chunk > len) {
+            chunk = len;
+        }
+        sim_wait_ready();
+        spi_start(EXTERNAL_FLASH_SPI_SLAVE_SELECT_PIN, EXTERNAL_FLASH_SPI_LSBFIRST, EXTERNAL_FLASH_SPI_MODE, EXTERNAL_FLASH_SPI_CLOCK_DIVISOR);
+        spi_write(0x06);
+        spi_stop();
+        spi_start(EXTERNAL_FLASH_SPI_SLAVE_SELECT_PIN, EXTERNAL_FLASH_SPI_LSBFIRST, EXTERNAL_FLASH_SPI_MODE, EXTERNAL_FLASH_SPI_CLOCK_DIVISOR);
+        spi_transmit(cmd, sizeof(cmd));
+        spi_transmit(p, chunk);
+        spi_stop();
+        addr += chunk;
+        p += chunk;
+        len -= chunk;
+    }
+    return FLASH_STATUS_SUCCESS;
+}
+
+flash_status_t flash_erase_sector(uint32_t addr) {
+    uint8_t cmd[] = {0x20, (addr >> 16) & 0xFF, (addr >> 8) & 0xFF, addr & 0xFF};
+    sim_wait_ready();
+    spi_start(EXTERNAL_FLASH_SPI_SLAVE_SELECT_PIN, EXTERNAL_FLASH_SPI_LSBFIRST, EXTERNAL_FLASH_SPI_MODE, EXTERNAL_FLASH_SPI_CLOCK_DIVISOR);
+    spi_write(0x06);
+    spi_stop();
+    spi_start(EXTERNAL_FLASH_SPI_SLAVE_SELECT_PIN, EXTERNAL_FLASH_SPI_LSBFIRST, EXTERNAL_FLASH_SPI_MODE, EXTERNAL_FLASH_SPI_CLOCK_DIVISOR);
+    spi_transmit(cmd, sizeof(cmd));
+    spi_stop();
+    return FLASH_STATUS_SUCCESS;
+}
+
+uint32_t timer_read32(void) {
+    return (uint32_t)(sim.now_ns / 1000000);
+}
+
+void wait_ms(uint32_t ms) {
+    ++sim.sleeps;
+    sim.now_ns += (uint64_t)ms * 1000000;
+}
+
+#ifdef SPI_FLASH_SIM_QSPI
+#    include "sfdp_flash.h"
+
+static const spi_flash_sim_read_t sim_read_1_1_1      = {.opcode = 0x03};
+static const spi_flash_sim_read_t sim_fast_read_1_1_1 = {.opcode = 0x0B, .wait_states = 8};
+
+// The standard 4-byte address forms of the standard read opcodes, which the simulated parts are assumed to use
+static uint8_t sim_opcode_4byte(uint8_t opcode) {
+    switch (opcode) {
+        case 0x03:
+            return 0x13;
+        case 0x0B:
+            return 0x0C;
+        case 0x3B:
+            return 0x3C;
+        case 0xBB:
+            return 0xBC;
+        case 0x6B:
+            return 0x6C;
+        case 0xEB:
+            return 0xEC;
+    }
+    return 0;
+}
+
+// The part is in regular SPI mode, so commands sent over more than one lane are never recognised
+static const spi_flash_sim_read_t *sim_lookup_read(const sfdp_read_mode_t *mode) {
+    if (mode->cmd_lanes != 1) {
+        return NULL;
+    }
+    switch ((mode->addr_lanes << 4) | mode->data_lanes) {
+        case 0x11:
+            return mode->opcode == 0x0B ? &sim_fast_read_1_1_1 : &sim_read_1_1_1;
+        case 0x12:
+            return &sim.part->read_1_1_2;
+        case 0x22:
+            return &sim.part->read_1_2_2;
+        case 0x14:
+            return &sim.part->read_1_1_4;
+        case 0x44:
+            return &sim.part->read_1_4_4;
+    }
+    return NULL;
+}
+
+bool sfdp_bus_read(const sfdp_read_mode_t *mode, uint32_t addr, void *data, size_t length) {
+    if (mode->cmd_lanes > sim.bus_lanes || mode->addr_lanes > sim.bus_lanes || mode->data_lanes > sim.bus_lanes) {
+        return false;
+    }
+
+    sim_tick(8 / mode->cmd_lanes + mode->addr_bytes * 8 / mode->addr_lanes + mode->mode_clocks + mode->wait_states + length * 8 / mode->data_lanes);
+    if (sim_busy()) {
+        ++sim.errors;
+        memset(data, 0xFF, length);
+        return true;
+    }
+
+    const spi_flash_sim_read_t *r      = sim_lookup_read(mode);
+    uint8_t                     opcode = r ? r->opcode : 0;
+    if (mode->addr_bytes == 4) {
+        opcode = sim.part->addr_4byte ? sim_opcode_4byte(opcode) : 0;
+        ++sim.commands_4byte;
+    } else if (mode->addr_bytes != EXTERNAL_FLASH_ADDRESS_SIZE) {
+        opcode = 0;
+    }
+    if (!opcode || opcode != mode->opcode) {
+        // Unrecognised command, nothing drives the data lines
+        ++sim.errors;
+        memset(data, 0xFF, length);
+        return true;
+    }
+    if (mode->mode_clocks + mode->wait_states != r->mode_clocks + r->wait_states) {
+        // Sampling starts on the wrong clock, so the data is garbage
+        ++sim.errors;
+        memset(data, 0xA5, length);
+        return true;
+    }
+
+    uint8_t *p = data;
+    for (size_t i = 0; i < length; ++i) {
+        p[i] = *sim_cell(addr + i);
+    }
+    return true;
+}
+#endif // SPI_FLASH_SIM_QSPI
@@ -0,0 +1,77 @@
+// Copyright 2025-2026 Nick Brassel (@tzarc)
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+// Simulated SPI NOR flash for host-side testing of the SFDP flash module. The device is driven through stand-ins for
+// QMK's spi_master API, and answers JEDEC ID, status, SFDP, single-lane read, program and erase commands at the byte
+// level, including their native 4-byte address forms. Its SFDP tables are built from the part description
+// independently of sfdp_flash_params.h, so that decoding errors show up as mismatches rather than being mirrored.
+// Parts larger than EXTERNAL_FLASH_SIZE alias their memory, so only the address width of commands tells them apart.
+//
+// Time is simulated: bus clocks advance it at 8MHz and wait_ms() skips ahead, and timer_read32() reports it. Programs
+// and erases keep the status register busy for a typical duration, during which any other command is an error.
+//
+// When built with SPI_FLASH_SIM_QSPI, the simulator also provides sfdp_bus_read(), modelling a dual/quad-capable
+// controller: it only returns the correct data if the opcode, lane widths and dummy clocks match what the part expects.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/** @brief Read command accepted by the simulated part, an opcode of zero means unsupported */
+typedef struct spi_flash_sim_read_t {
+    uint8_t opcode;
+    uint8_t mode_clocks;
+    uint8_t wait_states;
+} spi_flash_sim_read_t;
+
+/** @brief Simulated part description */
+typedef struct spi_flash_sim_part_t {
+    const char          *name;
+    uint32_t             jedec_id;
+    spi_flash_sim_read_t read_1_1_2;
+    spi_flash_sim_read_t read_1_2_2;
+    spi_flash_sim_read_t read_2_2_2;
+    spi_flash_sim_read_t read_1_1_4;
+    spi_flash_sim_read_t read_1_4_4;
+    spi_flash_sim_read_t read_4_4_4;
+    uint8_t              page_shift;      // Page size is 2^page_shift, zero for a JESD216 table without a page size
+    uint32_t             density;         // Size in bytes, zero for EXTERNAL_FLASH_SIZE
+    bool                 addr_4byte;      // Publishes a 4-byte address instruction table, accepting the standard opcodes
+    bool                 boot_sectors;    // Publishes a sector map with 64kB of boot sectors only erasable in 4kB units
+    uint8_t              config_register; // Returned by 35h, bit 2 moves the boot sectors from the bottom to the top
+} spi_flash_sim_part_t;
+
+/**
+ * @brief Attach a part, filling its memory with a deterministic pattern
+ *
+ * @param part Part description, must outlive the simulation
+ * @param bus_lanes Widest address/data path of the modelled controller, only used with SPI_FLASH_SIM_QSPI
+ */
+void spi_flash_sim_attach(const spi_flash_sim_part_t *part, uint8_t bus_lanes);
+
+/** @brief Simulated memory contents, EXTERNAL_FLASH_SIZE bytes */
+const uint8_t *spi_flash_sim_memory(void);
+
+/** @brief Bus clocks spent since the last reset */
+uint64_t spi_flash_sim_clocks(void);
+
+/** @brief Chip select assertions since the last reset */
+uint32_t spi_flash_sim_transactions(void);
+
+/** @brief Protocol errors (unknown commands, wrong dummy cycles, unsupported lane widths) since the last reset */
+uint32_t spi_flash_sim_errors(void);
+
+/** @brief Erase commands of the given size (4kB, 32kB or 64kB) executed since the last reset */
+uint32_t spi_flash_sim_erases(uint32_t size);
+
+/** @brief Commands issued with a native 4-byte address since the last reset */
+uint32_t spi_flash_sim_4byte_commands(void);
+
+/** @brief Status polls answered busy since the last reset */
+uint32_t spi_flash_sim_busy_polls(void);
+
+/** @brief wait_ms() calls since the last reset */
+uint32_t spi_flash_sim_sleeps(void);
+
+/** @brief Reset the clock, transaction, error, erase, 4-byte command, busy poll and sleep counters */
+void spi_flash_sim_reset_counters(void);
@@ -0,0 +1,23 @@
+// Copyright 2025-2026 Nick Brassel (@tzarc)
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+// Stand-in for QMK's spi_master.h, implemented by spi_flash_sim.c
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef int16_t  spi_status_t;
+typedef uint32_t pin_t;
+
+#define SPI_STATUS_SUCCESS (0)
+#define SPI_STATUS_ERROR (-1)
+#define SPI_STATUS_TIMEOUT (-2)
+
+void         spi_init(void);
+bool         spi_start(pin_t slavePin, bool lsbFirst, uint8_t mode, uint16_t divisor);
+spi_status_t spi_write(uint8_t data);
+spi_status_t spi_read(void);
+spi_status_t spi_transmit(const uint8_t *data, uint16_t length);
+spi_status_t spi_receive(uint8_t *data, uint16_t length);
+void         spi_stop(void);
@@ -0,0 +1,11 @@
+// Copyright 2025-2026 Nick Brassel (@tzarc)
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+// Stand-in for QMK's timer.h, implemented by spi_flash_sim.c
+
+#include <stdint.h>
+
+#define timer_expired32(current, future) ((uint32_t)(current - future) < UINT32_MAX / 2)
+
+uint32_t timer_read32(void);
@@ -0,0 +1,9 @@
+// Copyright 2025-2026 Nick Brassel (@tzarc)
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+// Stand-in for QMK's wait.h, implemented by spi_flash_sim.c. Sleeping advances the simulated clock instead.
+
+#include <stdint.h>
+
+void wait_ms(uint32_t ms);